@@ -1,7 +1,21 @@
+#include <filesystem>
 #include <iostream>
+#include <sstream>
+#include "utility/batch_evaluation/batch_evaluation.hpp"
+#include "utility/certificate_checker/certificate_checker.hpp"
+#include "utility/counterexample/counterexample.hpp"
+#include "utility/enumeration/enumeration.hpp"
+#include "utility/flat_formula_conversion/flat_formula_conversion.hpp"
+#include "utility/formula_bytecode/formula_bytecode.hpp"
+#include "utility/induction/induction.hpp"
+#include "utility/lemma_store/lemma_store.hpp"
 #include "utility/proof/proof.hpp"
+#include "utility/proof_archive/proof_archive.hpp"
+#include "utility/proof_record/proof_record.hpp"
 #include "utility/proof_system/proof_system.hpp"
+#include "utility/shared_formula_store/shared_formula_store.hpp"
 #include "utility/text_utils/text_utils.hpp"
+#include "utility/verification_condition/verification_condition.hpp"
 
 int main() {
     // test();
@@ -79,6 +93,210 @@ int main() {
         std::cout << "\n";
     }
 
+    // ---------------------------
+    // Example 2a: Refuting a false target before trying to prove it
+    // ---------------------------
+    {
+        std::cout << "=== Counterexample Search ===\n";
+
+        TermPtr y = Term::make_variable("y");
+        TermPtr x = Term::make_variable("x");
+        TermPtr two = Term::make_constant("2");
+        TermPtr three = Term::make_constant("3");
+        TermPtr X = Term::make_constant("X");
+
+        FormulaPtr y_in_X = Formula::make_rel("∈", {y, X});
+        FormulaPtr forall_x_eq_2 = Formula::make_forall("x", X, Formula::make_eq(x, two));
+        FormulaPtr y_eq_3 = Formula::make_eq(y, three);
+
+        Proof proof({y_in_X, forall_x_eq_2}, y_eq_3);
+
+        if (auto model = find_counterexample(proof, 4)) {
+            std::cout << "Target " << y_eq_3->to_string() << " is false in:\n" << model->to_string();
+        } else {
+            std::cout << "No counterexample found.\n";
+        }
+        std::cout << "\n";
+    }
+
+    // ---------------------------
+    // Example 2b: Narrowing a library of assumptions down to the relevant ones
+    // ---------------------------
+    {
+        std::cout << "=== Premise Selection ===\n";
+
+        TermPtr x = Term::make_variable("x");
+        TermPtr a = Term::make_constant("a");
+        auto unary = [&](const std::string &R, TermPtr t) { return Formula::make_rel(R, {t}); };
+        auto rule = [&](const std::string &from, const std::string &to) {
+            return Formula::make_forall("x", natural_numbers, Formula::make_implies(unary(from, x), unary(to, x)));
+        };
+
+        // P(a), P → Q, Q → R, and a chain S → T → U that has nothing to do with the target
+        std::vector<FormulaPtr> library = {unary("P", a), rule("P", "Q"), rule("Q", "R"), rule("S", "T"),
+                                           rule("T", "U")};
+        Proof proof(library, unary("R", a));
+
+        for (size_t hops : {1, 2}) {
+            std::cout << "Within " << hops << " hop(s) of " << unary("R", a)->to_string() << ":\n";
+            for (const FormulaPtr &f : proof.get_relevant_assumptions(hops))
+                std::cout << "  " << f->to_string() << "\n";
+        }
+        std::cout << "\n";
+    }
+
+    // ---------------------------
+    // Example 2c: Reusing a proven lemma
+    // ---------------------------
+    {
+        std::cout << "=== Lemma Reuse ===\n";
+
+        TermPtr y = Term::make_variable("y");
+        TermPtr x = Term::make_variable("x");
+        TermPtr five = Term::make_constant("5");
+        TermPtr X = Term::make_constant("X");
+
+        FormulaPtr y_in_X = Formula::make_rel("∈", {y, X});
+        FormulaPtr forall_x_eq_5 = Formula::make_forall("x", X, Formula::make_eq(x, five));
+        FormulaPtr y_eq_5 = Formula::make_eq(y, five);
+
+        LemmaStore lemma_store;
+
+        Proof first_proof({y_in_X, forall_x_eq_5}, y_eq_5);
+        first_proof.use_lemma_store(lemma_store);
+        first_proof.add_line_to_proof(y_in_X, "ASSUMPTION");
+        first_proof.add_line_to_proof(forall_x_eq_5, "ASSUMPTION");
+        first_proof.add_line_to_proof(y_eq_5, "FORALL", {1, 0});
+
+        // same assumptions in a different order, the result is looked up instead of re-derived
+        Proof second_proof({forall_x_eq_5, y_in_X}, y_eq_5);
+        second_proof.use_lemma_store(lemma_store);
+        second_proof.add_line_to_proof(y_eq_5, "LEMMA");
+
+        second_proof.print();
+
+        if (second_proof.is_valid()) {
+            std::cout << "Proof is valid for target: " << y_eq_5->to_string() << "\n";
+
+            // its only line is the goal cited as a lemma, which the certificate lists itself, so on its own the
+            // certificate only shows the goal given that lemma
+            Certificate certificate = second_proof.export_certificate();
+            CertificateCheckResult check = check_certificate(certificate);
+            std::cout << "Certificate is " << (check.valid ? "valid" : "NOT valid: " + check.error);
+            if (!check.cited_lemmas.empty())
+                std::cout << " only given the lemmas it cites:";
+            for (std::uint32_t lemma : check.cited_lemmas)
+                std::cout << " " << certificate.nodes.to_string(lemma);
+            std::cout << "\n";
+        } else {
+            std::cout << "Proof is NOT valid.\n";
+        }
+        std::cout << "\n";
+    }
+
+    // ---------------------------
+    // Example 2d: Checking imported axioms against the language in one pass
+    // ---------------------------
+    {
+        std::cout << "=== Validating Formulas ===\n";
+
+        TermPtr n = Term::make_variable("n");
+        TermPtr m = Term::make_variable("m");
+        TermPtr zero = Term::make_constant("0");
+        TermPtr N = Term::make_constant("ℕ");
+
+        Signature signature = Signature::builtin();
+        signature.constants.insert("ℕ");
+        // the builtin language only allows variables v1, v2, ...
+        signature.strict_variable_names = false;
+
+        // the second uses succ with two arguments, the third has m free
+        std::vector<FormulaPtr> axioms = {
+            Formula::make_forall("n", N, Formula::make_rel("<", {zero, Term::make_function("succ", {n})})),
+            Formula::make_forall("n", N, Formula::make_eq(Term::make_function("succ", {n, zero}), n)),
+            Formula::make_forall("n", N, Formula::make_eq(Term::make_function("+", {n, m}), n))};
+
+        std::vector<FormulaReport> reports = validate_formulas(axioms, signature);
+        for (size_t i = 0; i < axioms.size(); ++i) {
+            const FormulaReport &report = reports[i];
+            std::cout << axioms[i]->to_string() << ": " << (report.valid() ? "ok" : "invalid") << ", "
+                      << (report.is_sentence ? "sentence" : "not a sentence") << ", " << report.size
+                      << " nodes, depth " << report.depth << "\n";
+            for (const ValidationError &error : report.errors)
+                std::cout << "  " << error.to_string() << "\n";
+            for (const std::string &v : report.free_variables)
+                std::cout << "  free: " << v << "\n";
+        }
+        std::cout << "\n";
+    }
+
+    // ---------------------------
+    // Example 2e: Enumerating every formula up to a size
+    // ---------------------------
+    {
+        std::cout << "=== Enumerating Formulas ===\n";
+
+        EnumerationOptions options;
+        options.variables = {"n"};
+        options.quantifier_domains = {"ℕ"};
+        options.bound_variables = {"m"};
+        Signature signature;
+        signature.constants = {"0"};
+        signature.functions = {{"succ", 1}, {"+", 2}};
+        signature.relations = {{"<", 2}};
+
+        FormulaEnumerator enumerator(signature, options);
+        enumerator.build(5);
+        for (size_t size = 1; size <= 5; ++size)
+            std::cout << "size " << size << ": " << enumerator.terms(size).size() << " terms, "
+                      << enumerator.formulas(size).size() << " formulas\n";
+
+        // n + 0 and 0 + n only come out once
+        FlatFormulaReader reader(enumerator.table());
+        for (std::uint32_t node : enumerator.terms(3))
+            std::cout << "  " << reader.to_term(node)->to_string() << "\n";
+        std::cout << "\n";
+    }
+
+    // ---------------------------
+    // Example 2f: Axioms interned once and mapped by every worker
+    // ---------------------------
+    {
+        std::cout << "=== Shared Formula Store ===\n";
+
+        TermPtr n = Term::make_variable("n");
+        TermPtr zero = Term::make_constant("0");
+        TermPtr N = Term::make_constant("ℕ");
+        TermPtr succ_n = Term::make_function("succ", {n});
+
+        std::vector<FormulaPtr> axioms = {
+            Formula::make_forall("n", N, Formula::make_not(Formula::make_eq(succ_n, zero))),
+            Formula::make_forall("n", N, Formula::make_eq(Term::make_function("+", {n, zero}), n)),
+            Formula::make_forall("n", N, Formula::make_rel("<", {n, succ_n}))};
+
+        FlatFormulaTable table;
+        FlatFormulaBuilder builder(table);
+        std::vector<std::uint32_t> roots;
+        for (const FormulaPtr &axiom : axioms)
+            roots.push_back(builder.add_formula(axiom));
+
+        std::string path = (std::filesystem::temp_directory_path() / "mwe_axioms.store").string();
+        SharedFormulaStore::create(path, table, roots);
+
+        // each worker process would do this, the nodes themselves are never copied
+        SharedFormulaStore store(path);
+        FlatFormulaReader reader(store.view());
+        std::cout << table.nodes.size() << " nodes in " << store.mapped_size() << " mapped bytes\n";
+        for (std::uint32_t root : store.roots())
+            std::cout << "  " << reader.to_formula(root)->to_string() << "\n";
+
+        std::uint32_t n_node = store.find_node(NodeKind::variable, store.find_symbol("n"), {});
+        std::uint32_t succ_node = store.find_node(NodeKind::function, store.find_symbol("succ"), {&n_node, 1});
+        std::cout << "succ(n) is " << (succ_node == no_node ? "not " : "") << "in the store\n";
+        SharedFormulaStore::remove(path);
+        std::cout << "\n";
+    }
+
     // ---------------------------
     // Example 3: Induction proof of sum(n) = n
     // ---------------------------
@@ -115,7 +333,6 @@ int main() {
 
         // Now the proof assumptions include the definition of sum
         Proof proof({sum_axiom_base, sum_axiom_recursive, step}, target);
-        proof.register_rule("INDUCTION", induction_rule);
 
         // 0. Base case (can be derived from sum_axiom_base)
         proof.add_line_to_proof(sum_axiom_base, "ASSUMPTION");
@@ -131,6 +348,57 @@ int main() {
 
         proof.print();
 
+        if (proof.is_valid()) {
+            std::cout << "Proof is valid for target: " << target->to_string() << "\n";
+
+            // the recursive axiom was never used, so it is dropped
+            proof.compact();
+            proof.print();
+
+            // re-check the proof from its certificate, without any of the Proof machinery
+            Certificate certificate = parse_certificate(serialize_certificate(proof.export_certificate()));
+            CertificateCheckResult check = check_certificate(certificate);
+            std::cout << "Certificate is " << (check.valid ? "valid" : "NOT valid: " + check.error) << "\n";
+        } else {
+            std::cout << "Proof is NOT valid.\n";
+        }
+        std::cout << "\n";
+    }
+
+    {
+        std::cout << "=== Structural Induction Proof: append(l, nil) = l ===\n";
+
+        // List is built from nil and cons(h, t) with h ∈ ℕ and t ∈ List
+        TermPtr list = Term::make_constant("List");
+        InductiveType list_type{
+            list, {make_constructor("nil"), make_constructor("cons", {{"h", natural_numbers}, {"t", list}})}};
+        auto list_induction = std::make_shared<InductionSchemas>(list_type);
+
+        TermPtr nil = Term::make_constant("nil");
+        TermPtr l = Term::make_variable("l");
+        TermPtr h = Term::make_variable("h");
+        TermPtr t = Term::make_variable("t");
+        auto append_nil = [&](TermPtr u) { return Formula::make_eq(Term::make_function("append", {u, nil}), u); };
+        TermPtr cons_h_t = Term::make_function("cons", {h, t});
+
+        // Assumptions: append(nil, nil) = nil and appending nil to the tail is enough for the whole list
+        FormulaPtr base = append_nil(nil);
+        FormulaPtr step = Formula::make_forall(
+            "h", natural_numbers,
+            Formula::make_forall("t", list, Formula::make_implies(append_nil(t), append_nil(cons_h_t))));
+
+        // Target: forall l ∈ List, append(l, nil) = l
+        FormulaPtr target = Formula::make_forall("l", list, append_nil(l));
+
+        Proof proof({base, step}, target);
+        proof.register_rule("LIST_INDUCTION", induction_rule_for(list_induction));
+
+        proof.add_line_to_proof(base, "ASSUMPTION");
+        proof.add_line_to_proof(step, "ASSUMPTION");
+        proof.add_line_to_proof(target, "LIST_INDUCTION", {0, 1});
+
+        proof.print();
+
         if (proof.is_valid()) {
             std::cout << "Proof is valid for target: " << target->to_string() << "\n";
         } else {
@@ -139,6 +407,48 @@ int main() {
         std::cout << "\n";
     }
 
+    {
+        std::cout << "=== Hypotheses Stay With Their Target ===\n";
+
+        // D has just the elements a and b, and Z(x) → Z(a) ∧ Z(x) fails for x = b when only Z(b) holds
+        TermPtr domain = Term::make_constant("D");
+        auto two_elements = std::make_shared<InductionSchemas>(
+            InductiveType{domain, {make_constructor("a"), make_constructor("b")}});
+        TermPtr a = Term::make_constant("a");
+        TermPtr x = Term::make_variable("x");
+        auto Z = [](TermPtr u) { return Formula::make_rel("Z", {u}); };
+
+        FormulaPtr target =
+            Formula::make_forall("x", domain, Formula::make_implies(Z(x), Formula::make_and(Z(a), Z(x))));
+        Proof proof({}, target);
+
+        // case a: Z(a) → Z(a) ∧ Z(a)
+        proof.instantiate_induction(*two_elements);
+        proof.instantiate_implication();
+        proof.add_line_to_proof(Z(a), "ASSUMPTION");
+        proof.add_line_to_proof(proof.get_active_target(), "AND", {0, 0});
+
+        // case b: Z(b) → Z(a) ∧ Z(b), where Z(a) was only ever a hypothesis of case a
+        proof.instantiate_implication();
+        proof.add_line_to_proof(Z(Term::make_constant("b")), "ASSUMPTION");
+        try {
+            proof.add_line_to_proof(proof.get_active_target(), "AND", {0, 2});
+        } catch (const std::invalid_argument &e) {
+            std::cout << "Rejected: " << e.what() << "\n";
+        }
+
+        proof.print();
+        std::cout << "Proof is " << (proof.is_valid() ? "valid" : "NOT valid") << "\n";
+
+        // Z(x) → Z(a), where case a closes itself with its hypothesis, which case b mustn't pick up
+        Proof closed_by_hypothesis({}, Formula::make_forall("x", domain, Formula::make_implies(Z(x), Z(a))));
+        closed_by_hypothesis.instantiate_induction(*two_elements);
+        closed_by_hypothesis.instantiate_implication();
+        closed_by_hypothesis.instantiate_implication();
+        closed_by_hypothesis.print();
+        std::cout << "Proof is " << (closed_by_hypothesis.is_valid() ? "valid" : "NOT valid") << "\n\n";
+    }
+
     // ---------------------------
     // Example 4: Excluded Middle proof
     // ---------------------------
@@ -159,7 +469,6 @@ int main() {
 
         // No assumptions needed for LEM
         Proof proof({}, target);
-        proof.register_rule("LEM", excluded_middle_rule);
 
         // 0. Apply LEM directly
         proof.add_line_to_proof(target, "LEM");
@@ -173,6 +482,37 @@ int main() {
         }
         std::cout << "\n";
     }
+
+    {
+        std::cout << "=== Propositional Equivalence ===\n";
+
+        TermPtr x = Term::make_variable("x");
+        FormulaPtr Px = Formula::make_rel("P", {x});
+        FormulaPtr Qx = Formula::make_rel("Q", {x});
+
+        // Assumption: not (P(x) and Q(x))
+        FormulaPtr not_both = Formula::make_not(Formula::make_and(Px, Qx));
+
+        // Target: P(x) -> not Q(x)
+        FormulaPtr target = Formula::make_implies(Px, Formula::make_not(Qx));
+
+        Proof proof({not_both}, target);
+
+        // 0. the assumption
+        proof.add_line_to_proof(not_both, "ASSUMPTION");
+
+        // 1. same truth table as line 0, checked by comparing BDDs
+        proof.add_line_to_proof(target, "EQUIV", {0});
+
+        proof.print();
+
+        if (proof.is_valid()) {
+            std::cout << "Proof is valid for target: " << target->to_string() << "\n";
+        } else {
+            std::cout << "Proof is NOT valid.\n";
+        }
+        std::cout << "\n";
+    }
     {
         // Terms
         TermPtr x = Term::make_variable("x");
@@ -191,7 +531,6 @@ int main() {
 
         // Proof proof({imp1, imp2}, target);
         Proof proof({imp1, imp2}, target);
-        proof.register_rule("CASES", cases_rule);
 
         // 0. Assume f -> t
         proof.add_line_to_proof(imp1, "ASSUMPTION");
@@ -238,10 +577,22 @@ int main() {
         // target: forall n, sum(n) = n
         FormulaPtr target = Formula::make_forall("n", natural_numbers, Formula::make_eq(sum_fn(n), n));
 
+        // sanity check the target against an implementation of sum before proving it
+        NaturalInterpretation sum_by_counting;
+        sum_by_counting.functions["sum"] = [](std::span<const Natural> args) {
+            Natural total = 0;
+            for (Natural i = 0; i < args[0]; ++i)
+                total += 1;
+            return total;
+        };
+        std::optional<Natural> falsified = find_falsifying_value(target, 0, 10000, sum_by_counting);
+        std::cout << "Target holds for n < 10000: " << (falsified ? "no, n = " + std::to_string(*falsified) : "yes")
+                  << "\n";
+
         Proof proof({sum_axiom_base, sum_axiom_recursive}, target);
 
+        // the base case sum(0) = 0 is an assumption, so it is closed as soon as it becomes a target
         proof.instantiate_induction();
-        proof.add_line_to_proof(sum_axiom_base, "ASSUMPTION");
         proof.add_line_to_proof(sum_axiom_recursive, "ASSUMPTION");
         proof.instantiate_forall();
 
@@ -262,9 +613,30 @@ int main() {
 
         if (proof.is_valid()) {
             std::cout << "Proof is valid for target: " << target->to_string() << "\n";
+
+            // the certificate checker follows the target from induction through the rewrites down to the lines
+            CertificateCheckResult check = check_certificate(proof.export_certificate());
+            std::cout << "Certificate is " << (check.valid ? "valid" : "NOT valid: " + check.error) << "\n";
         } else {
             std::cout << "Proof is NOT valid.\n";
         }
+
+        // rebuilding the proof from its record, once checking every step and once trusting a record already checked
+        ProofRecord record = proof.record();
+        for (ReplayMode mode : {ReplayMode::verify, ReplayMode::trusted}) {
+            Proof replayed({sum_axiom_base, sum_axiom_recursive}, target);
+            replayed.replay(record, mode);
+            std::cout << (mode == ReplayMode::verify ? "Verified" : "Trusted") << " replay of " << record.steps.size()
+                      << " steps: " << replayed.num_lines() << " lines, "
+                      << (replayed.is_valid() ? "valid" : "NOT valid") << "\n";
+        }
+
+        // a saved record keeps its content hash, so it can be trusted by the process that loads it as well
+        std::string saved = serialize_proof_record(record);
+        Proof loaded({sum_axiom_base, sum_axiom_recursive}, target);
+        loaded.replay(parse_proof_record(saved), ReplayMode::trusted);
+        std::cout << "Trusted replay of the saved record (" << saved.size() << " bytes): " << loaded.num_lines()
+                  << " lines, " << (loaded.is_valid() ? "valid" : "NOT valid") << "\n";
         std::cout << "\n";
     }
     {
@@ -293,10 +665,6 @@ int main() {
         TermPtr va_temp_2 = Term::make_function("va", {temp, two});
         TermPtr va_temp_3 = Term::make_function("va", {temp, three});
 
-        std::vector<TermPtr> vas = {
-            va_x_0, va_x_1, va_x_2, va_x_3, va_y_0, va_y_1, va_y_2, va_y_3, va_temp_1, va_temp_2, va_temp_3,
-        };
-
         // Assumptions
         FormulaPtr va_x_0_eq_va_x_1 = Formula::make_eq(va_x_0, va_x_1);
         FormulaPtr va_x_2_eq_va_x_3 = Formula::make_eq(va_x_2, va_x_3);
@@ -311,36 +679,6 @@ int main() {
         FormulaPtr va_x_2_eq_va_y_2 = Formula::make_eq(va_x_2, va_y_2);
         FormulaPtr va_y_3_eq_va_temp_3 = Formula::make_eq(va_y_3, va_temp_3);
 
-        // element of natural assumptiosn (bad)
-        auto make_el_of_nat = [&](TermPtr el) {
-            return Formula::make_rel(text_utils::element_of, {el, natural_numbers});
-        };
-
-        std::vector<FormulaPtr> element_of_nat_assumptions;
-        for (const auto &va : vas) {
-            element_of_nat_assumptions.push_back(make_el_of_nat(va));
-        }
-
-        // transitivity
-        TermPtr a = Term::make_variable("a");
-        TermPtr b = Term::make_variable("b");
-        TermPtr c = Term::make_variable("c");
-
-        FormulaPtr a_eq_b = Formula::make_eq(a, b);
-        FormulaPtr b_eq_c = Formula::make_eq(b, c);
-        FormulaPtr a_eq_c = Formula::make_eq(a, c);
-        FormulaPtr a_eq_b_and_b_eq_c = Formula::make_and(a_eq_b, b_eq_c);
-        FormulaPtr a_eq_b_and_b_eq_c_implies_a_eq_c = Formula::make_implies(a_eq_b_and_b_eq_c, a_eq_c);
-
-        FormulaPtr forall_c = Formula::make_forall("c", natural_numbers, a_eq_b_and_b_eq_c_implies_a_eq_c);
-        FormulaPtr forall_b = Formula::make_forall("b", natural_numbers, forall_c);
-        FormulaPtr forall_a = Formula::make_forall("a", natural_numbers, forall_b);
-        FormulaPtr transitivity = forall_a;
-
-        FormulaPtr innermost_refl = Formula::make_implies(Formula::make_eq(a, b), Formula::make_eq(b, a));
-        FormulaPtr inner_refl = Formula::make_forall("b", natural_numbers, innermost_refl);
-        FormulaPtr reflexivity = Formula::make_forall("a", natural_numbers, inner_refl);
-
         // Target: va_x_3 = va_y_0 and va_y_3 = va_x_0
         FormulaPtr va_x_3_eq_va_y_0 = Formula::make_eq(va_x_3, va_y_0);
         FormulaPtr va_x_0_eq_va_y_3 = Formula::make_eq(va_y_3, va_x_0);
@@ -349,58 +687,131 @@ int main() {
         std::vector<FormulaPtr> assumptions = {
             va_x_0_eq_va_x_1,       va_x_2_eq_va_x_3,       va_y_0_eq_va_y_1,    va_y_1_eq_va_y_2,
             va_temp_1_eq_va_temp_2, va_temp_2_eq_va_temp_3, va_temp_1_eq_va_x_1, va_x_2_eq_va_y_2,
-            va_y_3_eq_va_temp_3,    transitivity,           reflexivity};
-
-        for (const auto &chidern : element_of_nat_assumptions) {
-            assumptions.push_back(chidern);
-        }
+            va_y_3_eq_va_temp_3};
 
         Proof proof(assumptions, swapped);
 
+        // 0 - 8. the assumptions
         for (const FormulaPtr &assumption : assumptions) {
             proof.add_line_to_proof(assumption, "ASSUMPTION");
         }
 
-        // a replaced by va_x_3
-        // forall b, forall c, (...)
-        auto fab_fac = substitute_term_in_formula(forall_b, a, va_x_3);
-        proof.add_line_to_proof(fab_fac, "FORALL", {9, 14});
+        // 9 - 12. va(x, 3) = va(x, 2) = va(y, 2) = va(y, 1) = va(y, 0)
+        proof.add_line_to_proof(Formula::make_eq(va_x_3, va_x_2), "EQ_SYM", {1});
+        proof.add_line_to_proof(Formula::make_eq(va_y_2, va_y_1), "EQ_SYM", {3});
+        proof.add_line_to_proof(Formula::make_eq(va_y_1, va_y_0), "EQ_SYM", {2});
+        proof.add_line_to_proof(va_x_3_eq_va_y_0, "EQ_TRANS", {9, 7, 10, 11});
+
+        // 13 - 16. va(y, 3) = va(temp, 3) = va(temp, 2) = va(temp, 1) = va(x, 1) = va(x, 0)
+        proof.add_line_to_proof(Formula::make_eq(va_temp_3, va_temp_2), "EQ_SYM", {5});
+        proof.add_line_to_proof(Formula::make_eq(va_temp_2, va_temp_1), "EQ_SYM", {4});
+        proof.add_line_to_proof(Formula::make_eq(va_x_1, va_x_0), "EQ_SYM", {0});
+        proof.add_line_to_proof(va_x_0_eq_va_y_3, "EQ_TRANS", {8, 13, 14, 6, 15});
+
+        // 17. both
+        proof.add_line_to_proof(swapped, "AND", {12, 16});
 
         proof.print();
 
-        // b replaced by va_x_2
-        // forall c, (...)
-        auto fac = std::get_if<ForallFormula>(&fab_fac->data)->inner;
-        auto fac_b_replaced = substitute_term_in_formula(fac, b, va_x_2);
-        proof.add_line_to_proof(fac_b_replaced, "FORALL", {22, 13});
+        if (proof.is_valid()) {
+            std::cout << "Proof is valid for target: " << swapped->to_string() << "\n";
+            CertificateCheckResult check = check_certificate(proof.export_certificate());
+            std::cout << "Certificate is " << (check.valid ? "valid" : "NOT valid: " + check.error) << "\n";
+        } else {
+            std::cout << "Proof is NOT valid.\n";
+        }
+        std::cout << "\n";
+    }
 
-        auto inner_forall = std::get_if<ForallFormula>(&fac_b_replaced->data)->inner;
-        auto inner_fa_c_replaced = substitute_term_in_formula(inner_forall, c, va_y_2);
-        proof.add_line_to_proof(inner_fa_c_replaced, "FORALL", {23, 17});
+    // ---------------------------
+    // The same swap with its assumptions generated from the program
+    // ---------------------------
+    {
+        std::cout << "=== Swap Proof from a Generated Verification Condition ===\n";
 
-        proof.print();
+        TermPtr x = Term::make_variable("x");
+        TermPtr y = Term::make_variable("y");
+        TermPtr temp = Term::make_variable("temp");
+        auto old = [](TermPtr v) { return Term::make_function("old", {v}); };
+
+        // temp := x; x := y; y := temp
+        std::vector<Assignment> program = {{"temp", x}, {"x", y}, {"y", temp}};
+        FormulaPtr swapped = Formula::make_and(Formula::make_eq(x, old(y)), Formula::make_eq(y, old(x)));
+        VerificationCondition condition = generate_verification_condition(program, swapped);
+
+        Proof proof(condition.assumptions, condition.target);
+
+        // 0 - 2. va(temp, 1) = va(x, 0), va(x, 2) = va(y, 0), va(y, 3) = va(temp, 1)
+        for (const FormulaPtr &assumption : condition.assumptions)
+            proof.add_line_to_proof(assumption, "ASSUMPTION");
 
-        auto refl_1 = substitute_term_in_formula(inner_refl, a, va_x_2);
-        auto refl_2 = substitute_term_in_formula(std::get_if<ForallFormula>(&refl_1->data)->inner, b, va_x_3);
-        proof.add_line_to_proof(refl_1, "FORALL", {10, 13});
-        proof.add_line_to_proof(refl_2, "FORALL", {25, 14});
-        auto va_x_3_eq_va_x_2 = Formula::make_eq(va_x_3, va_x_2);
-        proof.add_line_to_proof(va_x_3_eq_va_x_2, "IMPLIES", {26, 1});
-        proof.add_line_to_proof(Formula::make_and(va_x_3_eq_va_x_2, va_x_2_eq_va_y_2), "AND", {27, 7});
-        proof.add_line_to_proof(Formula::make_eq(va_x_3, va_y_2), "IMPLIES", {24, 28});
+        // 3. va(y, 3) = va(x, 0)
+        auto &target = std::get<AndFormula>(condition.target->data);
+        proof.add_line_to_proof(target.r, "EQ_TRANS", {2, 0});
+
+        // 4. both
+        proof.add_line_to_proof(condition.target, "AND", {1, 3});
 
         proof.print();
+        std::cout << "Proof is " << (proof.is_valid() ? "valid" : "NOT valid") << " for target: "
+                  << condition.target->to_string() << "\n";
+        std::cout << "\n";
+    }
 
-        // proof.add_line_to_proof(y_in_X, );
-        // proof.add_line_to_proof(y_eq_5, "FORALL", {1, 0});
-        //
-        // proof.print();
+    // ---------------------------
+    // Storing many similar proofs in one archive
+    // ---------------------------
+    {
+        std::cout << "=== Proof Archive ===\n";
 
-        // if (proof.is_valid()) {
-        //     std::cout << "Proof is valid for target: " << y_eq_5->to_string() << "\n";
-        // } else {
-        //     std::cout << "Proof is NOT valid.\n";
-        // }
+        TermPtr N = Term::make_constant("ℕ");
+        TermPtr x = Term::make_variable("x");
+        TermPtr y = Term::make_variable("y");
+        auto plus = [](TermPtr a, TermPtr b) { return Term::make_function("+", {a, b}); };
+        FormulaPtr commutes = Formula::make_forall(
+            "x", N, Formula::make_forall("y", N, Formula::make_eq(plus(x, y), plus(y, x))));
+
+        // a + b = b + a for every pair, each instantiating the same axiom twice
+        std::stringstream archive;
+        ProofArchiveWriter writer(archive);
+        size_t certificate_bytes = 0;
+        std::vector<std::string> names = {"a", "b", "c", "d"};
+        for (const std::string &first : names) {
+            for (const std::string &second : names) {
+                if (first == second)
+                    continue;
+                TermPtr a = Term::make_variable(first);
+                TermPtr b = Term::make_variable(second);
+                FormulaPtr a_in_N = Formula::make_rel("∈", {a, N});
+                FormulaPtr b_in_N = Formula::make_rel("∈", {b, N});
+                FormulaPtr target = Formula::make_eq(plus(a, b), plus(b, a));
+
+                Proof proof({a_in_N, b_in_N, commutes}, target);
+                proof.add_line_to_proof(a_in_N, "ASSUMPTION");
+                proof.add_line_to_proof(b_in_N, "ASSUMPTION");
+                proof.add_line_to_proof(commutes, "ASSUMPTION");
+                proof.add_line_to_proof(Formula::make_forall("y", N, Formula::make_eq(plus(a, y), plus(y, a))),
+                                        "FORALL", {2, 0});
+                proof.add_line_to_proof(target, "FORALL", {3, 1});
+
+                Certificate certificate = proof.export_certificate();
+                certificate_bytes += serialize_certificate(certificate).size();
+                writer.add(certificate);
+            }
+        }
+        writer.finish();
+        std::cout << "12 certificates: " << certificate_bytes << " bytes one by one, " << writer.bytes_written()
+                  << " bytes archived\n";
+
+        // read back one at a time
+        ProofArchiveReader reader(archive);
+        Certificate certificate;
+        size_t valid = 0, read = 0;
+        while (reader.next(certificate)) {
+            ++read;
+            valid += check_certificate(certificate).valid;
+        }
+        std::cout << valid << " of " << read << " certificates read back are valid\n";
         std::cout << "\n";
     }
 
@@ -0,0 +1,48 @@
+#include "../utility/certificate/certificate.hpp"
+#include "../utility/certificate_checker/certificate_checker.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+
+// Re-checks exported proof certificates, independently of the proof engine. A certificate that cites lemmas is only
+// valid given them, so they are listed as open obligations and such certificates are counted apart.
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <certificate>...\n";
+        return 2;
+    }
+
+    size_t num_failed = 0;
+    size_t num_given_lemmas = 0;
+    size_t num_lines = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 1; i < argc; ++i) {
+        try {
+            Certificate certificate = load_certificate(argv[i]);
+            CertificateCheckResult result = check_certificate(certificate);
+            num_lines += certificate.lines.size();
+            if (!result.valid) {
+                ++num_failed;
+                std::cout << argv[i] << ": FAILED: " << result.error << "\n";
+            } else if (!result.cited_lemmas.empty()) {
+                ++num_given_lemmas;
+                std::cout << argv[i] << ": valid only given the lemmas it cites, which are unproven:\n";
+                for (std::uint32_t lemma : result.cited_lemmas)
+                    std::cout << "    " << certificate.nodes.to_string(lemma) << "\n";
+            }
+        } catch (const std::exception &e) {
+            ++num_failed;
+            std::cout << argv[i] << ": FAILED: " << e.what() << "\n";
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << (argc - 1 - num_failed - num_given_lemmas) << "/" << (argc - 1) << " certificates valid, "
+              << num_given_lemmas << " valid only given lemmas, " << num_lines << " lines in " << elapsed.count()
+              << "s\n";
+
+    return num_failed + num_given_lemmas == 0 ? 0 : 1;
+}
@@ -0,0 +1,810 @@
+#include "../utility/flat_formula/flat_formula.hpp"
+#include "../utility/flat_formula_conversion/flat_formula_conversion.hpp"
+#include "../utility/proof/proof.hpp"
+#include "../utility/proof_system/proof_system.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Searches for inputs on which the proof engine does more than linear work, by mutating formulas and proof scripts
+// and keeping the ones that cost the most per node, in allocations or in node visits (see count_node_visit). Inputs
+// over budget are written out as regression cases, which --replay measures again.
+
+// ---------- Allocation counting ----------
+
+namespace {
+std::atomic<std::uint64_t> allocation_count{0};
+}
+
+// every replaceable form that allocates or frees, so what operator new returns is always freed by a matching delete.
+// the nothrow and aligned forms are left to the library, the nothrow ones call these. the deletes are kept out of line,
+// inlined into a caller GCC would see free() called on what operator new returned and warn about the mismatch
+void *operator new(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+[[gnu::noinline]] void operator delete(void *p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void *p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+// ---------- Cases ----------
+
+// the rules a proof script uses, the ones whose statement can be built from the statements of the lines they cite
+struct ScriptRule {
+    const char *name;
+    size_t dependencies;
+};
+const ScriptRule script_rules[] = {{"ASSUMPTION", 0}, {"LEM", 0}, {"AND", 2}, {"IMPLIES", 2}};
+constexpr size_t num_script_rules = std::size(script_rules);
+
+// formula is which formula an ASSUMPTION or LEM line is about, modulo the number of formulas, dependencies are
+// earlier script lines
+struct ScriptLine {
+    std::uint8_t rule = 0;
+    std::uint32_t formula = 0;
+    std::vector<std::uint32_t> dependencies;
+};
+
+// what a target is run on, every target uses every formula, pattern and replacement are only used by substitution and
+// the script only by add_line
+struct Case {
+    std::vector<FormulaPtr> formulas;
+    TermPtr pattern;
+    TermPtr replacement;
+    std::vector<ScriptLine> script;
+};
+
+// every formula as an assumption line, then each one AND the next, so the script grows linearly
+std::vector<ScriptLine> default_script(size_t num_formulas) {
+    std::vector<ScriptLine> script;
+    for (std::uint32_t i = 0; i < num_formulas; ++i)
+        script.push_back({0, i, {}});
+    for (std::uint32_t i = 1; i < num_formulas; ++i)
+        script.push_back({2, 0, {i - 1, i}});
+    return script;
+}
+
+// null if the line cites a line that has no statement
+FormulaPtr script_statement(const Case &c, const std::vector<FormulaPtr> &statements, const ScriptLine &line) {
+    const FormulaPtr &f = c.formulas[line.formula % c.formulas.size()];
+    std::string_view rule = script_rules[line.rule].name;
+    if (rule == "ASSUMPTION")
+        return f;
+    if (rule == "LEM")
+        return Formula::make_or(f, Formula::make_not(f));
+    const FormulaPtr &a = statements[line.dependencies[0]], &b = statements[line.dependencies[1]];
+    if (!a || !b)
+        return nullptr;
+    if (rule == "AND")
+        return Formula::make_and(a, b);
+    // IMPLIES cites the implication and then its antecedent, one that isn't an implication is claimed as it is and
+    // rejected
+    auto p = std::get_if<ImpliesFormula>(&a->data);
+    return p ? p->r : a;
+}
+
+struct Target {
+    std::string name;
+    std::function<void(const Case &)> run;
+};
+
+const std::vector<Target> &targets() {
+    static const std::vector<Target> all = {
+        {"substitute",
+         [](const Case &c) {
+             for (const FormulaPtr &f : c.formulas)
+                 substitute_term_in_formula(f, c.pattern, c.replacement);
+         }},
+        {"is_sentence",
+         [](const Case &c) {
+             for (const FormulaPtr &f : c.formulas)
+                 is_sentence(f);
+         }},
+        {"is_substitutable",
+         [](const Case &c) {
+             TermPtr var = std::holds_alternative<VariableTerm>(c.pattern->data) ? c.pattern : Term::make_variable("x");
+             for (const FormulaPtr &f : c.formulas)
+                 is_substitutable(f, var, c.replacement);
+         }},
+        {"to_string",
+         [](const Case &c) {
+             for (const FormulaPtr &f : c.formulas)
+                 f->to_string();
+         }},
+        // the proof script line by line, a rejected line is skipped and so is every line that cites it
+        {"add_line",
+         [](const Case &c) {
+             Proof proof(c.formulas, c.formulas.back());
+             std::vector<FormulaPtr> statements(c.script.size());
+             // the proof line each script line became, -1 if it was skipped
+             std::vector<int> proof_lines(c.script.size(), -1);
+             int num_lines = 0;
+             for (size_t i = 0; i < c.script.size(); ++i) {
+                 const ScriptLine &line = c.script[i];
+                 std::vector<int> dependencies;
+                 for (std::uint32_t d : line.dependencies)
+                     dependencies.push_back(proof_lines[d]);
+                 if (std::find(dependencies.begin(), dependencies.end(), -1) != dependencies.end())
+                     continue;
+                 FormulaPtr statement = script_statement(c, statements, line);
+                 try {
+                     proof.add_line_to_proof(statement, script_rules[line.rule].name, dependencies);
+                 } catch (const std::exception &) {
+                     continue;
+                 }
+                 statements[i] = std::move(statement);
+                 proof_lines[i] = num_lines++;
+             }
+         }},
+    };
+    return all;
+}
+
+const Target *find_target(const std::string &name) {
+    for (const Target &target : targets())
+        if (target.name == name)
+            return &target;
+    return nullptr;
+}
+
+size_t count_nodes(const TermPtr &t) {
+    size_t n = 1;
+    if (auto p = std::get_if<FunctionTerm>(&t->data))
+        for (const TermPtr &arg : p->args)
+            n += count_nodes(arg);
+    else if (auto p = std::get_if<TupleTerm>(&t->data))
+        for (const TermPtr &arg : p->args)
+            n += count_nodes(arg);
+    return n;
+}
+
+size_t count_nodes(const FormulaPtr &f) {
+    if (auto p = std::get_if<EqualityFormula>(&f->data))
+        return 1 + count_nodes(p->l) + count_nodes(p->r);
+    if (auto p = std::get_if<RelationFormula>(&f->data)) {
+        size_t n = 1;
+        for (const TermPtr &arg : p->args)
+            n += count_nodes(arg);
+        return n;
+    }
+    if (auto p = std::get_if<NotFormula>(&f->data))
+        return 1 + count_nodes(p->inner);
+    if (auto p = std::get_if<OrFormula>(&f->data))
+        return 1 + count_nodes(p->l) + count_nodes(p->r);
+    if (auto p = std::get_if<AndFormula>(&f->data))
+        return 1 + count_nodes(p->l) + count_nodes(p->r);
+    if (auto p = std::get_if<ImpliesFormula>(&f->data))
+        return 1 + count_nodes(p->l) + count_nodes(p->r);
+    if (auto p = std::get_if<ForallFormula>(&f->data))
+        return 1 + count_nodes(p->domain) + count_nodes(p->inner);
+    if (auto p = std::get_if<ExistsFormula>(&f->data))
+        return 1 + count_nodes(p->domain) + count_nodes(p->inner);
+    return 1;
+}
+
+// a script line counts as one node and one per line it cites
+size_t count_nodes(const Case &c) {
+    size_t n = count_nodes(c.pattern) + count_nodes(c.replacement);
+    for (const FormulaPtr &f : c.formulas)
+        n += count_nodes(f);
+    for (const ScriptLine &line : c.script)
+        n += 1 + line.dependencies.size();
+    return n;
+}
+
+// ---------- Cost ----------
+
+struct Cost {
+    std::uint64_t allocations = 0;
+    std::uint64_t node_visits = 0;
+    std::uint64_t nanoseconds = 0;
+    size_t nodes = 1;
+
+    double allocations_per_node() const { return (double)allocations / nodes; }
+    double visits_per_node() const { return (double)node_visits / nodes; }
+    double nanoseconds_per_node() const { return (double)nanoseconds / nodes; }
+};
+
+std::ostream &operator<<(std::ostream &out, const Cost &cost) {
+    return out << cost.nodes << " nodes, " << cost.allocations_per_node() << " allocations, " << cost.visits_per_node()
+               << " node visits and " << cost.nanoseconds_per_node() << "ns per node";
+}
+
+// what the search maximizes, time is too noisy to be one
+enum class Objective { allocations, node_visits };
+
+double score(const Cost &cost, Objective objective) {
+    return objective == Objective::allocations ? cost.allocations_per_node() : cost.visits_per_node();
+}
+
+struct Budget {
+    double allocations_per_node = 64;
+    double visits_per_node = 256;
+    double nanoseconds_per_node = 20000;
+
+    bool exceeded_by(const Cost &cost) const {
+        return cost.allocations_per_node() > allocations_per_node || cost.visits_per_node() > visits_per_node ||
+               cost.nanoseconds_per_node() > nanoseconds_per_node;
+    }
+};
+
+// exceptions are a normal outcome, rejecting a line is work too
+Cost measure(const Target &target, const Case &c) {
+    Cost cost;
+    cost.nodes = count_nodes(c);
+    std::uint64_t allocations_before = allocation_count.load(std::memory_order_relaxed);
+    std::uint64_t visits_before = node_visits.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+    try {
+        target.run(c);
+    } catch (const std::exception &) {
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    cost.allocations = allocation_count.load(std::memory_order_relaxed) - allocations_before;
+    cost.node_visits = node_visits.load(std::memory_order_relaxed) - visits_before;
+    cost.nanoseconds = (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    return cost;
+}
+
+// ---------- Mutation ----------
+
+class Mutator {
+  public:
+    explicit Mutator(std::uint64_t seed) : rng(seed) {}
+
+    Case initial() {
+        TermPtr x = Term::make_variable("x");
+        return {{Formula::make_eq(x, Term::make_constant("0"))}, x, Term::make_constant("1"), default_script(1)};
+    }
+
+    size_t pick(size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(rng); }
+
+    Case mutate(Case c) {
+        switch (pick(10)) {
+        case 0: {
+            FormulaPtr &f = c.formulas[pick(c.formulas.size())];
+            f = map_formula_at(f, pick(count_formulas(f)), [&](FormulaPtr g) { return wrap_formula(g); });
+            break;
+        }
+        case 1:
+        case 2: {
+            FormulaPtr &f = c.formulas[pick(c.formulas.size())];
+            f = map_term_at(f, pick(count_terms(f)), [&](TermPtr t) { return wrap_term(t); });
+            break;
+        }
+        case 3: {
+            // substitution only does anything when the pattern occurs
+            const FormulaPtr &f = c.formulas[pick(c.formulas.size())];
+            map_term_at(f, pick(count_terms(f)), [&](TermPtr t) {
+                c.pattern = t;
+                return t;
+            });
+            break;
+        }
+        case 4:
+            c.replacement = pick(2) ? wrap_term(c.replacement) : c.pattern;
+            break;
+        case 5:
+            c.formulas.push_back(c.formulas[pick(c.formulas.size())]);
+            break;
+        case 6:
+            if (c.formulas.size() > 1)
+                c.formulas.erase(c.formulas.begin() + pick(c.formulas.size()));
+            break;
+        case 7:
+            c.script.push_back(script_line(c.script.size()));
+            break;
+        case 8:
+            // cites a different earlier line
+            if (!c.script.empty()) {
+                size_t i = pick(c.script.size());
+                for (std::uint32_t &d : c.script[i].dependencies)
+                    if (pick(2))
+                        d = (std::uint32_t)pick(i);
+            }
+            break;
+        case 9:
+            erase_script_line(c.script);
+            break;
+        }
+        return c;
+    }
+
+  private:
+    std::mt19937_64 rng;
+
+    // a line that can go at index i of a script
+    ScriptLine script_line(size_t i) {
+        ScriptLine line{(std::uint8_t)pick(num_script_rules), (std::uint32_t)pick(4), {}};
+        if (i == 0)
+            line.rule = 0;
+        for (size_t j = 0; j < script_rules[line.rule].dependencies; ++j)
+            line.dependencies.push_back((std::uint32_t)pick(i));
+        return line;
+    }
+
+    // a line no other line cites, the last one if the picked one is cited
+    void erase_script_line(std::vector<ScriptLine> &script) {
+        if (script.size() <= 1)
+            return;
+        std::uint32_t i = (std::uint32_t)pick(script.size());
+        for (size_t j = i + 1; j < script.size(); ++j) {
+            const std::vector<std::uint32_t> &dependencies = script[j].dependencies;
+            if (std::find(dependencies.begin(), dependencies.end(), i) != dependencies.end()) {
+                script.pop_back();
+                return;
+            }
+        }
+        script.erase(script.begin() + i);
+        for (size_t j = i; j < script.size(); ++j)
+            for (std::uint32_t &d : script[j].dependencies)
+                d -= d > i;
+    }
+
+    TermPtr leaf() {
+        static const char *const names[] = {"x", "y", "z"};
+        return pick(2) ? Term::make_variable(names[pick(3)]) : Term::make_constant(pick(2) ? "0" : "1");
+    }
+
+    TermPtr wrap_term(TermPtr t) {
+        switch (pick(3)) {
+        case 0:
+            return Term::make_function("succ", {t});
+        case 1:
+            return Term::make_function("+", {t, leaf()});
+        default:
+            // sharing one subterm twice doubles the tree without adding pointers
+            return Term::make_function("*", {t, t});
+        }
+    }
+
+    FormulaPtr wrap_formula(FormulaPtr f) {
+        static const char *const names[] = {"x", "y", "z"};
+        switch (pick(5)) {
+        case 0:
+            return Formula::make_not(f);
+        case 1:
+            return Formula::make_and(f, Formula::make_eq(leaf(), leaf()));
+        case 2:
+            return Formula::make_implies(Formula::make_rel("<", {leaf(), leaf()}), f);
+        case 3:
+            return Formula::make_forall(names[pick(3)], Term::make_constant("ℕ"), f);
+        default:
+            return Formula::make_exists(names[pick(3)], Term::make_constant("ℕ"), f);
+        }
+    }
+
+    static size_t count_terms(const TermPtr &t) {
+        size_t n = 1;
+        if (auto p = std::get_if<FunctionTerm>(&t->data))
+            for (const TermPtr &arg : p->args)
+                n += count_terms(arg);
+        return n;
+    }
+
+    // term nodes below f, quantifier domains left out so they stay constants
+    static size_t count_terms(const FormulaPtr &f) { return count_nodes(f) - count_formulas(f) - count_domains(f); }
+
+    static size_t count_domains(const FormulaPtr &f) {
+        if (auto p = std::get_if<NotFormula>(&f->data))
+            return count_domains(p->inner);
+        if (auto p = std::get_if<OrFormula>(&f->data))
+            return count_domains(p->l) + count_domains(p->r);
+        if (auto p = std::get_if<AndFormula>(&f->data))
+            return count_domains(p->l) + count_domains(p->r);
+        if (auto p = std::get_if<ImpliesFormula>(&f->data))
+            return count_domains(p->l) + count_domains(p->r);
+        if (auto p = std::get_if<ForallFormula>(&f->data))
+            return count_nodes(p->domain) + count_domains(p->inner);
+        if (auto p = std::get_if<ExistsFormula>(&f->data))
+            return count_nodes(p->domain) + count_domains(p->inner);
+        return 0;
+    }
+
+    static size_t count_formulas(const FormulaPtr &f) {
+        if (auto p = std::get_if<NotFormula>(&f->data))
+            return 1 + count_formulas(p->inner);
+        if (auto p = std::get_if<OrFormula>(&f->data))
+            return 1 + count_formulas(p->l) + count_formulas(p->r);
+        if (auto p = std::get_if<AndFormula>(&f->data))
+            return 1 + count_formulas(p->l) + count_formulas(p->r);
+        if (auto p = std::get_if<ImpliesFormula>(&f->data))
+            return 1 + count_formulas(p->l) + count_formulas(p->r);
+        if (auto p = std::get_if<ForallFormula>(&f->data))
+            return 1 + count_formulas(p->inner);
+        if (auto p = std::get_if<ExistsFormula>(&f->data))
+            return 1 + count_formulas(p->inner);
+        return 1;
+    }
+
+    using TermMap = std::function<TermPtr(TermPtr)>;
+    using FormulaMap = std::function<FormulaPtr(FormulaPtr)>;
+
+    // applies map to the index'th term node in preorder, index counts down as nodes are passed
+    static TermPtr map_term_at(const TermPtr &t, size_t &index, const TermMap &map) {
+        if (index-- == 0)
+            return map(t);
+        auto p = std::get_if<FunctionTerm>(&t->data);
+        if (!p)
+            return t;
+        std::vector<TermPtr> args;
+        for (const TermPtr &arg : p->args)
+            args.push_back(map_term_at(arg, index, map));
+        return Term::make_function(p->f, std::move(args));
+    }
+
+    static std::vector<TermPtr> map_terms_at(const std::vector<TermPtr> &terms, size_t &index, const TermMap &map) {
+        std::vector<TermPtr> mapped;
+        for (const TermPtr &t : terms)
+            mapped.push_back(map_term_at(t, index, map));
+        return mapped;
+    }
+
+    static FormulaPtr map_term_at(const FormulaPtr &f, size_t index, const TermMap &map) {
+        return map_term_below(f, index, map);
+    }
+
+    static FormulaPtr map_term_below(const FormulaPtr &f, size_t &index, const TermMap &map) {
+        if (auto p = std::get_if<EqualityFormula>(&f->data)) {
+            TermPtr l = map_term_at(p->l, index, map);
+            return Formula::make_eq(l, map_term_at(p->r, index, map));
+        }
+        if (auto p = std::get_if<RelationFormula>(&f->data))
+            return Formula::make_rel(p->R, map_terms_at(p->args, index, map));
+        if (auto p = std::get_if<NotFormula>(&f->data))
+            return Formula::make_not(map_term_below(p->inner, index, map));
+        if (auto p = std::get_if<OrFormula>(&f->data)) {
+            FormulaPtr l = map_term_below(p->l, index, map);
+            return Formula::make_or(l, map_term_below(p->r, index, map));
+        }
+        if (auto p = std::get_if<AndFormula>(&f->data)) {
+            FormulaPtr l = map_term_below(p->l, index, map);
+            return Formula::make_and(l, map_term_below(p->r, index, map));
+        }
+        if (auto p = std::get_if<ImpliesFormula>(&f->data)) {
+            FormulaPtr l = map_term_below(p->l, index, map);
+            return Formula::make_implies(l, map_term_below(p->r, index, map));
+        }
+        if (auto p = std::get_if<ForallFormula>(&f->data))
+            return Formula::make_forall(p->v, p->domain, map_term_below(p->inner, index, map));
+        if (auto p = std::get_if<ExistsFormula>(&f->data))
+            return Formula::make_exists(p->v, p->domain, map_term_below(p->inner, index, map));
+        return f;
+    }
+
+    static FormulaPtr map_formula_at(const FormulaPtr &f, size_t index, const FormulaMap &map) {
+        return map_formula_below(f, index, map);
+    }
+
+    static FormulaPtr map_formula_below(const FormulaPtr &f, size_t &index, const FormulaMap &map) {
+        if (index-- == 0)
+            return map(f);
+        if (auto p = std::get_if<NotFormula>(&f->data))
+            return Formula::make_not(map_formula_below(p->inner, index, map));
+        if (auto p = std::get_if<OrFormula>(&f->data)) {
+            FormulaPtr l = map_formula_below(p->l, index, map);
+            return Formula::make_or(l, map_formula_below(p->r, index, map));
+        }
+        if (auto p = std::get_if<AndFormula>(&f->data)) {
+            FormulaPtr l = map_formula_below(p->l, index, map);
+            return Formula::make_and(l, map_formula_below(p->r, index, map));
+        }
+        if (auto p = std::get_if<ImpliesFormula>(&f->data)) {
+            FormulaPtr l = map_formula_below(p->l, index, map);
+            return Formula::make_implies(l, map_formula_below(p->r, index, map));
+        }
+        if (auto p = std::get_if<ForallFormula>(&f->data))
+            return Formula::make_forall(p->v, p->domain, map_formula_below(p->inner, index, map));
+        if (auto p = std::get_if<ExistsFormula>(&f->data))
+            return Formula::make_exists(p->v, p->domain, map_formula_below(p->inner, index, map));
+        return f;
+    }
+};
+
+// ---------- Regression cases ----------
+
+// a FlatFormulaTable written out as text, then which nodes are the formulas, the pattern and the replacement
+void save_case(const std::string &path, const Target &target, const Case &c) {
+    FlatFormulaTable table;
+    FlatFormulaBuilder builder(table);
+    std::vector<std::uint32_t> formulas;
+    for (const FormulaPtr &f : c.formulas)
+        formulas.push_back(builder.add_formula(f));
+    std::uint32_t pattern = builder.add_term(c.pattern);
+    std::uint32_t replacement = builder.add_term(c.replacement);
+
+    std::ofstream out(path);
+    out << "perf_fuzz case\ntarget " << target.name << "\nsymbols " << table.symbols.size() << "\n";
+    for (const std::string &symbol : table.symbols)
+        out << symbol << "\n";
+    out << "nodes " << table.nodes.size() << "\n";
+    for (std::uint32_t i = 0; i < table.nodes.size(); ++i) {
+        const FlatNode &n = table.nodes[i];
+        out << (unsigned)n.kind << " " << (long long)(n.symbol == no_symbol ? -1 : (long long)n.symbol) << " "
+            << n.child_count;
+        for (std::uint32_t child : table.children_of(i))
+            out << " " << child;
+        out << "\n";
+    }
+    out << "formulas " << formulas.size();
+    for (std::uint32_t f : formulas)
+        out << " " << f;
+    out << "\npattern " << pattern << "\nreplacement " << replacement << "\nscript " << c.script.size() << "\n";
+    for (const ScriptLine &line : c.script) {
+        out << script_rules[line.rule].name << " " << line.formula;
+        for (std::uint32_t d : line.dependencies)
+            out << " " << d;
+        out << "\n";
+    }
+    if (!out)
+        throw std::runtime_error("couldn't write " + path);
+}
+
+std::pair<const Target *, Case> load_case(const std::string &path) {
+    std::ifstream in(path);
+    if (!in)
+        throw std::runtime_error("couldn't open " + path);
+    auto expect = [&](const std::string &word) {
+        std::string got;
+        if (!(in >> got) || got != word)
+            throw std::invalid_argument(path + ": expected " + word);
+    };
+
+    std::string line, name;
+    std::getline(in, line);
+    if (line != "perf_fuzz case")
+        throw std::invalid_argument(path + ": not a perf_fuzz case");
+    expect("target");
+    in >> name;
+    const Target *target = find_target(name);
+    if (!target)
+        throw std::invalid_argument(path + ": unknown target " + name);
+
+    FlatFormulaTable table;
+    size_t num_symbols = 0, num_nodes = 0;
+    expect("symbols");
+    in >> num_symbols;
+    std::getline(in, line);
+    for (size_t i = 0; i < num_symbols && std::getline(in, line); ++i)
+        table.symbols.push_back(line);
+    expect("nodes");
+    in >> num_nodes;
+    for (size_t i = 0; i < num_nodes; ++i) {
+        unsigned kind = 0;
+        long long symbol = 0;
+        std::uint32_t count = 0;
+        in >> kind >> symbol >> count;
+        table.nodes.push_back({(NodeKind)kind, symbol < 0 ? no_symbol : (std::uint32_t)symbol,
+                               (std::uint32_t)table.children.size(), count});
+        for (std::uint32_t j = 0; j < count; ++j) {
+            std::uint32_t child = 0;
+            in >> child;
+            table.children.push_back(child);
+        }
+    }
+
+    size_t num_formulas = 0;
+    std::vector<std::uint32_t> formulas;
+    std::uint32_t pattern = 0, replacement = 0;
+    expect("formulas");
+    in >> num_formulas;
+    formulas.resize(num_formulas);
+    for (std::uint32_t &f : formulas)
+        in >> f;
+    expect("pattern");
+    in >> pattern;
+    expect("replacement");
+    in >> replacement;
+
+    std::string err;
+    if (!in || num_formulas == 0 || !table.is_well_formed(&err) || pattern >= num_nodes || replacement >= num_nodes)
+        throw std::invalid_argument(path + ": malformed case " + err);
+
+    // cases saved before there were scripts ran the default one
+    Case c;
+    std::string word;
+    if (!(in >> word)) {
+        c.script = default_script(num_formulas);
+    } else {
+        size_t num_lines = 0;
+        if (word != "script" || !(in >> num_lines))
+            throw std::invalid_argument(path + ": expected script");
+        for (size_t i = 0; i < num_lines; ++i) {
+            ScriptLine line;
+            std::string rule;
+            in >> rule >> line.formula;
+            while (line.rule < num_script_rules && rule != script_rules[line.rule].name)
+                ++line.rule;
+            if (!in || line.rule == num_script_rules)
+                throw std::invalid_argument(path + ": bad rule on script line " + std::to_string(i));
+            line.dependencies.resize(script_rules[line.rule].dependencies);
+            for (std::uint32_t &d : line.dependencies)
+                if (!(in >> d) || d >= i)
+                    throw std::invalid_argument(path + ": bad dependency on script line " + std::to_string(i));
+            c.script.push_back(std::move(line));
+        }
+    }
+
+    FlatFormulaReader reader(table);
+    for (std::uint32_t f : formulas)
+        c.formulas.push_back(reader.to_formula(f));
+    c.pattern = reader.to_term(pattern);
+    c.replacement = reader.to_term(replacement);
+    return {target, std::move(c)};
+}
+
+// ---------- Search ----------
+
+struct Options {
+    std::vector<const Target *> targets;
+    size_t iterations = 2000;
+    size_t max_nodes = 4000;
+    std::uint64_t seed = 1;
+    std::string out_dir = ".";
+    Objective objective = Objective::allocations;
+    Budget budget;
+    std::vector<std::string> replay;
+};
+
+struct Entry {
+    Case input;
+    Cost cost;
+};
+
+// keeps the inputs that cost the most per node, mutating them further, and saves the first over budget input of every
+// new worst cost
+void fuzz(const Target &target, const Options &options) {
+    // inputs kept to mutate
+    constexpr size_t corpus_size = 32;
+
+    Mutator mutator(options.seed);
+    std::vector<Entry> corpus;
+    Case first = mutator.initial();
+    corpus.push_back({first, measure(target, first)});
+
+    auto score_of = [&](const Cost &cost) { return score(cost, options.objective); };
+    double worst_saved = 0;
+    size_t num_saved = 0;
+    for (size_t i = 0; i < options.iterations; ++i) {
+        // the smaller of two picks favours the costliest inputs, which are kept at the front
+        const Entry &parent = corpus[std::min(mutator.pick(corpus.size()), mutator.pick(corpus.size()))];
+        Case child = mutator.mutate(parent.input);
+        if (count_nodes(child) > options.max_nodes)
+            continue;
+
+        Cost cost = measure(target, child);
+        if (corpus.size() == corpus_size && score_of(cost) <= score_of(corpus.back().cost))
+            continue;
+        if (corpus.size() == corpus_size)
+            corpus.pop_back();
+        auto position = std::upper_bound(corpus.begin(), corpus.end(), score_of(cost),
+                                         [&](double a, const Entry &e) { return a > score_of(e.cost); });
+        corpus.insert(position, {child, cost});
+
+        if (options.budget.exceeded_by(cost) && score_of(cost) > worst_saved * 1.25) {
+            worst_saved = score_of(cost);
+            std::string path = options.out_dir + "/" + target.name + "-" + std::to_string(num_saved++) + ".case";
+            save_case(path, target, child);
+            std::cout << target.name << ": " << cost << ", saved " << path << "\n";
+        }
+    }
+
+    std::cout << target.name << ": worst " << corpus.front().cost << ", " << num_saved << " cases over budget\n";
+}
+
+int replay(const Options &options) {
+    size_t num_over = 0;
+    for (const std::string &path : options.replay) {
+        try {
+            auto [target, c] = load_case(path);
+            Cost cost = measure(*target, c);
+            bool over = options.budget.exceeded_by(cost);
+            num_over += over;
+            std::cout << path << ": " << target->name << ", " << cost << (over ? ", OVER BUDGET" : "") << "\n";
+        } catch (const std::exception &e) {
+            ++num_over;
+            std::cout << path << ": FAILED: " << e.what() << "\n";
+        }
+    }
+    return num_over == 0 ? 0 : 1;
+}
+
+void usage(const char *program) {
+    std::cerr << "usage: " << program
+              << " [--target NAME]... [--iterations N] [--max-nodes N] [--seed N] [--out DIR]"
+                 " [--objective allocations|visits] [--allocations-per-node N] [--visits-per-node N]"
+                 " [--ns-per-node N]\n"
+              << "       " << program
+              << " [--allocations-per-node N] [--visits-per-node N] [--ns-per-node N] --replay CASE...\n"
+              << "targets:";
+    for (const Target &target : targets())
+        std::cerr << " " << target.name;
+    std::cerr << "\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc)
+                    throw std::invalid_argument(arg + " needs a value");
+                return argv[++i];
+            };
+            if (arg == "--target") {
+                std::string name = value();
+                const Target *target = find_target(name);
+                if (!target)
+                    throw std::invalid_argument("unknown target " + name);
+                options.targets.push_back(target);
+            } else if (arg == "--iterations") {
+                options.iterations = std::stoull(value());
+            } else if (arg == "--max-nodes") {
+                options.max_nodes = std::stoull(value());
+            } else if (arg == "--seed") {
+                options.seed = std::stoull(value());
+            } else if (arg == "--out") {
+                options.out_dir = value();
+            } else if (arg == "--objective") {
+                std::string objective = value();
+                if (objective == "allocations")
+                    options.objective = Objective::allocations;
+                else if (objective == "visits")
+                    options.objective = Objective::node_visits;
+                else
+                    throw std::invalid_argument("unknown objective " + objective);
+            } else if (arg == "--allocations-per-node") {
+                options.budget.allocations_per_node = std::stod(value());
+            } else if (arg == "--visits-per-node") {
+                options.budget.visits_per_node = std::stod(value());
+            } else if (arg == "--ns-per-node") {
+                options.budget.nanoseconds_per_node = std::stod(value());
+            } else if (arg == "--replay") {
+                options.replay.assign(argv + i + 1, argv + argc);
+                if (options.replay.empty())
+                    throw std::invalid_argument("--replay needs at least one case");
+                break;
+            } else {
+                throw std::invalid_argument("unknown option " + arg);
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!options.replay.empty())
+        return replay(options);
+
+    if (options.targets.empty())
+        for (const Target &target : targets())
+            options.targets.push_back(&target);
+    std::filesystem::create_directories(options.out_dir);
+    for (const Target *target : options.targets)
+        fuzz(*target, options);
+    return 0;
+}
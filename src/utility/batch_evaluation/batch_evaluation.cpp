@@ -0,0 +1,243 @@
+#include "batch_evaluation.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// values evaluated together, each stack slot is a column of this many values
+constexpr size_t lanes = 256;
+// values a thread claims at a time
+constexpr Natural chunk_size = Natural(1) << 16;
+
+bool has_quantifier(FormulaPtr f) {
+    if (std::holds_alternative<ForallFormula>(f->data) || std::holds_alternative<ExistsFormula>(f->data))
+        return true;
+    if (auto p = std::get_if<NotFormula>(&f->data))
+        return has_quantifier(p->inner);
+    if (auto p = std::get_if<AndFormula>(&f->data))
+        return has_quantifier(p->l) || has_quantifier(p->r);
+    if (auto p = std::get_if<OrFormula>(&f->data))
+        return has_quantifier(p->l) || has_quantifier(p->r);
+    if (auto p = std::get_if<ImpliesFormula>(&f->data))
+        return has_quantifier(p->l) || has_quantifier(p->r);
+    return false;
+}
+
+/**
+ * @brief runs a branch free program with at most one parameter on consecutive values of it, every instruction is a
+ * loop over the lanes with no dependency between iterations, which the compiler turns into SIMD code
+ */
+class LaneInterpreter {
+  public:
+    /// the results for first .. first + count - 1, valid until the next run
+    const Natural *run(const FormulaProgram &program, Natural first, size_t count) {
+        if (stack.size() < program.max_stack * lanes)
+            stack.resize(program.max_stack * lanes);
+        std::fill(overflow.begin(), overflow.end(), 0);
+
+        // sp points at the first column past the top of the stack
+        Natural *sp = stack.data();
+        for (const Instruction &in : program.code) {
+            switch (in.op) {
+            case OpCode::push_constant: {
+                Natural value = program.constants[in.operand];
+                for (size_t i = 0; i < count; ++i)
+                    sp[i] = value;
+                sp += lanes;
+                break;
+            }
+            case OpCode::load_register:
+                for (size_t i = 0; i < count; ++i)
+                    sp[i] = first + (Natural)i;
+                sp += lanes;
+                break;
+            case OpCode::add:
+                checked(sp, count, [](Natural a, Natural b, Natural *r) { return __builtin_add_overflow(a, b, r); });
+                break;
+            case OpCode::multiply:
+                checked(sp, count, [](Natural a, Natural b, Natural *r) { return __builtin_mul_overflow(a, b, r); });
+                break;
+            case OpCode::successor:
+                for (size_t i = 0; i < count; ++i)
+                    overflow[i] |= __builtin_add_overflow(sp[i - lanes], 1, &sp[i - lanes]);
+                break;
+            case OpCode::equal:
+                binary(sp, count, [](Natural a, Natural b) -> Natural { return a == b; });
+                break;
+            case OpCode::less:
+                binary(sp, count, [](Natural a, Natural b) -> Natural { return a < b; });
+                break;
+            case OpCode::less_equal:
+                binary(sp, count, [](Natural a, Natural b) -> Natural { return a <= b; });
+                break;
+            case OpCode::greater:
+                binary(sp, count, [](Natural a, Natural b) -> Natural { return a > b; });
+                break;
+            case OpCode::logical_and:
+                binary(sp, count, [](Natural a, Natural b) -> Natural { return a && b; });
+                break;
+            case OpCode::logical_or:
+                binary(sp, count, [](Natural a, Natural b) -> Natural { return a || b; });
+                break;
+            case OpCode::negate:
+                for (size_t i = 0; i < count; ++i)
+                    sp[i - lanes] = !sp[i - lanes];
+                break;
+            case OpCode::call_function:
+            case OpCode::call_relation: {
+                // user symbols are called lane by lane, the result overwrites the first argument's column
+                sp -= in.flag * lanes;
+                arguments.resize(in.flag);
+                for (size_t i = 0; i < count; ++i) {
+                    for (size_t a = 0; a < in.flag; ++a)
+                        arguments[a] = sp[a * lanes + i];
+                    sp[i] = in.op == OpCode::call_function ? program.functions[in.operand](arguments)
+                                                           : (Natural)program.relations[in.operand](arguments);
+                }
+                sp += lanes;
+                break;
+            }
+            case OpCode::halt:
+                return sp - lanes;
+            default:
+                throw std::logic_error("LaneInterpreter: the program isn't branch free");
+            }
+        }
+        throw std::logic_error("LaneInterpreter: the program has no halt");
+    }
+
+    /// whether the arithmetic of each lane left the range of Natural in the last run, like
+    /// BytecodeInterpreter::overflowed
+    const unsigned char *overflowed() const { return overflow.data(); }
+
+  private:
+    std::vector<Natural> stack;
+    std::vector<Natural> arguments;
+    std::vector<unsigned char> overflow = std::vector<unsigned char>(lanes);
+
+    template <typename Op> static void binary(Natural *&sp, size_t count, Op op) {
+        sp -= lanes;
+        Natural *a = sp - lanes;
+        const Natural *b = sp;
+        for (size_t i = 0; i < count; ++i)
+            a[i] = op(a[i], b[i]);
+    }
+
+    // op stores a op b and returns whether it overflowed
+    template <typename Op> void checked(Natural *&sp, size_t count, Op op) {
+        sp -= lanes;
+        Natural *a = sp - lanes;
+        const Natural *b = sp;
+        for (size_t i = 0; i < count; ++i)
+            overflow[i] |= op(a[i], b[i], &a[i]);
+    }
+};
+
+} // namespace
+
+std::optional<Natural> find_falsifying_value(FormulaPtr f, Natural first, Natural last,
+                                             const NaturalInterpretation &interpretation, unsigned num_threads) {
+    if (first >= last)
+        return std::nullopt;
+
+    // the variable ranged over, either bound by an outermost ∀ over ℕ or the one free variable
+    FormulaPtr body = f;
+    std::vector<std::string> parameters;
+    auto forall = std::get_if<ForallFormula>(&f->data);
+    auto domain = forall ? std::get_if<ConstantTerm>(&forall->domain->data) : nullptr;
+    if (domain && domain->c == "ℕ") {
+        body = forall->inner;
+        parameters.push_back(forall->v);
+    } else {
+        std::set<std::string> vars;
+        collect_vars_in_formula(f, vars);
+        for (auto &v : vars)
+            if (is_free_in(v, f))
+                parameters.push_back(v);
+        if (parameters.size() > 1)
+            throw std::invalid_argument("find_falsifying_value: the formula has more than one free variable");
+    }
+
+    const bool in_lanes = !has_quantifier(body);
+    const FormulaProgram program = compile_formula(body, parameters, interpretation, in_lanes);
+
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    Natural num_chunks = (last - first - 1) / chunk_size + 1;
+    num_threads = (unsigned)std::min<Natural>(num_threads, num_chunks);
+
+    // chunks are claimed in increasing order and a thread finishes every chunk below the best failure so far, so
+    // when all threads are done the best failure is the smallest one
+    std::atomic<Natural> next_chunk{first};
+    std::atomic<Natural> first_failure{last};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto record_failure = [&](Natural value) {
+        Natural best = first_failure.load();
+        while (value < best && !first_failure.compare_exchange_weak(best, value)) {
+        }
+    };
+
+    auto worker = [&]() {
+        try {
+            LaneInterpreter lane_interpreter;
+            BytecodeInterpreter interpreter;
+            for (;;) {
+                Natural start = next_chunk.fetch_add(chunk_size);
+                if (start >= last || start >= first_failure.load())
+                    return;
+                Natural end = last - start > chunk_size ? start + chunk_size : last;
+
+                if (in_lanes) {
+                    for (Natural block = start; block < end && block < first_failure.load(); block += lanes) {
+                        size_t count = (size_t)std::min<Natural>(lanes, end - block);
+                        const Natural *result = lane_interpreter.run(program, block, count);
+                        const unsigned char *overflowed = lane_interpreter.overflowed();
+                        size_t falsified = 0;
+                        while (falsified < count && (result[falsified] || overflowed[falsified]))
+                            ++falsified;
+                        if (falsified < count) {
+                            record_failure(block + (Natural)falsified);
+                            break;
+                        }
+                    }
+                } else {
+                    for (Natural value = start; value < end && value < first_failure.load(); ++value) {
+                        if (!interpreter.evaluate(program, std::span<const Natural>(&value, parameters.size())) &&
+                            !interpreter.overflowed()) {
+                            record_failure(value);
+                            break;
+                        }
+                    }
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            // stop the other threads
+            first_failure = first;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+    if (first_failure.load() == last)
+        return std::nullopt;
+    return first_failure.load();
+}
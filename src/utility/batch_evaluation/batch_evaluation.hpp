@@ -0,0 +1,23 @@
+#ifndef BATCH_EVALUATION_HPP
+#define BATCH_EVALUATION_HPP
+
+#include "../formula_bytecode/formula_bytecode.hpp"
+#include "../proof_system/proof_system.hpp"
+#include <optional>
+
+/**
+ * @brief the smallest value in [first, last) for which the formula is false
+ *
+ * the formula is either (∀v ∈ ℕ)(P(v)), in which case P is checked, or has at most one free variable. values are
+ * evaluated in blocks of lanes, each opcode applied to the whole block at once so the arithmetic and comparisons
+ * vectorize, and the range is split into chunks shared out between num_threads threads (0 for one per core).
+ * formulas with inner quantifiers can't be run in lanes and are evaluated value by value, still on all threads.
+ * a value whose arithmetic overflows a Natural is neither a counterexample nor a confirmation and is skipped, like
+ * instances that leave the truncated domain of the counterexample search.
+ *
+ * user functions in the interpretation are called from several threads at once.
+ */
+std::optional<Natural> find_falsifying_value(FormulaPtr f, Natural first, Natural last,
+                                             const NaturalInterpretation &interpretation, unsigned num_threads = 0);
+
+#endif // BATCH_EVALUATION_HPP
@@ -0,0 +1,159 @@
+#include "bdd.hpp"
+
+#include <algorithm>
+
+namespace {
+
+constexpr size_t initial_unique_capacity = 1 << 10;
+constexpr size_t computed_table_size = 1 << 16; // a power of two
+
+std::uint64_t mix(std::uint64_t a, std::uint64_t b, std::uint64_t c) {
+    return hash_combine(hash_combine(a, b), c);
+}
+
+} // namespace
+
+BddManager::BddManager() { clear(); }
+
+void BddManager::clear() {
+    nodes.clear();
+    nodes.push_back({terminal_var, false_bdd, false_bdd});
+    nodes.push_back({terminal_var, true_bdd, true_bdd});
+    unique_table.assign(initial_unique_capacity, 0);
+    unique_count = 0;
+    computed_table.assign(computed_table_size, ComputedEntry{Op::bdd_and, 0, 0, 0});
+    atoms.clear();
+    num_atoms = 0;
+}
+
+Bdd BddManager::make_node(std::uint32_t var, Bdd low, Bdd high) {
+    // reduced: a test whose outcome doesn't matter is no test
+    if (low == high)
+        return low;
+
+    size_t mask = unique_table.size() - 1;
+    for (size_t i = mix(var, low, high) & mask;; i = (i + 1) & mask) {
+        Bdd id = unique_table[i];
+        if (id == 0) {
+            id = (Bdd)nodes.size();
+            nodes.push_back({var, low, high});
+            unique_table[i] = id;
+            // keep the table at most half full so probes stay short
+            if (++unique_count * 2 > unique_table.size())
+                grow_unique_table();
+            return id;
+        }
+        const Node &n = nodes[id];
+        if (n.var == var && n.low == low && n.high == high)
+            return id;
+    }
+}
+
+void BddManager::grow_unique_table() {
+    std::vector<Bdd> grown(unique_table.size() * 2, 0);
+    size_t mask = grown.size() - 1;
+    for (Bdd id : unique_table) {
+        if (id == 0)
+            continue;
+        const Node &n = nodes[id];
+        size_t i = mix(n.var, n.low, n.high) & mask;
+        while (grown[i] != 0)
+            i = (i + 1) & mask;
+        grown[i] = id;
+    }
+    unique_table = std::move(grown);
+}
+
+Bdd BddManager::variable(std::uint32_t var) { return make_node(var, false_bdd, true_bdd); }
+
+BddManager::ComputedEntry &BddManager::computed_slot(Op op, Bdd a, Bdd b) {
+    return computed_table[mix((std::uint64_t)op, a, b) & (computed_table.size() - 1)];
+}
+
+Bdd BddManager::apply(Op op, Bdd a, Bdd b) {
+    // terminal cases, none of which reach the computed table
+    switch (op) {
+    case Op::bdd_not:
+        if (a <= true_bdd)
+            return a == true_bdd ? false_bdd : true_bdd;
+        break;
+    case Op::bdd_and:
+        if (a == false_bdd || b == false_bdd)
+            return false_bdd;
+        if (a == true_bdd || a == b)
+            return b;
+        if (b == true_bdd)
+            return a;
+        break;
+    case Op::bdd_or:
+        if (a == true_bdd || b == true_bdd)
+            return true_bdd;
+        if (a == false_bdd || a == b)
+            return b;
+        if (b == false_bdd)
+            return a;
+        break;
+    }
+    // and and or commute, so only one argument order is cached
+    if (op != Op::bdd_not && a > b)
+        std::swap(a, b);
+
+    ComputedEntry &entry = computed_slot(op, a, b);
+    if (entry.a == a && entry.b == b && entry.op == op)
+        return entry.result;
+
+    // shannon expansion on the smallest variable of the two
+    const Node na = nodes[a];
+    const Node nb = nodes[b];
+    std::uint32_t var = op == Op::bdd_not ? na.var : std::min(na.var, nb.var);
+    Bdd a_low = na.var == var ? na.low : a, a_high = na.var == var ? na.high : a;
+    Bdd b_low = nb.var == var ? nb.low : b, b_high = nb.var == var ? nb.high : b;
+
+    Bdd low = apply(op, a_low, b_low);
+    Bdd high = apply(op, a_high, b_high);
+    Bdd result = make_node(var, low, high);
+
+    // the computed table never resizes, so the entry is still valid after the recursion
+    entry = {op, a, b, result};
+    return result;
+}
+
+Bdd BddManager::bdd_not(Bdd a) { return apply(Op::bdd_not, a, a); }
+Bdd BddManager::bdd_and(Bdd a, Bdd b) { return apply(Op::bdd_and, a, b); }
+Bdd BddManager::bdd_or(Bdd a, Bdd b) { return apply(Op::bdd_or, a, b); }
+Bdd BddManager::bdd_implies(Bdd a, Bdd b) { return bdd_or(bdd_not(a), b); }
+
+std::uint32_t BddManager::atom_variable(FormulaPtr atom) {
+    std::uint64_t h = hash_formula(atom);
+    auto [begin, end] = atoms.equal_range(h);
+    for (auto it = begin; it != end; ++it)
+        if (alpha_equivalent(it->second.first, atom))
+            return it->second.second;
+    atoms.emplace(h, std::make_pair(atom, num_atoms));
+    return num_atoms++;
+}
+
+Bdd BddManager::from_formula(FormulaPtr f) {
+    std::unordered_map<const Formula *, Bdd> seen;
+    return from_formula(f, seen);
+}
+
+Bdd BddManager::from_formula(const FormulaPtr &f, std::unordered_map<const Formula *, Bdd> &seen) {
+    // formulas share subformulas, without this a DAG costs as much as its unfolded tree
+    if (auto it = seen.find(f.get()); it != seen.end())
+        return it->second;
+
+    Bdd result;
+    if (auto p = std::get_if<NotFormula>(&f->data))
+        result = bdd_not(from_formula(p->inner, seen));
+    else if (auto p = std::get_if<AndFormula>(&f->data))
+        result = bdd_and(from_formula(p->l, seen), from_formula(p->r, seen));
+    else if (auto p = std::get_if<OrFormula>(&f->data))
+        result = bdd_or(from_formula(p->l, seen), from_formula(p->r, seen));
+    else if (auto p = std::get_if<ImpliesFormula>(&f->data))
+        result = bdd_implies(from_formula(p->l, seen), from_formula(p->r, seen));
+    else
+        result = variable(atom_variable(f));
+    seen.emplace(f.get(), result);
+    return result;
+}
@@ -0,0 +1,77 @@
+#ifndef BDD_HPP
+#define BDD_HPP
+
+#include "../proof_system/proof_system.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using Bdd = std::uint32_t;
+
+/**
+ * @brief reduced ordered binary decision diagrams over the propositional structure of formulas
+ *
+ * nodes are hash consed through a unique table, so two BDDs built by the same manager represent the same boolean
+ * function iff they are the same id, and results of and / or / not / implies are kept in a computed table so
+ * rebuilding a formula whose parts were seen before is cheap.
+ *
+ * every subformula that isn't a connective (equalities, relations and quantified formulas) is an atom, atoms are
+ * identified by their alpha invariant hash and get variables in the order they are first seen.
+ */
+class BddManager {
+  public:
+    static constexpr Bdd false_bdd = 0;
+    static constexpr Bdd true_bdd = 1;
+
+    BddManager();
+
+    Bdd variable(std::uint32_t var);
+    Bdd bdd_not(Bdd a);
+    Bdd bdd_and(Bdd a, Bdd b);
+    Bdd bdd_or(Bdd a, Bdd b);
+    Bdd bdd_implies(Bdd a, Bdd b);
+
+    Bdd from_formula(FormulaPtr f);
+    /// the variable standing for an atom, assigning the next free one if the atom is new
+    std::uint32_t atom_variable(FormulaPtr atom);
+
+    size_t size() const { return nodes.size(); }
+    /// drops every node, cached result and atom
+    void clear();
+
+  private:
+    static constexpr std::uint32_t terminal_var = 0xffffffff;
+
+    struct Node {
+        std::uint32_t var;
+        Bdd low, high;
+    };
+
+    enum class Op : std::uint32_t { bdd_and, bdd_or, bdd_not };
+
+    struct ComputedEntry {
+        Op op;
+        Bdd a, b, result; // a == 0 marks an empty entry, operations on false never get this far
+    };
+
+    std::vector<Node> nodes;
+
+    // open addressing, slots hold node ids and 0 marks an empty slot (the false terminal is never looked up)
+    std::vector<Bdd> unique_table;
+    size_t unique_count = 0;
+
+    // direct mapped and lossy, a miss only costs recomputing
+    std::vector<ComputedEntry> computed_table;
+
+    std::unordered_multimap<std::uint64_t, std::pair<FormulaPtr, std::uint32_t>> atoms;
+    std::uint32_t num_atoms = 0;
+
+    Bdd make_node(std::uint32_t var, Bdd low, Bdd high);
+    void grow_unique_table();
+    Bdd apply(Op op, Bdd a, Bdd b);
+    ComputedEntry &computed_slot(Op op, Bdd a, Bdd b);
+    Bdd from_formula(const FormulaPtr &f, std::unordered_map<const Formula *, Bdd> &seen);
+};
+
+#endif // BDD_HPP
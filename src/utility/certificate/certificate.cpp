@@ -0,0 +1,180 @@
+#include "certificate.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+constexpr char certificate_magic[8] = {'M', 'W', 'E', 'C', 'E', 'R', 'T', '1'};
+constexpr std::uint32_t certificate_version = 2;
+
+// everything is written as little endian u32s, the host byte order on every platform we build for
+class Writer {
+  public:
+    std::string bytes;
+
+    void u32(std::uint32_t v) { bytes.append(reinterpret_cast<const char *>(&v), sizeof(v)); }
+    void u32s(const std::vector<std::uint32_t> &vs) {
+        u32((std::uint32_t)vs.size());
+        bytes.append(reinterpret_cast<const char *>(vs.data()), vs.size() * sizeof(std::uint32_t));
+    }
+};
+
+class Reader {
+  public:
+    explicit Reader(std::string_view bytes) : bytes(bytes) {}
+
+    const char *take(size_t n) {
+        if (n > bytes.size() - pos)
+            throw std::invalid_argument("certificate is truncated");
+        const char *p = bytes.data() + pos;
+        pos += n;
+        return p;
+    }
+    std::uint32_t u32() {
+        std::uint32_t v;
+        std::memcpy(&v, take(sizeof(v)), sizeof(v));
+        return v;
+    }
+    /// a count of records that are at least record_size bytes each, checked against what is left before anything is
+    /// allocated for them
+    std::uint32_t count(size_t record_size) {
+        std::uint32_t n = u32();
+        if ((std::uint64_t)n * record_size > bytes.size() - pos)
+            throw std::invalid_argument("certificate is truncated");
+        return n;
+    }
+    std::vector<std::uint32_t> u32s() {
+        std::uint32_t n = count(sizeof(std::uint32_t));
+        const char *p = take((size_t)n * sizeof(std::uint32_t));
+        std::vector<std::uint32_t> vs(n);
+        if (n > 0)
+            std::memcpy(vs.data(), p, (size_t)n * sizeof(std::uint32_t));
+        return vs;
+    }
+    bool at_end() const { return pos == bytes.size(); }
+
+  private:
+    std::string_view bytes;
+    size_t pos = 0;
+};
+
+} // namespace
+
+std::string serialize_certificate(const Certificate &certificate) {
+    Writer w;
+    w.bytes.append(certificate_magic, sizeof(certificate_magic));
+    w.u32(certificate_version);
+
+    const FlatFormulaTable &nodes = certificate.nodes;
+    w.u32((std::uint32_t)nodes.symbols.size());
+    for (auto &symbol : nodes.symbols) {
+        w.u32((std::uint32_t)symbol.size());
+        w.bytes.append(symbol);
+    }
+
+    w.u32((std::uint32_t)nodes.nodes.size());
+    for (auto &n : nodes.nodes) {
+        w.u32((std::uint32_t)n.kind);
+        w.u32(n.symbol);
+        w.u32(n.first_child);
+        w.u32(n.child_count);
+    }
+    w.u32s(nodes.children);
+
+    w.u32s(certificate.assumptions);
+    w.u32s(certificate.lemmas);
+
+    w.u32(certificate.goal);
+    w.u32((std::uint32_t)certificate.targets.size());
+    for (auto &target : certificate.targets) {
+        w.u32(target.formula);
+        w.u32(target.parent);
+        w.u32((std::uint32_t)target.step);
+        w.u32(target.hypothesis);
+        w.u32(target.line);
+    }
+
+    w.u32((std::uint32_t)certificate.lines.size());
+    for (auto &line : certificate.lines) {
+        w.u32(line.statement);
+        w.u32((std::uint32_t)line.rule);
+        w.u32(line.first_dependency);
+        w.u32(line.dependency_count);
+        w.u32(line.context);
+    }
+    w.u32s(certificate.dependencies);
+    return std::move(w.bytes);
+}
+
+Certificate parse_certificate(std::string_view bytes) {
+    Reader r(bytes);
+    if (std::memcmp(r.take(sizeof(certificate_magic)), certificate_magic, sizeof(certificate_magic)) != 0)
+        throw std::invalid_argument("not a proof certificate");
+    if (r.u32() != certificate_version)
+        throw std::invalid_argument("unsupported certificate version");
+
+    Certificate certificate;
+    FlatFormulaTable &nodes = certificate.nodes;
+
+    // a symbol is at least its length
+    nodes.symbols.resize(r.count(sizeof(std::uint32_t)));
+    for (auto &symbol : nodes.symbols) {
+        std::uint32_t length = r.u32();
+        symbol.assign(r.take(length), length);
+    }
+
+    nodes.nodes.resize(r.count(4 * sizeof(std::uint32_t)));
+    for (auto &n : nodes.nodes) {
+        n.kind = (NodeKind)r.u32();
+        n.symbol = r.u32();
+        n.first_child = r.u32();
+        n.child_count = r.u32();
+    }
+    nodes.children = r.u32s();
+
+    certificate.assumptions = r.u32s();
+    certificate.lemmas = r.u32s();
+
+    certificate.goal = r.u32();
+    certificate.targets.resize(r.count(5 * sizeof(std::uint32_t)));
+    for (auto &target : certificate.targets) {
+        target.formula = r.u32();
+        target.parent = r.u32();
+        target.step = (TargetStep)r.u32();
+        target.hypothesis = r.u32();
+        target.line = r.u32();
+    }
+
+    certificate.lines.resize(r.count(5 * sizeof(std::uint32_t)));
+    for (auto &line : certificate.lines) {
+        line.statement = r.u32();
+        line.rule = (CertificateRule)r.u32();
+        line.first_dependency = r.u32();
+        line.dependency_count = r.u32();
+        line.context = r.u32();
+    }
+    certificate.dependencies = r.u32s();
+
+    if (!r.at_end())
+        throw std::invalid_argument("trailing bytes after certificate");
+    return certificate;
+}
+
+void save_certificate(const Certificate &certificate, const std::string &path) {
+    std::ofstream out(path, std::ios::binary);
+    std::string bytes = serialize_certificate(certificate);
+    out.write(bytes.data(), bytes.size());
+    if (!out)
+        throw std::runtime_error("could not write certificate to " + path);
+}
+
+Certificate load_certificate(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("could not open certificate " + path);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return parse_certificate(bytes);
+}
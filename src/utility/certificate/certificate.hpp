@@ -0,0 +1,94 @@
+#ifndef CERTIFICATE_HPP
+#define CERTIFICATE_HPP
+
+#include "../flat_formula/flat_formula.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief the rules a certificate can be checked against, numbered so that the format doesn't depend on rule names
+ */
+enum class CertificateRule : std::uint8_t {
+    assumption,
+    lemma,
+    and_intro,
+    forall_elim,
+    implies_elim,
+    eq_refl,
+    induction,
+    excluded_middle,
+    cases,
+    eq_sym,
+    eq_trans,
+    eq_cong,
+};
+
+/// marks a target without a parent, a line resting on no hypothesis, or a target without a line
+constexpr std::uint32_t no_target = 0xffffffff;
+constexpr std::uint32_t no_line = 0xffffffff;
+
+struct CertificateLine {
+    std::uint32_t statement;
+    CertificateRule rule;
+    std::uint32_t first_dependency;
+    std::uint32_t dependency_count;
+    // the deepest target whose hypothesis the line rests on, the line can only be used below that target
+    std::uint32_t context;
+};
+
+/**
+ * @brief how a target was proven, from the cases it was replaced with or a line
+ */
+enum class TargetStep : std::uint8_t {
+    /// by the statement of its line
+    closed,
+    /// ∀x ∈ D P(x) by its one case P(y), for a variable y free in neither the target nor any hypothesis or
+    /// assumption, under the hypothesis y ∈ D
+    forall,
+    /// A → B by its one case B under the hypothesis A
+    implication,
+    /// ∀n ∈ ℕ P(n) by its two cases P(0) and ∀k ∈ ℕ (P(k) → P(k + 1))
+    induction,
+    /// by its one case, the target with occurrences of a replaced by b, for the equality a = b on its line
+    rewrite,
+};
+
+struct CertificateTarget {
+    std::uint32_t formula;
+    // the target this is a case of, targets come after their parent, no_target for the goal
+    std::uint32_t parent;
+    TargetStep step;
+    // forall and implication: the hypothesis the case is proven under, no_node otherwise
+    std::uint32_t hypothesis;
+    // closed: the line proving the target, rewrite: the equality, no_line otherwise
+    std::uint32_t line;
+};
+
+/**
+ * @brief a completed proof reduced to what is needed to re-check it: a node table, the lines with their rule ids and
+ * dependencies, and the tree of targets that leads from the goal to the lines
+ *
+ * the first target is the goal, every other target is a case of an earlier one. hypotheses introduced by a target
+ * hold only for the targets below it and the lines resting on it. lemmas are statements that were cited from a
+ * LemmaStore and are taken as given.
+ */
+struct Certificate {
+    FlatFormulaTable nodes;
+    std::vector<std::uint32_t> assumptions;
+    std::vector<std::uint32_t> lemmas;
+    std::uint32_t goal = no_node;
+    std::vector<CertificateTarget> targets;
+    std::vector<CertificateLine> lines;
+    std::vector<std::uint32_t> dependencies;
+};
+
+std::string serialize_certificate(const Certificate &certificate);
+/// throws std::invalid_argument if the bytes aren't a certificate
+Certificate parse_certificate(std::string_view bytes);
+
+void save_certificate(const Certificate &certificate, const std::string &path);
+Certificate load_certificate(const std::string &path);
+
+#endif // CERTIFICATE_HPP
@@ -0,0 +1,547 @@
+#include "certificate_checker.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr std::uint8_t is_assumption = 1;
+constexpr std::uint8_t is_lemma = 2;
+
+bool is_term_node(const FlatNode &n) { return n.kind <= NodeKind::tuple; }
+
+class Checker {
+  public:
+    explicit Checker(const Certificate &certificate)
+        : certificate(certificate), table(certificate.nodes), nodes(certificate.nodes.nodes),
+          flags(certificate.nodes.nodes.size(), 0) {
+        // a loaded table has no symbol index, and these are the only names the checker ever needs
+        for (std::uint32_t i = 0; i < table.symbols.size(); ++i) {
+            const std::string &symbol = table.symbols[i];
+            if (symbol == "∈")
+                element_of = i;
+            else if (symbol == "0")
+                zero = i;
+            else if (symbol == "1")
+                one = i;
+            else if (symbol == "+")
+                plus = i;
+            else if (symbol == "ℕ")
+                naturals = i;
+        }
+    }
+
+    CertificateCheckResult run() {
+        std::string err;
+        if (!table.is_well_formed(&err))
+            return fail("malformed node table: " + err);
+
+        for (auto ids : {&certificate.assumptions, &certificate.lemmas}) {
+            std::uint8_t flag = ids == &certificate.lemmas ? is_lemma : is_assumption;
+            for (std::uint32_t id : *ids) {
+                if (!is_formula(id))
+                    return fail("assumption or lemma is not a formula node");
+                flags[id] |= flag;
+            }
+        }
+
+        if (!is_formula(certificate.goal))
+            return fail("the goal is not a formula node");
+        if (std::string why = index_targets(); !why.empty())
+            return fail(why);
+
+        const auto &lines = certificate.lines;
+        for (std::uint32_t i = 0; i < lines.size(); ++i) {
+            const CertificateLine &line = lines[i];
+            if (!is_formula(line.statement))
+                return fail("line " + std::to_string(i) + ": statement is not a formula node");
+            if (line.context != no_target && (line.context >= targets.size() || !has_hypothesis(line.context)))
+                return fail("line " + std::to_string(i) + ": rests on a target without a hypothesis");
+            if ((std::uint64_t)line.first_dependency + line.dependency_count > certificate.dependencies.size())
+                return fail("line " + std::to_string(i) + ": dependencies out of range");
+            for (std::uint32_t d = 0; d < line.dependency_count; ++d) {
+                std::uint32_t dependency = certificate.dependencies[line.first_dependency + d];
+                if (dependency >= i)
+                    return fail("line " + std::to_string(i) + ": depends on a later line");
+                if (!in_scope(lines[dependency].context, line.context))
+                    return fail("line " + std::to_string(i) + ": depends on line " + std::to_string(dependency) +
+                                ", which rests on a hypothesis it doesn't have");
+            }
+
+            if (!check_line(line))
+                return fail("line " + std::to_string(i) + ": does not follow by rule " +
+                            std::to_string((int)line.rule));
+            if (line.rule == CertificateRule::lemma)
+                cited_lemmas.push_back(line.statement);
+        }
+
+        if (!equivalent(targets[0].formula, certificate.goal))
+            return fail("the first target is not the goal");
+        for (std::uint32_t i = 0; i < targets.size(); ++i)
+            if (!check_target(i))
+                return fail("target " + std::to_string(i) + ": does not follow from its cases by step " +
+                            std::to_string((int)targets[i].step));
+
+        std::sort(cited_lemmas.begin(), cited_lemmas.end());
+        cited_lemmas.erase(std::unique(cited_lemmas.begin(), cited_lemmas.end()), cited_lemmas.end());
+        return {true, "", std::move(cited_lemmas)};
+    }
+
+  private:
+    const Certificate &certificate;
+    const FlatFormulaTable &table;
+    const std::vector<FlatNode> &nodes;
+    const std::vector<CertificateTarget> &targets = certificate.targets;
+    std::vector<std::uint8_t> flags;
+    std::vector<std::uint32_t> cited_lemmas;
+
+    // the cases of target i are cases[first_case[i] .. first_case[i + 1]), in order
+    std::vector<std::uint32_t> first_case;
+    std::vector<std::uint32_t> cases;
+    // targets numbered in depth first order, the targets below i are the ones numbered (enter[i], leave[i])
+    std::vector<std::uint32_t> enter;
+    std::vector<std::uint32_t> leave;
+    // symbols of variables free in some assumption, they can't be the variable a ∀ target is proven for
+    std::vector<bool> free_in_assumptions;
+
+    std::uint32_t element_of = no_symbol, zero = no_symbol, one = no_symbol, plus = no_symbol, naturals = no_symbol;
+
+    static CertificateCheckResult fail(std::string why) { return {false, std::move(why), {}}; }
+
+    std::uint32_t child(std::uint32_t node, std::uint32_t i) const {
+        return certificate.nodes.children[nodes[node].first_child + i];
+    }
+    bool is(std::uint32_t node, NodeKind kind) const { return nodes[node].kind == kind; }
+    bool is_formula(std::uint32_t node) const { return node < nodes.size() && !is_term_node(nodes[node]); }
+    bool is_naturals(std::uint32_t node) const {
+        return is(node, NodeKind::constant) && nodes[node].symbol == naturals;
+    }
+
+    std::uint32_t dependency(const CertificateLine &line, std::uint32_t i) const {
+        return certificate.lines[certificate.dependencies[line.first_dependency + i]].statement;
+    }
+
+    // the symbols bound by the quantifiers enclosing the two nodes being matched, innermost last
+    using BinderScope = std::vector<std::pair<std::uint32_t, std::uint32_t>>;
+
+    // how many binders out the symbol is bound on the left (or right) side, or -1 if it's free
+    static int binder_depth(const BinderScope &scope, std::uint32_t symbol, bool right) {
+        for (size_t i = scope.size(); i-- > 0;)
+            if ((right ? scope[i].second : scope[i].first) == symbol)
+                return (int)(scope.size() - 1 - i);
+        return -1;
+    }
+
+    bool same_free_variable(std::uint32_t a, std::uint32_t b, const BinderScope &scope) const {
+        return is(b, NodeKind::variable) && nodes[b].symbol == nodes[a].symbol &&
+               binder_depth(scope, nodes[b].symbol, true) < 0;
+    }
+
+    // a named type rather than a lambda so that match doesn't instantiate itself with a new closure type forever
+    struct SameFreeVariable {
+        const Checker *checker;
+        bool operator()(std::uint32_t a, std::uint32_t b, const BinderScope &scope) const {
+            return checker->same_free_variable(a, b, scope);
+        }
+    };
+
+    /**
+     * @brief matches a against b up to the names of bound variables, free variables of a are matched by
+     * free_variable(a_node, b_node, scope)
+     *
+     * ids of hash consed nodes are only compared outside of any binder, inside one the same node can mean different
+     * things on either side
+     */
+    template <typename FreeVariable>
+    bool match(std::uint32_t a, std::uint32_t b, BinderScope &scope, const FreeVariable &free_variable) const {
+        const FlatNode &x = nodes[a];
+        const FlatNode &y = nodes[b];
+        if (x.kind == NodeKind::variable) {
+            int depth = binder_depth(scope, x.symbol, false);
+            if (depth >= 0)
+                return y.kind == NodeKind::variable && binder_depth(scope, y.symbol, true) == depth;
+            return free_variable(a, b, scope);
+        }
+        if (x.kind != y.kind || x.child_count != y.child_count)
+            return false;
+
+        if (x.kind == NodeKind::forall || x.kind == NodeKind::exists) {
+            // the domain is outside the scope of the binder and is never substituted into
+            if (!match(child(a, 0), child(b, 0), scope, SameFreeVariable{this}))
+                return false;
+            scope.emplace_back(x.symbol, y.symbol);
+            bool matched = match(child(a, 1), child(b, 1), scope, free_variable);
+            scope.pop_back();
+            return matched;
+        }
+
+        if (x.symbol != y.symbol)
+            return false;
+        for (std::uint32_t i = 0; i < x.child_count; ++i)
+            if (!match(child(a, i), child(b, i), scope, free_variable))
+                return false;
+        return true;
+    }
+
+    bool equivalent(std::uint32_t a, std::uint32_t b) const {
+        if (a == b)
+            return true;
+        BinderScope scope;
+        return match(a, b, scope, SameFreeVariable{this});
+    }
+
+    /**
+     * @brief is claim, up to bound variable names, the result of substituting the free occurrences of var in body by
+     * something accepted by is_replacement
+     *
+     * mirrors substitute_in_formula: quantifier domains are left alone and nothing is substituted below a quantifier
+     * that binds var
+     */
+    template <typename Replacement>
+    bool is_instance(std::uint32_t body, std::uint32_t var, std::uint32_t claim,
+                     const Replacement &is_replacement) const {
+        BinderScope scope;
+        return match(body, claim, scope, [&](std::uint32_t l, std::uint32_t r, const BinderScope &s) {
+            return nodes[l].symbol == var ? is_replacement(r) : same_free_variable(l, r, s);
+        });
+    }
+
+    // assumptions and lemmas are flagged by id, an ASSUMPTION or LEMMA line states the very node it cites
+    bool is_given(std::uint32_t claim, std::uint8_t flag) const { return flags[claim] & flag; }
+
+    bool has_hypothesis(std::uint32_t target) const {
+        return targets[target].step == TargetStep::forall || targets[target].step == TargetStep::implication;
+    }
+
+    /// true if what rests on the hypothesis of target context can be used at or below target
+    bool in_scope(std::uint32_t context, std::uint32_t target) const {
+        if (context == no_target)
+            return true;
+        return target != no_target && enter[context] <= enter[target] && leave[target] <= leave[context];
+    }
+
+    // checks that the targets form a tree under the first one, and numbers them depth first
+    std::string index_targets() {
+        if (targets.empty() || targets[0].parent != no_target)
+            return "the first target has to be the goal";
+        first_case.assign(targets.size() + 1, 0);
+        for (std::uint32_t i = 0; i < targets.size(); ++i) {
+            const CertificateTarget &target = targets[i];
+            if (!is_formula(target.formula))
+                return "target " + std::to_string(i) + ": not a formula node";
+            if (i > 0 && target.parent >= i)
+                return "target " + std::to_string(i) + ": has to come after its parent";
+            if (has_hypothesis(i) ? !is_formula(target.hypothesis) : target.hypothesis != no_node)
+                return "target " + std::to_string(i) + ": only ∀ and → steps introduce a hypothesis";
+            if (i > 0)
+                ++first_case[target.parent + 1];
+        }
+        for (std::uint32_t i = 0; i < targets.size(); ++i)
+            first_case[i + 1] += first_case[i];
+        cases.resize(targets.size() - 1);
+        std::vector<std::uint32_t> next(first_case.begin(), first_case.end() - 1);
+        for (std::uint32_t i = 1; i < targets.size(); ++i)
+            cases[next[targets[i].parent]++] = i;
+
+        enter.resize(targets.size());
+        leave.resize(targets.size());
+        std::uint32_t counter = 0;
+        std::vector<std::pair<std::uint32_t, bool>> stack{{0, false}};
+        while (!stack.empty()) {
+            auto [target, done] = stack.back();
+            stack.pop_back();
+            if (done) {
+                leave[target] = counter++;
+                continue;
+            }
+            enter[target] = counter++;
+            stack.emplace_back(target, true);
+            for (std::uint32_t c = first_case[target + 1]; c-- > first_case[target];)
+                stack.emplace_back(cases[c], false);
+        }
+        return "";
+    }
+
+    // every symbol a variable has free in node, like is_free domains of quantifiers are included
+    void collect_free(std::uint32_t node, BinderScope &scope, std::vector<bool> &symbols) const {
+        const FlatNode &n = nodes[node];
+        if (n.kind == NodeKind::variable) {
+            if (binder_depth(scope, n.symbol, false) < 0)
+                symbols[n.symbol] = true;
+            return;
+        }
+        if (n.kind == NodeKind::forall || n.kind == NodeKind::exists) {
+            collect_free(child(node, 0), scope, symbols);
+            scope.emplace_back(n.symbol, n.symbol);
+            collect_free(child(node, 1), scope, symbols);
+            scope.pop_back();
+            return;
+        }
+        for (std::uint32_t i = 0; i < n.child_count; ++i)
+            collect_free(child(node, i), scope, symbols);
+    }
+
+    bool is_free(std::uint32_t node, std::uint32_t symbol) const {
+        const FlatNode &n = nodes[node];
+        if (n.kind == NodeKind::variable)
+            return n.symbol == symbol;
+        if (n.kind == NodeKind::forall || n.kind == NodeKind::exists)
+            return is_free(child(node, 0), symbol) || (n.symbol != symbol && is_free(child(node, 1), symbol));
+        for (std::uint32_t i = 0; i < n.child_count; ++i)
+            if (is_free(child(node, i), symbol))
+                return true;
+        return false;
+    }
+
+    // the variable y of a ∀ step has to be arbitrary: not free in the target or in anything assumed above it
+    bool is_fresh(std::uint32_t symbol, std::uint32_t target) {
+        if (free_in_assumptions.empty()) {
+            free_in_assumptions.assign(table.symbols.size(), false);
+            BinderScope scope;
+            for (std::uint32_t a : certificate.assumptions)
+                collect_free(a, scope, free_in_assumptions);
+        }
+        if (free_in_assumptions[symbol] || is_free(targets[target].formula, symbol))
+            return false;
+        for (std::uint32_t t = targets[target].parent; t != no_target; t = targets[t].parent)
+            if (has_hypothesis(t) && is_free(targets[t].hypothesis, symbol))
+                return false;
+        return true;
+    }
+
+    bool captures(const BinderScope &scope, std::uint32_t term) const {
+        const FlatNode &n = nodes[term];
+        if (n.kind == NodeKind::variable)
+            return binder_depth(scope, n.symbol, false) >= 0 || binder_depth(scope, n.symbol, true) >= 0;
+        for (std::uint32_t i = 0; i < n.child_count; ++i)
+            if (captures(scope, child(term, i)))
+                return true;
+        return false;
+    }
+
+    /**
+     * @brief is b, up to bound variable names, a with some occurrences of the term from replaced by to
+     *
+     * mirrors substitute_term_in_formula: quantifier domains are left alone, and an occurrence under a binder of one
+     * of the variables of from or to is a different term that can't be replaced
+     */
+    bool is_rewrite(std::uint32_t a, std::uint32_t b, std::uint32_t from, std::uint32_t to, BinderScope &scope) const {
+        if (a == from && b == to && (scope.empty() || (!captures(scope, from) && !captures(scope, to))))
+            return true;
+        const FlatNode &x = nodes[a];
+        const FlatNode &y = nodes[b];
+        if (x.kind == NodeKind::variable)
+            return match(a, b, scope, SameFreeVariable{this});
+        if (x.kind != y.kind || x.child_count != y.child_count)
+            return false;
+
+        if (x.kind == NodeKind::forall || x.kind == NodeKind::exists) {
+            if (!match(child(a, 0), child(b, 0), scope, SameFreeVariable{this}))
+                return false;
+            scope.emplace_back(x.symbol, y.symbol);
+            bool rewritten = is_rewrite(child(a, 1), child(b, 1), from, to, scope);
+            scope.pop_back();
+            return rewritten;
+        }
+
+        if (x.symbol != y.symbol)
+            return false;
+        for (std::uint32_t i = 0; i < x.child_count; ++i)
+            if (!is_rewrite(child(a, i), child(b, i), from, to, scope))
+                return false;
+        return true;
+    }
+
+    // claim is ∀n ∈ ℕ P(n), base is P(0) and step is ∀k ∈ ℕ (P(k) → P(k + 1))
+    bool is_natural_induction(std::uint32_t claim, std::uint32_t base, std::uint32_t step) const {
+        // the step has to range over ℕ too, or it says nothing about every k ∈ ℕ
+        if (!is(step, NodeKind::forall) || !is_naturals(child(step, 0)) || !is(child(step, 1), NodeKind::implication))
+            return false;
+        std::uint32_t k = nodes[step].symbol;
+        std::uint32_t Pk = child(child(step, 1), 0);
+        std::uint32_t Psucc = child(child(step, 1), 1);
+
+        // base is P(0)
+        if (!is_instance(Pk, k, base, [&](std::uint32_t t) {
+                return is(t, NodeKind::constant) && nodes[t].symbol == zero;
+            }))
+            return false;
+
+        // step concludes P(k + 1)
+        if (!is_instance(Pk, k, Psucc, [&](std::uint32_t t) {
+                return is(t, NodeKind::function) && nodes[t].symbol == plus && nodes[t].child_count == 2 &&
+                       is(child(t, 0), NodeKind::variable) && nodes[child(t, 0)].symbol == k &&
+                       is(child(t, 1), NodeKind::constant) && nodes[child(t, 1)].symbol == one;
+            }))
+            return false;
+
+        // claim is ∀n ∈ ℕ P(n), i.e. alpha equivalent to ∀k ∈ ℕ P(k)
+        if (!is(claim, NodeKind::forall) || !is_naturals(child(claim, 0)))
+            return false;
+        BinderScope scope{{nodes[claim].symbol, k}};
+        return match(child(claim, 1), Pk, scope, SameFreeVariable{this});
+    }
+
+    bool check_target(std::uint32_t i) {
+        const CertificateTarget &target = targets[i];
+        const std::uint32_t formula = target.formula;
+        const std::uint32_t num_cases = first_case[i + 1] - first_case[i];
+        auto case_formula = [&](std::uint32_t c) { return targets[cases[first_case[i] + c]].formula; };
+        // a line used for the target, which has to rest only on hypotheses the target has
+        auto line_for = [&](std::uint32_t line) -> const CertificateLine * {
+            if (line >= certificate.lines.size() || !in_scope(certificate.lines[line].context, i))
+                return nullptr;
+            return &certificate.lines[line];
+        };
+
+        switch (target.step) {
+        case TargetStep::closed: {
+            const CertificateLine *line = line_for(target.line);
+            return num_cases == 0 && line && equivalent(line->statement, formula);
+        }
+
+        case TargetStep::implication:
+            return num_cases == 1 && is(formula, NodeKind::implication) && target.hypothesis == child(formula, 0) &&
+                   equivalent(case_formula(0), child(formula, 1));
+
+        case TargetStep::forall: {
+            // the hypothesis is y ∈ D for the case P(y) of ∀x ∈ D P(x)
+            std::uint32_t membership = target.hypothesis;
+            if (num_cases != 1 || !is(formula, NodeKind::forall) || !is(membership, NodeKind::relation) ||
+                nodes[membership].symbol != element_of || nodes[membership].child_count != 2 ||
+                child(membership, 1) != child(formula, 0) || !is(child(membership, 0), NodeKind::variable))
+                return false;
+            std::uint32_t y = child(membership, 0);
+            return is_fresh(nodes[y].symbol, i) &&
+                   is_instance(child(formula, 1), nodes[formula].symbol, case_formula(0),
+                               [&](std::uint32_t replaced) { return replaced == y; });
+        }
+
+        case TargetStep::induction:
+            return num_cases == 2 && is_natural_induction(formula, case_formula(0), case_formula(1));
+
+        case TargetStep::rewrite: {
+            const CertificateLine *line = line_for(target.line);
+            if (num_cases != 1 || !line || !is(line->statement, NodeKind::equality))
+                return false;
+            BinderScope scope;
+            return is_rewrite(formula, case_formula(0), child(line->statement, 0), child(line->statement, 1), scope);
+        }
+        }
+        return false;
+    }
+
+    bool check_line(const CertificateLine &line) const {
+        const std::uint32_t claim = line.statement;
+        const std::uint32_t num_deps = line.dependency_count;
+
+        switch (line.rule) {
+        case CertificateRule::assumption:
+            return num_deps == 0 && (is_given(claim, is_assumption) ||
+                                     (line.context != no_target && claim == targets[line.context].hypothesis));
+
+        case CertificateRule::lemma:
+            return num_deps == 0 && is_given(claim, is_lemma);
+
+        case CertificateRule::and_intro:
+            return num_deps == 2 && is(claim, NodeKind::conjunction) && equivalent(child(claim, 0), dependency(line, 0)) &&
+                   equivalent(child(claim, 1), dependency(line, 1));
+
+        case CertificateRule::implies_elim: {
+            if (num_deps != 2)
+                return false;
+            std::uint32_t implication = dependency(line, 0);
+            return is(implication, NodeKind::implication) && equivalent(child(implication, 0), dependency(line, 1)) &&
+                   equivalent(child(implication, 1), claim);
+        }
+
+        case CertificateRule::forall_elim: {
+            if (num_deps != 2)
+                return false;
+            std::uint32_t forall = dependency(line, 0);
+            std::uint32_t membership = dependency(line, 1);
+            if (!is(forall, NodeKind::forall) || !is(membership, NodeKind::relation) ||
+                nodes[membership].symbol != element_of || nodes[membership].child_count != 2 ||
+                child(membership, 1) != child(forall, 0))
+                return false;
+            std::uint32_t element = child(membership, 0);
+            return is_instance(child(forall, 1), nodes[forall].symbol, claim,
+                               [&](std::uint32_t replaced) { return replaced == element; });
+        }
+
+        case CertificateRule::eq_refl:
+            return num_deps == 0 && is(claim, NodeKind::equality) && child(claim, 0) == child(claim, 1);
+
+        case CertificateRule::excluded_middle:
+            if (num_deps != 0 || !is(claim, NodeKind::disjunction) || !is(child(claim, 1), NodeKind::negation))
+                return false;
+            return equivalent(child(child(claim, 1), 0), child(claim, 0));
+
+        case CertificateRule::cases: {
+            if (num_deps != 2)
+                return false;
+            std::uint32_t positive = dependency(line, 0);
+            std::uint32_t negative = dependency(line, 1);
+            if (!is(positive, NodeKind::implication) || !is(negative, NodeKind::implication) ||
+                !is(child(negative, 0), NodeKind::negation))
+                return false;
+            return equivalent(child(positive, 1), claim) && equivalent(child(negative, 1), claim) &&
+                   equivalent(child(child(negative, 0), 0), child(positive, 0));
+        }
+
+        // terms are hash consed, so every comparison of two terms is a comparison of ids
+        case CertificateRule::eq_sym: {
+            if (num_deps != 1)
+                return false;
+            std::uint32_t premise = dependency(line, 0);
+            return is(premise, NodeKind::equality) && is(claim, NodeKind::equality) &&
+                   child(premise, 0) == child(claim, 1) && child(premise, 1) == child(claim, 0);
+        }
+
+        case CertificateRule::eq_trans: {
+            if (num_deps == 0 || !is(claim, NodeKind::equality))
+                return false;
+            std::uint32_t end = child(claim, 0);
+            for (std::uint32_t i = 0; i < num_deps; ++i) {
+                std::uint32_t link = dependency(line, i);
+                if (!is(link, NodeKind::equality) || child(link, 0) != end)
+                    return false;
+                end = child(link, 1);
+            }
+            return end == child(claim, 1);
+        }
+
+        case CertificateRule::eq_cong: {
+            if (!is(claim, NodeKind::equality))
+                return false;
+            std::uint32_t l = child(claim, 0);
+            std::uint32_t r = child(claim, 1);
+            if (!is(l, NodeKind::function) || !is(r, NodeKind::function) || nodes[l].symbol != nodes[r].symbol ||
+                nodes[l].child_count != nodes[r].child_count)
+                return false;
+            std::uint32_t next = 0;
+            for (std::uint32_t i = 0; i < nodes[l].child_count; ++i) {
+                if (child(l, i) == child(r, i))
+                    continue;
+                if (next == num_deps)
+                    return false;
+                std::uint32_t premise = dependency(line, next++);
+                if (!is(premise, NodeKind::equality) || child(premise, 0) != child(l, i) ||
+                    child(premise, 1) != child(r, i))
+                    return false;
+            }
+            return next == num_deps;
+        }
+
+        case CertificateRule::induction:
+            return num_deps == 2 && is_natural_induction(claim, dependency(line, 0), dependency(line, 1));
+        }
+        return false;
+    }
+};
+
+} // namespace
+
+CertificateCheckResult check_certificate(const Certificate &certificate) { return Checker(certificate).run(); }
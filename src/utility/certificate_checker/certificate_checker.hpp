@@ -0,0 +1,30 @@
+#ifndef CERTIFICATE_CHECKER_HPP
+#define CERTIFICATE_CHECKER_HPP
+
+#include "../certificate/certificate.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CertificateCheckResult {
+    bool valid;
+    std::string error; // empty when valid
+    // the statements LEMMA lines cite, sorted node ids. the certificate lists them itself, so it is only valid given
+    // them, and they are open obligations until something else has proven them
+    std::vector<std::uint32_t> cited_lemmas;
+};
+
+/**
+ * @brief re-checks every line of a certificate, and that every closed target is the statement of the line that closed
+ * it
+ *
+ * LEMMA lines aren't checked, they are trusted because the certificate lists their statement among its lemmas. what
+ * they cite is in cited_lemmas, a certificate with any is not valid on its own.
+ *
+ * works purely on node ids: nodes are hash consed so structural equality is an id comparison, and symbols are only
+ * looked up by name once per certificate. a certificate whose table isn't hash consed can only be rejected, never
+ * wrongly accepted.
+ */
+CertificateCheckResult check_certificate(const Certificate &certificate);
+
+#endif // CERTIFICATE_CHECKER_HPP
@@ -0,0 +1,545 @@
+#include "counterexample.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+// term values other than elements of the domain
+constexpr int overflow = -1;   // the value is outside the truncated domain
+constexpr int unassigned = -2; // depends on a table cell the search hasn't filled in yet
+
+/**
+ * @brief kleene logic plus overflow, which marks a value that is fixed but meaningless because it left the domain
+ *
+ * the connectives are monotone: once a formula evaluates to anything other than unknown, filling in more cells
+ * can't change it, which is what lets the search prune on partial interpretations
+ */
+enum class Truth : std::uint8_t { no, yes, unknown, overflow };
+
+Truth negate(Truth t) { return t == Truth::yes ? Truth::no : t == Truth::no ? Truth::yes : t; }
+
+Truth both(Truth a, Truth b) {
+    if (a == Truth::no || b == Truth::no)
+        return Truth::no;
+    if (a == Truth::unknown || b == Truth::unknown)
+        return Truth::unknown;
+    if (a == Truth::overflow || b == Truth::overflow)
+        return Truth::overflow;
+    return Truth::yes;
+}
+
+Truth either(Truth a, Truth b) {
+    if (a == Truth::yes || b == Truth::yes)
+        return Truth::yes;
+    if (a == Truth::unknown || b == Truth::unknown)
+        return Truth::unknown;
+    if (a == Truth::overflow || b == Truth::overflow)
+        return Truth::overflow;
+    return Truth::no;
+}
+
+enum class Op : std::uint8_t {
+    // terms
+    bound_variable,
+    element,
+    numeral,
+    add,
+    multiply,
+    successor,
+    apply,
+    // formulas
+    equal,
+    less,
+    less_equal,
+    greater,
+    member_of_naturals,
+    holds,
+    negation,
+    conjunction,
+    disjunction,
+    implication,
+    forall,
+    exists,
+};
+
+// value is the bound variable's slot, the symbol or the numeral, set is the symbol of the set a quantifier ranges
+// over or -1 for ℕ
+struct Node {
+    Op op;
+    int value;
+    int set;
+    int first_child;
+    int child_count;
+};
+
+struct Symbol {
+    std::string name;
+    int arity;
+    bool is_relation; // relations and sets take the values 0 and 1
+    size_t first_cell = 0;
+};
+
+bool is_numeral(const std::string &s) {
+    return !s.empty() && std::all_of(s.begin(), s.end(), [](unsigned char c) { return std::isdigit(c); });
+}
+
+/**
+ * @brief turns formulas into one flat node array with every symbol and bound variable resolved to an index
+ */
+class Compiler {
+  public:
+    std::vector<Node> nodes;
+    std::vector<int> children;
+    std::vector<Symbol> symbols;
+    int num_slots = 0;
+    // numerals, arithmetic or order make the elements distinguishable, so symmetry breaking has to be off
+    bool uses_arithmetic = false;
+
+    /// returns the root node, and the symbols the formula mentions
+    int compile(FormulaPtr f, std::vector<int> &mentioned_symbols) {
+        mentioned = &mentioned_symbols;
+        int root = formula(f);
+        std::sort(mentioned->begin(), mentioned->end());
+        mentioned->erase(std::unique(mentioned->begin(), mentioned->end()), mentioned->end());
+        return root;
+    }
+
+  private:
+    std::unordered_map<std::string, int> symbol_ids;
+    std::vector<std::pair<std::string, int>> bound; // variable name and slot, innermost last
+    std::vector<int> *mentioned = nullptr;
+
+    int add(Op op, int value, const std::vector<int> &node_children, int set = -1) {
+        nodes.push_back({op, value, set, (int)children.size(), (int)node_children.size()});
+        children.insert(children.end(), node_children.begin(), node_children.end());
+        return (int)nodes.size() - 1;
+    }
+
+    int symbol(const std::string &name, int arity, bool is_relation) {
+        auto [it, inserted] = symbol_ids.emplace(name, (int)symbols.size());
+        if (inserted) {
+            symbols.push_back({name, arity, is_relation});
+        } else if (symbols[it->second].arity != arity || symbols[it->second].is_relation != is_relation) {
+            throw std::invalid_argument("find_counterexample: " + name + " is used as two different kinds of symbol");
+        }
+        mentioned->push_back(it->second);
+        return it->second;
+    }
+
+    // the set a quantifier ranges over or ∈ tests against, -1 for ℕ
+    int set(TermPtr t) {
+        auto c = std::get_if<ConstantTerm>(&t->data);
+        if (!c || is_numeral(c->c))
+            throw std::invalid_argument("find_counterexample: can't interpret " + t->to_string() + " as a set");
+        return c->c == "ℕ" ? -1 : symbol(c->c, 1, true);
+    }
+
+    int term(TermPtr t) {
+        if (auto p = std::get_if<VariableTerm>(&t->data)) {
+            for (size_t i = bound.size(); i-- > 0;)
+                if (bound[i].first == p->var)
+                    return add(Op::bound_variable, bound[i].second, {});
+            return add(Op::element, symbol(p->var, 0, false), {});
+        }
+        if (auto p = std::get_if<ConstantTerm>(&t->data)) {
+            if (p->c == "ℕ")
+                throw std::invalid_argument("find_counterexample: ℕ can only be a quantifier domain or right of ∈");
+            if (is_numeral(p->c)) {
+                uses_arithmetic = true;
+                return add(Op::numeral, p->c.size() > 9 ? INT_MAX : std::stoi(p->c), {});
+            }
+            return add(Op::element, symbol(p->c, 0, false), {});
+        }
+        if (auto p = std::get_if<FunctionTerm>(&t->data)) {
+            std::vector<int> args;
+            for (auto &arg : p->args)
+                args.push_back(term(arg));
+            if ((p->f == "+" || p->f == "*") && args.size() == 2) {
+                uses_arithmetic = true;
+                return add(p->f == "+" ? Op::add : Op::multiply, 0, args);
+            }
+            if (p->f == "succ" && args.size() == 1) {
+                uses_arithmetic = true;
+                return add(Op::successor, 0, args);
+            }
+            return add(Op::apply, symbol(p->f, (int)args.size(), false), args);
+        }
+        throw std::invalid_argument("find_counterexample: can't interpret the tuple " + t->to_string());
+    }
+
+    int formula(FormulaPtr f) {
+        if (auto p = std::get_if<EqualityFormula>(&f->data))
+            return add(Op::equal, 0, {term(p->l), term(p->r)});
+        if (auto p = std::get_if<RelationFormula>(&f->data)) {
+            if (p->R == "∈" && p->args.size() == 2 && std::holds_alternative<ConstantTerm>(p->args[1]->data)) {
+                int s = set(p->args[1]);
+                int element = term(p->args[0]);
+                return s < 0 ? add(Op::member_of_naturals, 0, {element}) : add(Op::holds, s, {element});
+            }
+            std::vector<int> args;
+            for (auto &arg : p->args)
+                args.push_back(term(arg));
+            if (args.size() == 2 && (p->R == "<" || p->R == "≤" || p->R == ">")) {
+                uses_arithmetic = true;
+                return add(p->R == "<" ? Op::less : p->R == "≤" ? Op::less_equal : Op::greater, 0, args);
+            }
+            return add(Op::holds, symbol(p->R, (int)args.size(), true), args);
+        }
+        if (auto p = std::get_if<NotFormula>(&f->data))
+            return add(Op::negation, 0, {formula(p->inner)});
+        if (auto p = std::get_if<OrFormula>(&f->data))
+            return add(Op::disjunction, 0, {formula(p->l), formula(p->r)});
+        if (auto p = std::get_if<AndFormula>(&f->data))
+            return add(Op::conjunction, 0, {formula(p->l), formula(p->r)});
+        if (auto p = std::get_if<ImpliesFormula>(&f->data))
+            return add(Op::implication, 0, {formula(p->l), formula(p->r)});
+        if (auto p = std::get_if<ForallFormula>(&f->data))
+            return quantifier(Op::forall, p->v, p->domain, p->inner);
+        if (auto p = std::get_if<ExistsFormula>(&f->data))
+            return quantifier(Op::exists, p->v, p->domain, p->inner);
+        throw std::invalid_argument("find_counterexample: unknown formula");
+    }
+
+    int quantifier(Op op, const std::string &v, TermPtr domain, FormulaPtr inner) {
+        // the domain is outside the scope of the binder
+        int s = set(domain);
+        int slot = num_slots++;
+        bound.emplace_back(v, slot);
+        int body = formula(inner);
+        bound.pop_back();
+        return add(op, slot, {body}, s);
+    }
+};
+
+/**
+ * @brief fills in the symbol tables one cell at a time, after each cell re-evaluating only the formulas that mention
+ * its symbol, and backtracking as soon as an assumption is false or the target can no longer be
+ */
+class Search {
+  public:
+    Search(const Compiler &compiled, std::vector<int> roots, const std::vector<std::vector<int>> &mentions,
+           int domain_size)
+        : nodes(compiled.nodes), children(compiled.children), symbols(compiled.symbols), roots(std::move(roots)),
+          domain_size(domain_size), symmetric(!compiled.uses_arithmetic), env(compiled.num_slots, 0),
+          results(this->roots.size(), Truth::unknown), formulas_using(symbols.size()) {
+        for (size_t f = 0; f < mentions.size(); ++f)
+            for (int s : mentions[f])
+                formulas_using[s].push_back((int)f);
+
+        // constants come first so that the least number heuristic below only ever looks at constants
+        std::vector<int> order(symbols.size());
+        for (size_t s = 0; s < symbols.size(); ++s)
+            order[s] = (int)s;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return is_constant_symbol(symbols[a]) && !is_constant_symbol(symbols[b]);
+        });
+
+        for (int s : order) {
+            size_t num_cells = 1;
+            for (int i = 0; i < symbols[s].arity; ++i)
+                num_cells *= domain_size;
+            symbols[s].first_cell = cells.size();
+            cells.insert(cells.end(), num_cells, unassigned);
+            cell_symbols.insert(cell_symbols.end(), num_cells, s);
+        }
+    }
+
+    std::optional<FiniteModel> run() {
+        for (size_t f = 0; f < roots.size(); ++f)
+            results[f] = eval(roots[f]);
+        for (size_t f = 0; f < roots.size(); ++f)
+            if (is_hopeless(f, results[f]))
+                return std::nullopt;
+        if (!assign(0, -1))
+            return std::nullopt;
+
+        FiniteModel model{domain_size, {}};
+        for (auto &s : symbols) {
+            size_t num_cells = 1;
+            for (int i = 0; i < s.arity; ++i)
+                num_cells *= domain_size;
+            std::vector<int> table(cells.begin() + s.first_cell, cells.begin() + s.first_cell + num_cells);
+            // cells no formula ended up depending on can be anything
+            for (int &v : table)
+                v = std::max(v, 0);
+            model.symbols.push_back({s.name, s.arity, s.is_relation, std::move(table)});
+        }
+        return model;
+    }
+
+  private:
+    const std::vector<Node> &nodes;
+    const std::vector<int> &children;
+    std::vector<Symbol> symbols;
+    std::vector<int> roots; // the assumptions followed by the target
+    int domain_size;
+    bool symmetric;
+
+    std::vector<int> cells;
+    std::vector<int> cell_symbols;
+    std::vector<int> env;
+
+    std::vector<Truth> results;
+    std::vector<std::vector<int>> formulas_using;
+    // results overwritten since a cell was assigned, so they can be put back when it's unassigned
+    std::vector<std::pair<int, Truth>> trail;
+
+    static bool is_constant_symbol(const Symbol &s) { return s.arity == 0 && !s.is_relation; }
+
+    bool is_target(size_t f) const { return f + 1 == roots.size(); }
+
+    bool is_hopeless(size_t f, Truth t) const {
+        return is_target(f) ? (t == Truth::yes || t == Truth::overflow) : t == Truth::no;
+    }
+
+    bool is_counterexample() const {
+        if (results.back() != Truth::no)
+            return false;
+        for (size_t f = 0; f + 1 < results.size(); ++f)
+            if (results[f] == Truth::unknown)
+                return false;
+        return true;
+    }
+
+    bool assign(size_t cell, int max_element) {
+        if (is_counterexample())
+            return true;
+        if (cell == cells.size())
+            return false;
+
+        int s = cell_symbols[cell];
+        int range = symbols[s].is_relation ? 2 : domain_size;
+        // least number heuristic: when the elements are interchangeable, the i'th constant only needs to be tried
+        // on the elements already used and one new one
+        bool break_symmetry = symmetric && is_constant_symbol(symbols[s]);
+        if (break_symmetry)
+            range = std::min(range, max_element + 2);
+
+        for (int v = 0; v < range; ++v) {
+            cells[cell] = v;
+            size_t mark = trail.size();
+            if (update(s) && assign(cell + 1, break_symmetry ? std::max(max_element, v) : max_element))
+                return true;
+            for (size_t i = trail.size(); i-- > mark;)
+                results[trail[i].first] = trail[i].second;
+            trail.resize(mark);
+        }
+        cells[cell] = unassigned;
+        return false;
+    }
+
+    // re-evaluates the undecided formulas that mention the symbol, false if that rules out a counterexample
+    bool update(int symbol) {
+        bool viable = true;
+        for (int f : formulas_using[symbol]) {
+            if (results[f] != Truth::unknown)
+                continue;
+            Truth t = eval(roots[f]);
+            if (t == Truth::unknown)
+                continue;
+            trail.emplace_back(f, results[f]);
+            results[f] = t;
+            viable = viable && !is_hopeless(f, t);
+        }
+        return viable;
+    }
+
+    int child(const Node &n, int i) const { return children[n.first_child + i]; }
+
+    size_t cell_of(const Symbol &s, const Node &n, int *status) {
+        size_t index = 0;
+        *status = 0;
+        for (int i = 0; i < n.child_count; ++i) {
+            int v = eval_term(child(n, i));
+            if (v == unassigned)
+                *status = unassigned;
+            else if (v == overflow && *status == 0)
+                *status = overflow;
+            index = index * domain_size + (v < 0 ? 0 : v);
+        }
+        return s.first_cell + index;
+    }
+
+    int arithmetic(long long v) const { return v < domain_size ? (int)v : overflow; }
+
+    int eval_term(int node) {
+        const Node &n = nodes[node];
+        switch (n.op) {
+        case Op::bound_variable:
+            return env[n.value];
+        case Op::element:
+            return cells[symbols[n.value].first_cell];
+        case Op::numeral:
+            return arithmetic(n.value);
+        case Op::apply: {
+            int status;
+            size_t cell = cell_of(symbols[n.value], n, &status);
+            return status != 0 ? status : cells[cell];
+        }
+        default:
+            break;
+        }
+
+        // add, multiply or successor
+        int a = eval_term(child(n, 0));
+        int b = n.op == Op::successor ? 1 : eval_term(child(n, 1));
+        if (a == unassigned || b == unassigned)
+            return unassigned;
+        if (a == overflow || b == overflow)
+            return overflow;
+        return arithmetic(n.op == Op::multiply ? (long long)a * b : (long long)a + b);
+    }
+
+    Truth compare(const Node &n) {
+        int a = eval_term(child(n, 0));
+        int b = eval_term(child(n, 1));
+        if (a == unassigned || b == unassigned)
+            return Truth::unknown;
+        if (a == overflow || b == overflow)
+            return Truth::overflow;
+        bool holds = n.op == Op::equal ? a == b : n.op == Op::less ? a < b : n.op == Op::less_equal ? a <= b : a > b;
+        return holds ? Truth::yes : Truth::no;
+    }
+
+    Truth membership(int set, int element) const {
+        if (set < 0)
+            return Truth::yes;
+        int v = cells[symbols[set].first_cell + element];
+        return v == unassigned ? Truth::unknown : v ? Truth::yes : Truth::no;
+    }
+
+    Truth eval(int node) {
+        const Node &n = nodes[node];
+        switch (n.op) {
+        case Op::equal:
+        case Op::less:
+        case Op::less_equal:
+        case Op::greater:
+            return compare(n);
+        case Op::member_of_naturals: {
+            int v = eval_term(child(n, 0));
+            return v == unassigned ? Truth::unknown : v == overflow ? Truth::overflow : Truth::yes;
+        }
+        case Op::holds: {
+            int status;
+            size_t cell = cell_of(symbols[n.value], n, &status);
+            if (status != 0)
+                return status == unassigned ? Truth::unknown : Truth::overflow;
+            return cells[cell] == unassigned ? Truth::unknown : cells[cell] ? Truth::yes : Truth::no;
+        }
+        case Op::negation:
+            return negate(eval(child(n, 0)));
+        case Op::conjunction: {
+            Truth l = eval(child(n, 0));
+            return l == Truth::no ? l : both(l, eval(child(n, 1)));
+        }
+        case Op::disjunction: {
+            Truth l = eval(child(n, 0));
+            return l == Truth::yes ? l : either(l, eval(child(n, 1)));
+        }
+        case Op::implication: {
+            Truth l = negate(eval(child(n, 0)));
+            return l == Truth::yes ? l : either(l, eval(child(n, 1)));
+        }
+        case Op::forall:
+        case Op::exists: {
+            bool is_forall = n.op == Op::forall;
+            bool undecided = false;
+            for (int x = 0; x < domain_size; ++x) {
+                env[n.value] = x;
+                Truth member = membership(n.set, x);
+                Truth instance = is_forall ? either(negate(member), eval(child(n, 0)))
+                                           : both(member, eval(child(n, 0)));
+                // instances that overflow are outside the truncated domain and don't count either way
+                if (instance == (is_forall ? Truth::no : Truth::yes))
+                    return instance;
+                undecided = undecided || instance == Truth::unknown;
+            }
+            return undecided ? Truth::unknown : is_forall ? Truth::yes : Truth::no;
+        }
+        default:
+            throw std::logic_error("find_counterexample: term node where a formula was expected");
+        }
+    }
+};
+
+} // namespace
+
+std::string FiniteModel::to_string() const {
+    std::ostringstream ss;
+    ss << "domain {0.." << domain_size - 1 << "}\n";
+    for (auto &s : symbols) {
+        ss << "  " << s.name;
+        if (s.arity == 0) {
+            if (s.is_relation)
+                ss << " = " << (s.table[0] ? "true" : "false");
+            else
+                ss << " = " << s.table[0];
+            ss << "\n";
+            continue;
+        }
+
+        auto arguments = [&](size_t index) {
+            std::vector<int> args(s.arity);
+            for (int i = s.arity; i-- > 0;) {
+                args[i] = (int)(index % domain_size);
+                index /= domain_size;
+            }
+            std::string text;
+            for (int i = 0; i < s.arity; ++i)
+                text += (i ? ", " : "") + std::to_string(args[i]);
+            return text;
+        };
+
+        if (s.is_relation) {
+            ss << " = {";
+            bool first = true;
+            for (size_t i = 0; i < s.table.size(); ++i) {
+                if (!s.table[i])
+                    continue;
+                ss << (first ? "" : ", ");
+                if (s.arity > 1)
+                    ss << "(" << arguments(i) << ")";
+                else
+                    ss << arguments(i);
+                first = false;
+            }
+            ss << "}\n";
+        } else {
+            ss << ":";
+            for (size_t i = 0; i < s.table.size(); ++i)
+                ss << (i ? ", " : " ") << s.name << "(" << arguments(i) << ") = " << s.table[i];
+            ss << "\n";
+        }
+    }
+    return ss.str();
+}
+
+std::optional<FiniteModel> find_counterexample(const std::vector<FormulaPtr> &assumptions, FormulaPtr target,
+                                               int max_domain) {
+    if (max_domain < 1)
+        throw std::invalid_argument("find_counterexample: max_domain must be at least 1");
+
+    Compiler compiled;
+    std::vector<int> roots;
+    std::vector<std::vector<int>> mentions(assumptions.size() + 1);
+    for (size_t i = 0; i < assumptions.size(); ++i)
+        roots.push_back(compiled.compile(assumptions[i], mentions[i]));
+    roots.push_back(compiled.compile(target, mentions.back()));
+
+    for (int domain_size = 1; domain_size <= max_domain; ++domain_size) {
+        if (auto model = Search(compiled, roots, mentions, domain_size).run())
+            return model;
+    }
+    return std::nullopt;
+}
+
+std::optional<FiniteModel> find_counterexample(const Proof &proof, int max_domain) {
+    return find_counterexample(proof.get_active_assumptions(), proof.get_active_target(), max_domain);
+}
@@ -0,0 +1,49 @@
+#ifndef COUNTEREXAMPLE_HPP
+#define COUNTEREXAMPLE_HPP
+
+#include "../proof/proof.hpp"
+#include "../proof_system/proof_system.hpp"
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief the interpretation of one symbol in a finite model, relations and sets map to 0 or 1
+ *
+ * table is indexed by the arguments written in base domain_size, first argument most significant, so constants and
+ * free variables have a single entry
+ */
+struct SymbolInterpretation {
+    std::string name;
+    int arity;
+    bool is_relation;
+    std::vector<int> table;
+};
+
+struct FiniteModel {
+    int domain_size;
+    std::vector<SymbolInterpretation> symbols;
+
+    std::string to_string() const;
+};
+
+/**
+ * @brief searches the domains {0}, {0, 1}, ... {0, .., max_domain - 1} for an interpretation in which every assumption
+ * holds and the target doesn't
+ *
+ * ℕ is truncated to the domain, numerals, +, *, succ, <, ≤ and > keep their meaning, and an atom whose value would
+ * leave the domain is unknown, quantifier instances that are unknown for that reason are skipped. every other function,
+ * relation and constant symbol is enumerated, constants that are used as quantifier domains or on the right of ∈ are
+ * interpreted as subsets of the domain. free variables are shared between the formulas and enumerated like constants.
+ *
+ * a model found is a counterexample for the truncated semantics, which is a real one unless the formulas only fail
+ * because of values beyond the domain. throws std::invalid_argument for formulas it can't interpret (tuples, or a
+ * quantifier over something other than ℕ or a set constant).
+ */
+std::optional<FiniteModel> find_counterexample(const std::vector<FormulaPtr> &assumptions, FormulaPtr target,
+                                               int max_domain);
+
+/// the active target of the proof, against its assumptions and the hypotheses of that target
+std::optional<FiniteModel> find_counterexample(const Proof &proof, int max_domain);
+
+#endif // COUNTEREXAMPLE_HPP
@@ -0,0 +1,328 @@
+#include "enumeration.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// first arguments a thread claims at a time
+constexpr size_t chunk_size = 256;
+
+// every way of writing total as parts positive sizes, in lexicographic order
+void for_each_composition(size_t total, size_t parts, std::vector<size_t> &sizes, auto &&visit) {
+    if (parts == 0) {
+        if (total == 0)
+            visit(sizes);
+        return;
+    }
+    for (size_t first = 1; first + (parts - 1) <= total; ++first) {
+        sizes.push_back(first);
+        for_each_composition(total - first, parts - 1, sizes, visit);
+        sizes.pop_back();
+    }
+}
+
+// symbols in name order, so that the order of every size is the same from run to run
+std::map<std::string, size_t> sorted(const std::unordered_map<std::string, size_t> &symbols) {
+    return {symbols.begin(), symbols.end()};
+}
+
+// the candidates of one chunk, all of a production's candidates have the same number of children
+struct Batch {
+    std::vector<std::uint32_t> productions;
+    std::vector<std::uint32_t> children;
+};
+
+} // namespace
+
+FormulaEnumerator::FormulaEnumerator(Signature signature, EnumerationOptions options)
+    : signature(std::move(signature)), options(std::move(options)) {
+    std::vector<std::string> variables = this->options.variables;
+    variables.insert(variables.end(), this->options.bound_variables.begin(), this->options.bound_variables.end());
+    if (variables.size() > 64)
+        throw std::invalid_argument("FormulaEnumerator: at most 64 variables, got " + std::to_string(variables.size()));
+
+    // variables are interned first, so the symbol of a variable is its bit in variable_masks
+    for (const std::string &v : variables) {
+        if (this->signature.strict_variable_names && !is_variable(v))
+            throw std::invalid_argument("FormulaEnumerator: bad variable name " + v);
+        if (nodes.find_symbol(v) != no_symbol)
+            throw std::invalid_argument("FormulaEnumerator: variable " + v + " is named twice");
+        std::uint32_t id = nodes.intern_node(NodeKind::variable, nodes.intern_symbol(v), {});
+        variable_masks.push_back(std::uint64_t(1) << variable_nodes.size());
+        variable_nodes.push_back(id);
+    }
+    for (const std::string &domain : this->options.quantifier_domains)
+        domain_nodes.push_back(intern(NodeKind::constant, nodes.intern_symbol(domain), {}));
+    std::set<std::string> constants(this->signature.constants.begin(), this->signature.constants.end());
+    for (const std::string &c : constants)
+        nodes.intern_symbol(c);
+    for (const auto &[f, arity] : sorted(this->signature.functions))
+        nodes.intern_symbol(f);
+    for (const auto &[R, arity] : sorted(this->signature.relations))
+        nodes.intern_symbol(R);
+
+    size_t depths = this->options.quantifier_domains.empty() ? 1 : this->options.bound_variables.size() + 1;
+    // size 0 is always there and empty
+    terms_by_depth.assign(depths, {{}});
+    formulas_by_depth.assign(depths, {{}});
+}
+
+std::uint32_t FormulaEnumerator::intern(NodeKind kind, std::uint32_t symbol, std::span<const std::uint32_t> children) {
+    std::uint32_t id = nodes.intern_node(kind, symbol, children);
+    if (id < variable_masks.size())
+        return id;
+
+    std::uint64_t mask = 0;
+    for (std::uint32_t child : children)
+        mask |= variable_masks[child];
+    if (kind == NodeKind::forall || kind == NodeKind::exists)
+        mask &= ~(std::uint64_t(1) << symbol);
+    variable_masks.push_back(mask);
+    return id;
+}
+
+std::vector<FormulaEnumerator::Production> FormulaEnumerator::term_productions(size_t depth, size_t size) const {
+    std::vector<Production> productions;
+    if (size == 1) {
+        for (size_t i = 0; i < options.variables.size() + depth; ++i)
+            productions.push_back({NodeKind::variable, nodes.nodes[variable_nodes[i]].symbol, {}});
+        for (const std::string &c : std::set<std::string>(signature.constants.begin(), signature.constants.end()))
+            productions.push_back({NodeKind::constant, nodes.find_symbol(c), {}});
+    }
+
+    std::vector<size_t> sizes;
+    for (const auto &[f, arity] : sorted(signature.functions)) {
+        Ordering ordering = Ordering::none;
+        if (arity == 2) {
+            bool commutative = options.commutative.count(f), associative = options.associative.count(f);
+            ordering = commutative && associative ? Ordering::associative_commutative
+                       : commutative              ? Ordering::commutative
+                       : associative              ? Ordering::associative
+                                                  : Ordering::none;
+        }
+        for_each_composition(size - 1, arity, sizes, [&](const std::vector<size_t> &parts) {
+            Production production{NodeKind::function, nodes.find_symbol(f), {}, ordering};
+            for (size_t part : parts)
+                production.arguments.push_back(terms_by_depth[depth][part]);
+            productions.push_back(std::move(production));
+        });
+    }
+    return productions;
+}
+
+std::vector<FormulaEnumerator::Production> FormulaEnumerator::formula_productions(size_t depth, size_t size) const {
+    std::vector<Production> productions;
+    const auto &terms = terms_by_depth[depth];
+    const auto &formulas = formulas_by_depth[depth];
+    std::vector<size_t> sizes;
+
+    for_each_composition(size - 1, 2, sizes, [&](const std::vector<size_t> &parts) {
+        productions.push_back(
+            {NodeKind::equality, no_symbol, {terms[parts[0]], terms[parts[1]]}, Ordering::commutative});
+    });
+
+    for (const auto &[R, arity] : sorted(signature.relations)) {
+        for_each_composition(size - 1, arity, sizes, [&](const std::vector<size_t> &parts) {
+            Production production{NodeKind::relation, nodes.find_symbol(R), {}};
+            for (size_t part : parts)
+                production.arguments.push_back(terms[part]);
+            productions.push_back(std::move(production));
+        });
+    }
+
+    if (size >= 2)
+        productions.push_back({NodeKind::negation, no_symbol, {formulas[size - 1]}});
+    for (NodeKind kind : {NodeKind::conjunction, NodeKind::disjunction, NodeKind::implication}) {
+        Ordering ordering = kind == NodeKind::implication ? Ordering::none : Ordering::associative_commutative;
+        for_each_composition(size - 1, 2, sizes, [&](const std::vector<size_t> &parts) {
+            productions.push_back({kind, no_symbol, {formulas[parts[0]], formulas[parts[1]]}, ordering});
+        });
+    }
+
+    if (depth < max_depth() && size >= 3) {
+        std::uint32_t v = variable_nodes[options.variables.size() + depth];
+        for (NodeKind kind : {NodeKind::forall, NodeKind::exists}) {
+            for (const std::uint32_t &domain : domain_nodes) {
+                std::span<const std::uint32_t> bodies = formulas_by_depth[depth + 1][size - 2];
+                productions.push_back({kind, nodes.nodes[v].symbol, {{&domain, 1}, bodies}, Ordering::none,
+                                       (int)nodes.nodes[v].symbol});
+            }
+        }
+    }
+    return productions;
+}
+
+std::vector<std::uint32_t> FormulaEnumerator::generate(const std::vector<Production> &productions,
+                                                       unsigned num_threads) {
+    // an item is a production and the choice of its first argument
+    std::vector<size_t> first_item{0};
+    for (const Production &production : productions) {
+        size_t items = 1;
+        for (std::span<const std::uint32_t> argument : production.arguments)
+            items = argument.empty() ? 0 : items;
+        if (items && !production.arguments.empty())
+            items = production.arguments[0].size();
+        first_item.push_back(first_item.back() + items);
+    }
+    size_t num_items = first_item.back();
+    size_t num_chunks = (num_items + chunk_size - 1) / chunk_size;
+    std::vector<Batch> batches(num_chunks);
+
+    auto is_head = [&](std::uint32_t node, const Production &production) {
+        const FlatNode &n = nodes.nodes[node];
+        return n.kind == production.kind && n.symbol == production.symbol;
+    };
+    auto canonical = [&](const Production &production, std::span<const std::uint32_t> children) {
+        if (production.bound >= 0)
+            return ((variable_masks[children[1]] >> production.bound) & 1) != 0;
+        switch (production.ordering) {
+        case Ordering::none:
+            return true;
+        case Ordering::commutative:
+            return children[0] <= children[1];
+        case Ordering::associative:
+            return !is_head(children[0], production);
+        case Ordering::associative_commutative: {
+            // the leaves of a right nested chain are in increasing order
+            std::uint32_t next = children[1];
+            if (is_head(next, production))
+                next = nodes.children_of(next)[0];
+            return !is_head(children[0], production) && children[0] <= next;
+        }
+        }
+        return true;
+    };
+
+    auto run_item = [&](size_t item, Batch &batch) {
+        size_t p = std::upper_bound(first_item.begin(), first_item.end(), item) - first_item.begin() - 1;
+        const Production &production = productions[p];
+        size_t arity = production.arguments.size();
+        if (arity == 0) {
+            batch.productions.push_back((std::uint32_t)p);
+            return;
+        }
+
+        // an odometer over the arguments after the first
+        std::vector<std::uint32_t> children(arity);
+        std::vector<size_t> digits(arity, 0);
+        digits[0] = item - first_item[p];
+        for (;;) {
+            for (size_t i = 0; i < arity; ++i)
+                children[i] = production.arguments[i][digits[i]];
+            if (canonical(production, children)) {
+                batch.productions.push_back((std::uint32_t)p);
+                batch.children.insert(batch.children.end(), children.begin(), children.end());
+            }
+            size_t i = arity;
+            while (--i > 0 && ++digits[i] == production.arguments[i].size())
+                digits[i] = 0;
+            if (i == 0)
+                return;
+        }
+    };
+
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = (unsigned)std::min<size_t>(num_threads, num_chunks);
+
+    std::atomic<size_t> next_chunk{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        try {
+            for (;;) {
+                size_t chunk = next_chunk.fetch_add(1);
+                if (chunk >= num_chunks)
+                    return;
+                size_t end = std::min((chunk + 1) * chunk_size, num_items);
+                for (size_t item = chunk * chunk_size; item < end; ++item)
+                    run_item(item, batches[chunk]);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            next_chunk = num_chunks;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+    if (error)
+        std::rethrow_exception(error);
+
+    // interned in chunk order, so ids don't depend on how the chunks were shared out
+    std::vector<std::uint32_t> result;
+    for (const Batch &batch : batches) {
+        size_t offset = 0;
+        for (std::uint32_t p : batch.productions) {
+            const Production &production = productions[p];
+            size_t arity = production.arguments.size();
+            result.push_back(intern(production.kind, production.symbol, {batch.children.data() + offset, arity}));
+            offset += arity;
+        }
+    }
+    return result;
+}
+
+void FormulaEnumerator::build(size_t max_size, unsigned num_threads) {
+    for (size_t size = built_size() + 1; size <= max_size; ++size) {
+        // quantifiers at one depth need the bodies from the next, which are smaller, so any order of depths works
+        for (size_t depth = 0; depth <= max_depth(); ++depth) {
+            std::vector<std::uint32_t> terms = generate(term_productions(depth, size), num_threads);
+            terms_by_depth[depth].push_back(std::move(terms));
+        }
+        for (size_t depth = 0; depth <= max_depth(); ++depth) {
+            std::vector<std::uint32_t> formulas = generate(formula_productions(depth, size), num_threads);
+            formulas_by_depth[depth].push_back(std::move(formulas));
+        }
+    }
+}
+
+std::span<const std::uint32_t> FormulaEnumerator::terms(size_t size) const {
+    if (size > built_size())
+        throw std::out_of_range("FormulaEnumerator: terms of size " + std::to_string(size) + " haven't been built");
+    return terms_by_depth[0][size];
+}
+
+std::span<const std::uint32_t> FormulaEnumerator::formulas(size_t size) const {
+    if (size > built_size())
+        throw std::out_of_range("FormulaEnumerator: formulas of size " + std::to_string(size) + " haven't been built");
+    return formulas_by_depth[0][size];
+}
+
+bool FormulaEnumerator::next(const std::vector<std::vector<std::uint32_t>> &by_size, EnumerationCursor &cursor,
+                             std::uint32_t &node) {
+    unsigned num_shards = std::max(1u, cursor.num_shards);
+    while (cursor.size < by_size.size()) {
+        // the first index at or after the cursor that belongs to its shard
+        size_t index = cursor.index + (cursor.shard + num_shards - cursor.index % num_shards) % num_shards;
+        if (index < by_size[cursor.size].size()) {
+            node = by_size[cursor.size][index];
+            cursor.index = index + 1;
+            return true;
+        }
+        ++cursor.size;
+        cursor.index = 0;
+    }
+    return false;
+}
+
+bool FormulaEnumerator::next_term(EnumerationCursor &cursor, std::uint32_t &node) const {
+    return next(terms_by_depth[0], cursor, node);
+}
+
+bool FormulaEnumerator::next_formula(EnumerationCursor &cursor, std::uint32_t &node) const {
+    return next(formulas_by_depth[0], cursor, node);
+}
@@ -0,0 +1,101 @@
+#ifndef ENUMERATION_HPP
+#define ENUMERATION_HPP
+
+#include "../flat_formula/flat_formula.hpp"
+#include "../proof_system/proof_system.hpp"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+struct EnumerationOptions {
+    // free variables terms may use
+    std::vector<std::string> variables;
+    // constants quantifiers range over, no quantifiers are generated if this is empty
+    std::vector<std::string> quantifier_domains;
+    // the name of the binder at each nesting depth, so alpha equivalent formulas come out as the same node, this also
+    // bounds how deeply quantifiers nest
+    std::vector<std::string> bound_variables = {"x", "y", "z"};
+    // only one order of the arguments of these binary functions is generated
+    std::unordered_set<std::string> commutative = {"+", "*"};
+    // and only right nested applications of these
+    std::unordered_set<std::string> associative = {"+", "*"};
+};
+
+/// where a walk over the enumerated nodes is, save it to carry on later. a shard only sees every num_shards'th node
+struct EnumerationCursor {
+    size_t size = 1;
+    size_t index = 0;
+    unsigned shard = 0;
+    unsigned num_shards = 1;
+};
+
+/**
+ * @brief every well formed term and formula over a signature, by size (the number of nodes, as in FormulaReport),
+ * each exactly once up to the canonical forms below
+ *
+ * nodes live in a FlatFormulaTable, so a subterm shared by many results is stored once, use FlatFormulaReader to get
+ * Terms and Formulas back. only canonical forms are generated: arguments of commutative symbols, =, ∧ and ∨ are in
+ * increasing node id, associative symbols, ∧ and ∨ are nested to the right, quantifiers bind bound_variables[depth] and
+ * never bind a variable their body doesn't use. so (x + y) + z and z + (y + x) are only generated as one of them.
+ *
+ * sizes are built in order with build, the work of each size shared out between threads. node ids and the order of
+ * every size only depend on the signature and options, so a cursor saved in one run can be resumed in another.
+ */
+class FormulaEnumerator {
+  public:
+    /// throws std::invalid_argument if there are more than 64 variables or a name is used twice
+    explicit FormulaEnumerator(Signature signature, EnumerationOptions options = {});
+
+    /// generates everything up to max_size nodes that isn't already, on num_threads threads (0 for one per core)
+    void build(size_t max_size, unsigned num_threads = 0);
+    size_t built_size() const { return terms_by_depth[0].size() - 1; }
+
+    /// throws std::out_of_range unless size has been built
+    std::span<const std::uint32_t> terms(size_t size) const;
+    std::span<const std::uint32_t> formulas(size_t size) const;
+
+    /// the next term or formula at the cursor, in order of size, false once everything built has been seen
+    bool next_term(EnumerationCursor &cursor, std::uint32_t &node) const;
+    bool next_formula(EnumerationCursor &cursor, std::uint32_t &node) const;
+
+    const FlatFormulaTable &table() const { return nodes; }
+
+  private:
+    enum class Ordering : std::uint8_t { none, commutative, associative, associative_commutative };
+
+    struct Production {
+        NodeKind kind;
+        std::uint32_t symbol;
+        std::vector<std::span<const std::uint32_t>> arguments;
+        Ordering ordering = Ordering::none;
+        // for quantifiers, the variable the body has to use
+        int bound = -1;
+    };
+
+    Signature signature;
+    EnumerationOptions options;
+    FlatFormulaTable nodes;
+
+    // the variables each node uses, as bits in the order of options.variables then options.bound_variables
+    std::vector<std::uint64_t> variable_masks;
+    std::vector<std::uint32_t> variable_nodes;
+    std::vector<std::uint32_t> domain_nodes;
+
+    // [depth][size], the nodes with bound_variables[0 .. depth) in scope
+    std::vector<std::vector<std::vector<std::uint32_t>>> terms_by_depth;
+    std::vector<std::vector<std::vector<std::uint32_t>>> formulas_by_depth;
+
+    std::uint32_t intern(NodeKind kind, std::uint32_t symbol, std::span<const std::uint32_t> children);
+    size_t max_depth() const { return terms_by_depth.size() - 1; }
+
+    std::vector<Production> term_productions(size_t depth, size_t size) const;
+    std::vector<Production> formula_productions(size_t depth, size_t size) const;
+    std::vector<std::uint32_t> generate(const std::vector<Production> &productions, unsigned num_threads);
+
+    static bool next(const std::vector<std::vector<std::uint32_t>> &by_size, EnumerationCursor &cursor,
+                     std::uint32_t &node);
+};
+
+#endif // ENUMERATION_HPP
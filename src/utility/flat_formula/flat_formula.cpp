@@ -0,0 +1,192 @@
+#include "flat_formula.hpp"
+
+#include <algorithm>
+#include <initializer_list>
+
+static bool is_term_kind(NodeKind kind) { return kind <= NodeKind::tuple; }
+
+std::uint32_t FlatFormulaTable::intern_symbol(std::string_view name) {
+    auto it = symbol_ids.find(std::string(name));
+    if (it != symbol_ids.end())
+        return it->second;
+    std::uint32_t id = (std::uint32_t)symbols.size();
+    symbols.emplace_back(name);
+    symbol_ids.emplace(symbols.back(), id);
+    return id;
+}
+
+std::uint32_t FlatFormulaTable::find_symbol(std::string_view name) const {
+    auto it = symbol_ids.find(std::string(name));
+    return it == symbol_ids.end() ? no_symbol : it->second;
+}
+
+std::uint64_t FlatFormulaTable::hash_node(NodeKind kind, std::uint32_t symbol,
+                                          std::span<const std::uint32_t> node_children) const {
+    std::uint64_t h = ((std::uint64_t)kind << 32) ^ symbol;
+    for (std::uint32_t c : node_children)
+        h = (h ^ c) * 0x9e3779b97f4a7c15ull + (h >> 29);
+    return h ^ node_children.size();
+}
+
+std::uint32_t FlatFormulaTable::find_hashed_node(std::uint64_t h, NodeKind kind, std::uint32_t symbol,
+                                                 std::span<const std::uint32_t> node_children) const {
+    auto [begin, end] = node_ids.equal_range(h);
+    for (auto it = begin; it != end; ++it) {
+        const FlatNode &n = nodes[it->second];
+        if (n.kind == kind && n.symbol == symbol && n.child_count == node_children.size() &&
+            std::equal(node_children.begin(), node_children.end(), children.begin() + n.first_child))
+            return it->second;
+    }
+    return no_node;
+}
+
+std::uint32_t FlatFormulaTable::find_node(NodeKind kind, std::uint32_t symbol,
+                                          std::span<const std::uint32_t> node_children) const {
+    return find_hashed_node(hash_node(kind, symbol, node_children), kind, symbol, node_children);
+}
+
+std::uint32_t FlatFormulaTable::intern_node(NodeKind kind, std::uint32_t symbol,
+                                            std::span<const std::uint32_t> node_children) {
+    std::uint64_t h = hash_node(kind, symbol, node_children);
+    std::uint32_t existing = find_hashed_node(h, kind, symbol, node_children);
+    if (existing != no_node)
+        return existing;
+
+    std::uint32_t id = (std::uint32_t)nodes.size();
+    nodes.push_back({kind, symbol, (std::uint32_t)children.size(), (std::uint32_t)node_children.size()});
+    children.insert(children.end(), node_children.begin(), node_children.end());
+    node_ids.emplace(h, id);
+    return id;
+}
+
+FlatFormulaView FlatFormulaTable::view() const {
+    FlatFormulaView v{nodes, children, {}};
+    v.symbols.assign(symbols.begin(), symbols.end());
+    return v;
+}
+
+void FlatFormulaTable::reindex() {
+    symbol_ids.clear();
+    for (std::uint32_t i = 0; i < symbols.size(); ++i)
+        symbol_ids.emplace(symbols[i], i);
+    node_ids.clear();
+    for (std::uint32_t i = 0; i < nodes.size(); ++i)
+        node_ids.emplace(hash_node(nodes[i].kind, nodes[i].symbol, children_of(i)), i);
+}
+
+bool FlatFormulaTable::is_well_formed(std::string *err) const {
+    auto fail = [&](const std::string &why, std::uint32_t node) {
+        if (err)
+            *err = why + " at node " + std::to_string(node);
+        return false;
+    };
+
+    for (std::uint32_t i = 0; i < nodes.size(); ++i) {
+        const FlatNode &n = nodes[i];
+        if ((std::uint64_t)n.first_child + n.child_count > children.size())
+            return fail("children out of range", i);
+
+        bool has_symbol = true;
+        bool arity_ok = true;
+        switch (n.kind) {
+        case NodeKind::variable:
+        case NodeKind::constant:
+            arity_ok = n.child_count == 0;
+            break;
+        case NodeKind::function:
+        case NodeKind::relation:
+            break;
+        case NodeKind::tuple:
+            has_symbol = false;
+            break;
+        case NodeKind::equality:
+        case NodeKind::disjunction:
+        case NodeKind::conjunction:
+        case NodeKind::implication:
+            has_symbol = false;
+            arity_ok = n.child_count == 2;
+            break;
+        case NodeKind::negation:
+            has_symbol = false;
+            arity_ok = n.child_count == 1;
+            break;
+        case NodeKind::forall:
+        case NodeKind::exists:
+            arity_ok = n.child_count == 2;
+            break;
+        default:
+            return fail("unknown node kind", i);
+        }
+        if (!arity_ok)
+            return fail("wrong number of children", i);
+        if (has_symbol && n.symbol >= symbols.size())
+            return fail("symbol out of range", i);
+
+        auto node_children = children_of(i);
+        for (std::uint32_t j = 0; j < node_children.size(); ++j) {
+            std::uint32_t c = node_children[j];
+            if (c >= i)
+                return fail("child does not come before its parent", i);
+
+            // terms only have term children, formulas have formula children except for the arguments of atoms and
+            // the domain of quantifiers
+            bool child_should_be_term = is_term_kind(n.kind) || n.kind == NodeKind::equality ||
+                                        n.kind == NodeKind::relation ||
+                                        ((n.kind == NodeKind::forall || n.kind == NodeKind::exists) && j == 0);
+            if (is_term_kind(nodes[c].kind) != child_should_be_term)
+                return fail("child of the wrong kind", i);
+        }
+    }
+    return true;
+}
+
+std::string FlatFormulaTable::to_string(std::uint32_t node) const {
+    const FlatNode &n = nodes[node];
+    std::span<const std::uint32_t> args = children_of(node);
+    auto binary = [&](const std::string &op) {
+        std::string s = "(";
+        s += to_string(args[0]);
+        s += " " + op + " ";
+        s += to_string(args[1]);
+        return s + ")";
+    };
+    auto applied = [&](const std::string &name) {
+        std::string s = name + "(";
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (i)
+                s += ", ";
+            s += to_string(args[i]);
+        }
+        return s + ")";
+    };
+    auto is_infix = [&](std::initializer_list<std::string_view> operators) {
+        return args.size() == 2 && std::find(operators.begin(), operators.end(), symbols[n.symbol]) != operators.end();
+    };
+
+    switch (n.kind) {
+    case NodeKind::variable:
+    case NodeKind::constant:
+        return symbols[n.symbol];
+    case NodeKind::function:
+        return is_infix({"+", "*", "∈"}) ? binary(symbols[n.symbol]) : applied(symbols[n.symbol]);
+    case NodeKind::relation:
+        return is_infix({"=", "∈", "<", "≤", ">"}) ? binary(symbols[n.symbol]) : applied(symbols[n.symbol]);
+    case NodeKind::tuple:
+        return applied("");
+    case NodeKind::equality:
+        return binary("=");
+    case NodeKind::negation:
+        return std::string("(¬") + to_string(args[0]) + ")";
+    case NodeKind::disjunction:
+        return binary("∨");
+    case NodeKind::conjunction:
+        return binary("∧");
+    case NodeKind::implication:
+        return binary("→");
+    case NodeKind::forall:
+    case NodeKind::exists:
+        return std::string(n.kind == NodeKind::forall ? "(∀" : "(∃") + symbols[n.symbol] + " ∈ " + to_string(args[0]) +
+               ")(" + to_string(args[1]) + ")";
+    }
+    return "?";
+}
@@ -0,0 +1,104 @@
+#ifndef FLAT_FORMULA_HPP
+#define FLAT_FORMULA_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief terms and formulas flattened into a table of nodes that refer to each other by index
+ *
+ * this has no dependency on proof_system so that it can be used by tools that never build a Formula, nodes are hash
+ * consed when added through intern_node, so within one table two node ids are equal iff the nodes are structurally
+ * equal. a child always has a smaller id than its parent.
+ */
+enum class NodeKind : std::uint8_t {
+    variable,
+    constant,
+    function,
+    tuple,
+    equality,
+    relation,
+    negation,
+    disjunction,
+    conjunction,
+    implication,
+    forall,
+    exists,
+};
+
+constexpr std::uint32_t no_symbol = 0xffffffff;
+constexpr std::uint32_t no_node = 0xffffffff;
+
+/**
+ * @brief symbol is the variable/constant/function/relation name, or the bound variable for quantifiers
+ *
+ * children are: arguments for functions, tuples and relations, (l, r) for equality and the binary connectives, (inner)
+ * for negation and (domain, inner) for quantifiers
+ */
+struct FlatNode {
+    NodeKind kind;
+    std::uint32_t symbol;
+    std::uint32_t first_child;
+    std::uint32_t child_count;
+};
+
+/**
+ * @brief read only access to nodes whose arrays may live outside a FlatFormulaTable, e.g. in a SharedFormulaStore
+ *
+ * the spans point into whatever holds the nodes, so a view of a FlatFormulaTable is only good until the table grows
+ */
+struct FlatFormulaView {
+    std::span<const FlatNode> nodes;
+    std::span<const std::uint32_t> children;
+    std::vector<std::string_view> symbols;
+
+    std::span<const std::uint32_t> children_of(std::uint32_t node) const {
+        const FlatNode &n = nodes[node];
+        return children.subspan(n.first_child, n.child_count);
+    }
+};
+
+class FlatFormulaTable {
+  public:
+    std::vector<std::string> symbols;
+    std::vector<FlatNode> nodes;
+    std::vector<std::uint32_t> children;
+
+    std::uint32_t intern_symbol(std::string_view name);
+    std::uint32_t intern_node(NodeKind kind, std::uint32_t symbol, std::span<const std::uint32_t> node_children);
+
+    /// returns no_symbol if the name isn't in the table, only sees symbols added by intern_symbol or reindex
+    std::uint32_t find_symbol(std::string_view name) const;
+    /// the node intern_node would return without adding it, no_node if there is none
+    std::uint32_t find_node(NodeKind kind, std::uint32_t symbol, std::span<const std::uint32_t> node_children) const;
+
+    std::span<const std::uint32_t> children_of(std::uint32_t node) const {
+        const FlatNode &n = nodes[node];
+        return {children.data() + n.first_child, n.child_count};
+    }
+
+    FlatFormulaView view() const;
+
+    /// rebuilds the lookup tables, needed before interning into a table that was filled directly (e.g. when loaded)
+    void reindex();
+
+    /// checks that ids are in range, children come before parents and every kind has the right number of children
+    bool is_well_formed(std::string *err = nullptr) const;
+
+    /// written as Formula::to_string and Term::to_string write it, for a well formed table
+    std::string to_string(std::uint32_t node) const;
+
+  private:
+    std::unordered_map<std::string, std::uint32_t> symbol_ids;
+    std::unordered_multimap<std::uint64_t, std::uint32_t> node_ids;
+
+    std::uint64_t hash_node(NodeKind kind, std::uint32_t symbol, std::span<const std::uint32_t> node_children) const;
+    std::uint32_t find_hashed_node(std::uint64_t h, NodeKind kind, std::uint32_t symbol,
+                                   std::span<const std::uint32_t> node_children) const;
+};
+
+#endif // FLAT_FORMULA_HPP
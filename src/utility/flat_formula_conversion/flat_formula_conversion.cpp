@@ -0,0 +1,151 @@
+#include "flat_formula_conversion.hpp"
+
+#include <stdexcept>
+
+// ---------- Formula -> table ----------
+
+std::uint32_t FlatFormulaBuilder::add_terms(NodeKind kind, std::uint32_t symbol, const std::vector<TermPtr> &args) {
+    std::vector<std::uint32_t> ids;
+    ids.reserve(args.size());
+    for (auto &arg : args)
+        ids.push_back(add_term(arg));
+    return table.intern_node(kind, symbol, ids);
+}
+
+std::uint32_t FlatFormulaBuilder::add_term(TermPtr t) {
+    if (!t)
+        throw std::invalid_argument("FlatFormulaBuilder: null term");
+
+    auto it = term_ids.find(t.get());
+    if (it != term_ids.end())
+        return it->second;
+
+    std::uint32_t id;
+    if (auto p = std::get_if<VariableTerm>(&t->data)) {
+        id = table.intern_node(NodeKind::variable, table.intern_symbol(p->var), {});
+    } else if (auto p = std::get_if<ConstantTerm>(&t->data)) {
+        id = table.intern_node(NodeKind::constant, table.intern_symbol(p->c), {});
+    } else if (auto p = std::get_if<FunctionTerm>(&t->data)) {
+        id = add_terms(NodeKind::function, table.intern_symbol(p->f), p->args);
+    } else {
+        id = add_terms(NodeKind::tuple, no_symbol, std::get<TupleTerm>(t->data).args);
+    }
+
+    term_ids.emplace(t.get(), id);
+    seen_terms.push_back(std::move(t));
+    return id;
+}
+
+std::uint32_t FlatFormulaBuilder::add_formula(FormulaPtr f) {
+    if (!f)
+        throw std::invalid_argument("FlatFormulaBuilder: null formula");
+
+    auto it = formula_ids.find(f.get());
+    if (it != formula_ids.end())
+        return it->second;
+
+    auto binary = [&](NodeKind kind, FormulaPtr l, FormulaPtr r) {
+        std::uint32_t ids[2] = {add_formula(l), add_formula(r)};
+        return table.intern_node(kind, no_symbol, ids);
+    };
+
+    std::uint32_t id;
+    if (auto p = std::get_if<EqualityFormula>(&f->data)) {
+        std::uint32_t ids[2] = {add_term(p->l), add_term(p->r)};
+        id = table.intern_node(NodeKind::equality, no_symbol, ids);
+    } else if (auto p = std::get_if<RelationFormula>(&f->data)) {
+        id = add_terms(NodeKind::relation, table.intern_symbol(p->R), p->args);
+    } else if (auto p = std::get_if<NotFormula>(&f->data)) {
+        std::uint32_t ids[1] = {add_formula(p->inner)};
+        id = table.intern_node(NodeKind::negation, no_symbol, ids);
+    } else if (auto p = std::get_if<OrFormula>(&f->data)) {
+        id = binary(NodeKind::disjunction, p->l, p->r);
+    } else if (auto p = std::get_if<AndFormula>(&f->data)) {
+        id = binary(NodeKind::conjunction, p->l, p->r);
+    } else if (auto p = std::get_if<ImpliesFormula>(&f->data)) {
+        id = binary(NodeKind::implication, p->l, p->r);
+    } else if (auto p = std::get_if<ForallFormula>(&f->data)) {
+        std::uint32_t ids[2] = {add_term(p->domain), add_formula(p->inner)};
+        id = table.intern_node(NodeKind::forall, table.intern_symbol(p->v), ids);
+    } else {
+        auto &q = std::get<ExistsFormula>(f->data);
+        std::uint32_t ids[2] = {add_term(q.domain), add_formula(q.inner)};
+        id = table.intern_node(NodeKind::exists, table.intern_symbol(q.v), ids);
+    }
+
+    formula_ids.emplace(f.get(), id);
+    seen_formulas.push_back(std::move(f));
+    return id;
+}
+
+// ---------- table -> Formula ----------
+
+std::vector<TermPtr> FlatFormulaReader::to_terms(std::uint32_t node) {
+    std::vector<TermPtr> args;
+    for (std::uint32_t c : table.children_of(node))
+        args.push_back(to_term(c));
+    return args;
+}
+
+TermPtr FlatFormulaReader::to_term(std::uint32_t node) {
+    if (terms[node])
+        return terms[node];
+
+    const FlatNode &n = table.nodes[node];
+    TermPtr t;
+    switch (n.kind) {
+    case NodeKind::variable:
+        t = Term::make_variable(std::string(table.symbols[n.symbol]));
+        break;
+    case NodeKind::constant:
+        t = Term::make_constant(std::string(table.symbols[n.symbol]));
+        break;
+    case NodeKind::function:
+        t = Term::make_function(std::string(table.symbols[n.symbol]), to_terms(node));
+        break;
+    case NodeKind::tuple:
+        t = Term::make_tuple(to_terms(node));
+        break;
+    default:
+        throw std::invalid_argument("FlatFormulaReader: node " + std::to_string(node) + " is not a term");
+    }
+    return terms[node] = t;
+}
+
+FormulaPtr FlatFormulaReader::to_formula(std::uint32_t node) {
+    if (formulas[node])
+        return formulas[node];
+
+    const FlatNode &n = table.nodes[node];
+    auto c = table.children_of(node);
+    FormulaPtr f;
+    switch (n.kind) {
+    case NodeKind::equality:
+        f = Formula::make_eq(to_term(c[0]), to_term(c[1]));
+        break;
+    case NodeKind::relation:
+        f = Formula::make_rel(std::string(table.symbols[n.symbol]), to_terms(node));
+        break;
+    case NodeKind::negation:
+        f = Formula::make_not(to_formula(c[0]));
+        break;
+    case NodeKind::disjunction:
+        f = Formula::make_or(to_formula(c[0]), to_formula(c[1]));
+        break;
+    case NodeKind::conjunction:
+        f = Formula::make_and(to_formula(c[0]), to_formula(c[1]));
+        break;
+    case NodeKind::implication:
+        f = Formula::make_implies(to_formula(c[0]), to_formula(c[1]));
+        break;
+    case NodeKind::forall:
+        f = Formula::make_forall(std::string(table.symbols[n.symbol]), to_term(c[0]), to_formula(c[1]));
+        break;
+    case NodeKind::exists:
+        f = Formula::make_exists(std::string(table.symbols[n.symbol]), to_term(c[0]), to_formula(c[1]));
+        break;
+    default:
+        throw std::invalid_argument("FlatFormulaReader: node " + std::to_string(node) + " is not a formula");
+    }
+    return formulas[node] = f;
+}
@@ -0,0 +1,56 @@
+#ifndef FLAT_FORMULA_CONVERSION_HPP
+#define FLAT_FORMULA_CONVERSION_HPP
+
+#include "../flat_formula/flat_formula.hpp"
+#include "../proof_system/proof_system.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief adds terms and formulas to a FlatFormulaTable, subtrees that are shared between formulas are only walked once
+ */
+class FlatFormulaBuilder {
+  public:
+    explicit FlatFormulaBuilder(FlatFormulaTable &table) : table(table) {}
+
+    std::uint32_t add_term(TermPtr t);
+    std::uint32_t add_formula(FormulaPtr f);
+
+  private:
+    FlatFormulaTable &table;
+
+    // keyed by address, the pointers are held on to so an address can't be reused by a different node
+    std::unordered_map<const Term *, std::uint32_t> term_ids;
+    std::unordered_map<const Formula *, std::uint32_t> formula_ids;
+    std::vector<TermPtr> seen_terms;
+    std::vector<FormulaPtr> seen_formulas;
+
+    std::uint32_t add_terms(NodeKind kind, std::uint32_t symbol, const std::vector<TermPtr> &args);
+};
+
+/**
+ * @brief turns nodes of a FlatFormulaTable back into terms and formulas, a node that is reached twice becomes one
+ * shared TermPtr/FormulaPtr
+ *
+ * the reader only sees the nodes there were when it was made, and the table mustn't grow while it is in use
+ */
+class FlatFormulaReader {
+  public:
+    explicit FlatFormulaReader(const FlatFormulaTable &table) : FlatFormulaReader(table.view()) {}
+    explicit FlatFormulaReader(FlatFormulaView view)
+        : table(std::move(view)), terms(table.nodes.size()), formulas(table.nodes.size()) {}
+
+    TermPtr to_term(std::uint32_t node);
+    FormulaPtr to_formula(std::uint32_t node);
+
+  private:
+    FlatFormulaView table;
+    std::vector<TermPtr> terms;
+    std::vector<FormulaPtr> formulas;
+
+    std::vector<TermPtr> to_terms(std::uint32_t node);
+};
+
+#endif // FLAT_FORMULA_CONVERSION_HPP
@@ -0,0 +1,363 @@
+#include "formula_bytecode.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+bool is_numeral(const std::string &s) {
+    return !s.empty() && std::all_of(s.begin(), s.end(), [](unsigned char c) { return std::isdigit(c); });
+}
+
+class Compiler {
+  public:
+    Compiler(const std::vector<std::string> &parameters, const NaturalInterpretation &interpretation,
+             bool branch_free)
+        : parameters(parameters), interpretation(interpretation), branch_free(branch_free) {
+        if (parameters.size() > std::numeric_limits<std::uint16_t>::max())
+            throw std::invalid_argument("compile_formula: too many parameters");
+        program.quantifier_bound = interpretation.quantifier_bound;
+        program.num_parameters = (std::uint32_t)parameters.size();
+        program.num_registers = program.num_parameters;
+    }
+
+    FormulaProgram finish() {
+        emit(OpCode::halt);
+        return std::move(program);
+    }
+
+    void term(TermPtr t) {
+        if (auto p = std::get_if<VariableTerm>(&t->data)) {
+            emit(OpCode::load_register, 0, variable_register(p->var));
+            push(1);
+            return;
+        }
+        if (auto p = std::get_if<ConstantTerm>(&t->data)) {
+            Natural value;
+            if (is_numeral(p->c)) {
+                if (std::from_chars(p->c.data(), p->c.data() + p->c.size(), value).ec != std::errc())
+                    throw std::invalid_argument("compile_formula: the numeral " + p->c + " doesn't fit in a Natural");
+            } else {
+                auto it = interpretation.constants.find(p->c);
+                if (it == interpretation.constants.end())
+                    throw std::invalid_argument("compile_formula: no value for the constant " + p->c);
+                value = it->second;
+            }
+            emit(OpCode::push_constant, 0, 0, constant(value));
+            push(1);
+            return;
+        }
+        if (auto p = std::get_if<FunctionTerm>(&t->data)) {
+            for (auto &arg : p->args)
+                term(arg);
+            if ((p->f == "+" || p->f == "*") && p->args.size() == 2) {
+                emit(p->f == "+" ? OpCode::add : OpCode::multiply);
+                pop(1);
+                return;
+            }
+            if (p->f == "succ" && p->args.size() == 1) {
+                emit(OpCode::successor);
+                return;
+            }
+            auto it = interpretation.functions.find(p->f);
+            if (it == interpretation.functions.end())
+                throw std::invalid_argument("compile_formula: no implementation for the function " + p->f);
+            emit(OpCode::call_function, arity(p->args.size()), 0, (std::uint32_t)program.functions.size());
+            program.functions.push_back(it->second);
+            pop(p->args.size());
+            push(1);
+            return;
+        }
+        throw std::invalid_argument("compile_formula: tuples have no natural number value");
+    }
+
+    void formula(FormulaPtr f) {
+        if (auto p = std::get_if<EqualityFormula>(&f->data)) {
+            term(p->l);
+            term(p->r);
+            emit(OpCode::equal);
+            pop(1);
+            return;
+        }
+        if (auto p = std::get_if<RelationFormula>(&f->data)) {
+            relation(*p);
+            return;
+        }
+        if (auto p = std::get_if<NotFormula>(&f->data)) {
+            formula(p->inner);
+            emit(OpCode::negate);
+            return;
+        }
+        if (auto p = std::get_if<AndFormula>(&f->data)) {
+            short_circuit(p->l, p->r, OpCode::jump_if_false_or_pop, false);
+            return;
+        }
+        if (auto p = std::get_if<OrFormula>(&f->data)) {
+            short_circuit(p->l, p->r, OpCode::jump_if_true_or_pop, false);
+            return;
+        }
+        if (auto p = std::get_if<ImpliesFormula>(&f->data)) {
+            short_circuit(p->l, p->r, OpCode::jump_if_true_or_pop, true);
+            return;
+        }
+        if (auto p = std::get_if<ForallFormula>(&f->data)) {
+            quantifier(true, p->v, p->domain, p->inner);
+            return;
+        }
+        if (auto p = std::get_if<ExistsFormula>(&f->data)) {
+            quantifier(false, p->v, p->domain, p->inner);
+            return;
+        }
+        throw std::invalid_argument("compile_formula: unknown formula");
+    }
+
+  private:
+    const std::vector<std::string> &parameters;
+    const NaturalInterpretation &interpretation;
+    const bool branch_free;
+    FormulaProgram program;
+
+    // bound variables and their registers, innermost last
+    std::vector<std::pair<std::string, std::uint16_t>> bound;
+    std::uint32_t depth = 0;
+
+    size_t emit(OpCode op, std::uint8_t flag = 0, std::uint16_t reg = 0, std::uint32_t operand = 0) {
+        program.code.push_back({op, flag, reg, operand});
+        return program.code.size() - 1;
+    }
+    void patch(size_t instruction) { program.code[instruction].operand = (std::uint32_t)program.code.size(); }
+
+    void push(size_t n) {
+        depth += (std::uint32_t)n;
+        program.max_stack = std::max(program.max_stack, depth);
+    }
+    void pop(size_t n) { depth -= (std::uint32_t)n; }
+
+    static std::uint8_t arity(size_t n) {
+        if (n > std::numeric_limits<std::uint8_t>::max())
+            throw std::invalid_argument("compile_formula: too many arguments");
+        return (std::uint8_t)n;
+    }
+
+    std::uint32_t constant(Natural value) {
+        program.constants.push_back(value);
+        return (std::uint32_t)program.constants.size() - 1;
+    }
+
+    std::uint16_t variable_register(const std::string &v) const {
+        for (size_t i = bound.size(); i-- > 0;)
+            if (bound[i].first == v)
+                return bound[i].second;
+        auto it = std::find(parameters.begin(), parameters.end(), v);
+        if (it == parameters.end())
+            throw std::invalid_argument("compile_formula: " + v + " is free but isn't a parameter");
+        return (std::uint16_t)(it - parameters.begin());
+    }
+
+    static bool is_naturals(TermPtr t) {
+        auto c = std::get_if<ConstantTerm>(&t->data);
+        return c && c->c == "ℕ";
+    }
+
+    void relation(const RelationFormula &r) {
+        if (r.R == "∈" && r.args.size() == 2 && is_naturals(r.args[1])) {
+            // everything has a natural number value, and evaluating the element has no side effects
+            emit(OpCode::push_constant, 0, 0, constant(1));
+            push(1);
+            return;
+        }
+        for (auto &arg : r.args)
+            term(arg);
+        if (r.args.size() == 2 && (r.R == "<" || r.R == "≤" || r.R == ">")) {
+            emit(r.R == "<" ? OpCode::less : r.R == "≤" ? OpCode::less_equal : OpCode::greater);
+            pop(1);
+            return;
+        }
+        auto it = interpretation.relations.find(r.R);
+        if (it == interpretation.relations.end())
+            throw std::invalid_argument("compile_formula: no implementation for the relation " + r.R);
+        emit(OpCode::call_relation, arity(r.args.size()), 0, (std::uint32_t)program.relations.size());
+        program.relations.push_back(it->second);
+        pop(r.args.size());
+        push(1);
+    }
+
+    // l and r, l or r, or (!l) or r, only evaluating r when l doesn't decide the result unless branch free
+    void short_circuit(FormulaPtr l, FormulaPtr r, OpCode jump, bool negate_left) {
+        formula(l);
+        if (negate_left)
+            emit(OpCode::negate);
+        if (branch_free) {
+            formula(r);
+            emit(jump == OpCode::jump_if_false_or_pop ? OpCode::logical_and : OpCode::logical_or);
+            pop(1);
+            return;
+        }
+        size_t skip = emit(jump);
+        pop(1);
+        formula(r);
+        patch(skip);
+    }
+
+    //     zero_register reg
+    // L:  loop_test reg, EXIT       pushes the empty result (true for ∀, false for ∃) once reg reaches the bound
+    //     <inner>
+    //     jump_if_false_or_pop EXIT (jump_if_true_or_pop for ∃)
+    //     increment_register reg
+    //     jump L
+    // EXIT:
+    void quantifier(bool is_forall, const std::string &v, TermPtr domain, FormulaPtr inner) {
+        if (!is_naturals(domain))
+            throw std::invalid_argument("compile_formula: can only quantify over ℕ, not " + domain->to_string());
+        if (branch_free)
+            throw std::invalid_argument("compile_formula: quantifiers can't be compiled branch free");
+        if (program.num_registers >= std::numeric_limits<std::uint16_t>::max())
+            throw std::invalid_argument("compile_formula: quantifiers are nested too deeply");
+
+        // registers are allocated by nesting depth, quantifiers side by side reuse them
+        std::uint16_t reg = (std::uint16_t)(program.num_parameters + bound.size());
+        program.num_registers = std::max(program.num_registers, (std::uint32_t)reg + 1);
+
+        emit(OpCode::zero_register, 0, reg);
+        size_t loop = emit(OpCode::loop_test, is_forall ? 1 : 0, reg);
+        bound.emplace_back(v, reg);
+        formula(inner);
+        bound.pop_back();
+        size_t decided = emit(is_forall ? OpCode::jump_if_false_or_pop : OpCode::jump_if_true_or_pop);
+        pop(1);
+        emit(OpCode::increment_register, 0, reg);
+        emit(OpCode::jump, 0, 0, (std::uint32_t)loop);
+        patch(loop);
+        patch(decided);
+        // both exits leave the result on the stack
+        push(1);
+    }
+};
+
+} // namespace
+
+FormulaProgram compile_formula(FormulaPtr f, const std::vector<std::string> &parameters,
+                               const NaturalInterpretation &interpretation, bool branch_free) {
+    Compiler compiler(parameters, interpretation, branch_free);
+    compiler.formula(f);
+    return compiler.finish();
+}
+
+FormulaProgram compile_term(TermPtr t, const std::vector<std::string> &parameters,
+                            const NaturalInterpretation &interpretation) {
+    Compiler compiler(parameters, interpretation, true);
+    compiler.term(t);
+    return compiler.finish();
+}
+
+Natural BytecodeInterpreter::run(const FormulaProgram &program, std::span<const Natural> parameters) {
+    if (parameters.size() != program.num_parameters)
+        throw std::invalid_argument("BytecodeInterpreter: expected " + std::to_string(program.num_parameters) +
+                                    " parameters");
+    if (stack.size() < program.max_stack)
+        stack.resize(program.max_stack);
+    if (registers.size() < program.num_registers)
+        registers.resize(program.num_registers);
+    std::copy(parameters.begin(), parameters.end(), registers.begin());
+    overflow = false;
+
+    const Instruction *code = program.code.data();
+    Natural *regs = registers.data();
+    // sp points one past the top of the stack
+    Natural *sp = stack.data();
+    size_t pc = 0;
+
+    for (;;) {
+        const Instruction &in = code[pc++];
+        switch (in.op) {
+        case OpCode::push_constant:
+            *sp++ = program.constants[in.operand];
+            break;
+        case OpCode::load_register:
+            *sp++ = regs[in.reg];
+            break;
+        case OpCode::add:
+            --sp;
+            overflow |= __builtin_add_overflow(sp[-1], sp[0], &sp[-1]);
+            break;
+        case OpCode::multiply:
+            --sp;
+            overflow |= __builtin_mul_overflow(sp[-1], sp[0], &sp[-1]);
+            break;
+        case OpCode::successor:
+            overflow |= __builtin_add_overflow(sp[-1], 1, &sp[-1]);
+            break;
+        case OpCode::call_function: {
+            sp -= in.flag;
+            Natural result = program.functions[in.operand](std::span<const Natural>(sp, in.flag));
+            *sp++ = result;
+            break;
+        }
+        case OpCode::equal:
+            --sp;
+            sp[-1] = sp[-1] == sp[0];
+            break;
+        case OpCode::less:
+            --sp;
+            sp[-1] = sp[-1] < sp[0];
+            break;
+        case OpCode::less_equal:
+            --sp;
+            sp[-1] = sp[-1] <= sp[0];
+            break;
+        case OpCode::greater:
+            --sp;
+            sp[-1] = sp[-1] > sp[0];
+            break;
+        case OpCode::call_relation: {
+            sp -= in.flag;
+            bool result = program.relations[in.operand](std::span<const Natural>(sp, in.flag));
+            *sp++ = result;
+            break;
+        }
+        case OpCode::negate:
+            sp[-1] = !sp[-1];
+            break;
+        case OpCode::logical_and:
+            --sp;
+            sp[-1] = sp[-1] && sp[0];
+            break;
+        case OpCode::logical_or:
+            --sp;
+            sp[-1] = sp[-1] || sp[0];
+            break;
+        case OpCode::jump:
+            pc = in.operand;
+            break;
+        case OpCode::jump_if_false_or_pop:
+            if (!sp[-1])
+                pc = in.operand;
+            else
+                --sp;
+            break;
+        case OpCode::jump_if_true_or_pop:
+            if (sp[-1])
+                pc = in.operand;
+            else
+                --sp;
+            break;
+        case OpCode::zero_register:
+            regs[in.reg] = 0;
+            break;
+        case OpCode::increment_register:
+            ++regs[in.reg];
+            break;
+        case OpCode::loop_test:
+            if (regs[in.reg] >= program.quantifier_bound) {
+                *sp++ = in.flag;
+                pc = in.operand;
+            }
+            break;
+        case OpCode::halt:
+            return sp[-1];
+        }
+    }
+}
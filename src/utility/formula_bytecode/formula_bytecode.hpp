@@ -0,0 +1,115 @@
+#ifndef FORMULA_BYTECODE_HPP
+#define FORMULA_BYTECODE_HPP
+
+#include "../proof_system/proof_system.hpp"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using Natural = std::int64_t;
+
+using NaturalFunction = std::function<Natural(std::span<const Natural>)>;
+using NaturalRelation = std::function<bool(std::span<const Natural>)>;
+
+/**
+ * @brief what the symbols of a formula mean when it is evaluated over the natural numbers
+ *
+ * numerals, +, *, succ, =, <, ≤, > and ∈ ℕ are built in, anything else has to be given here. implementations are
+ * looked up when a formula is compiled, never while it runs.
+ */
+struct NaturalInterpretation {
+    std::unordered_map<std::string, NaturalFunction> functions;
+    std::unordered_map<std::string, NaturalRelation> relations;
+    std::unordered_map<std::string, Natural> constants;
+    /// quantifiers over ℕ range over 0 .. quantifier_bound - 1
+    Natural quantifier_bound = 64;
+};
+
+enum class OpCode : std::uint8_t {
+    push_constant,        // push constants[operand]
+    load_register,        // push registers[reg]
+    add,                  // pop b, a, push a + b
+    multiply,             // pop b, a, push a * b
+    successor,            // replace a with a + 1
+    call_function,        // pop flag arguments, push functions[operand](arguments)
+    equal,                // pop b, a, push a == b
+    less,                 // pop b, a, push a < b
+    less_equal,           // pop b, a, push a <= b
+    greater,              // pop b, a, push a > b
+    call_relation,        // pop flag arguments, push relations[operand](arguments)
+    negate,               // replace a with !a
+    logical_and,          // pop b, a, push a && b
+    logical_or,           // pop b, a, push a || b
+    jump,                 // pc = operand
+    jump_if_false_or_pop, // if the top is false jump to operand and keep it, otherwise pop it
+    jump_if_true_or_pop,  // if the top is true jump to operand and keep it, otherwise pop it
+    zero_register,        // registers[reg] = 0
+    increment_register,   // ++registers[reg]
+    loop_test,            // if registers[reg] >= quantifier_bound push flag and jump to operand
+    halt,                 // the result is on top of the stack
+};
+
+struct Instruction {
+    OpCode op;
+    std::uint8_t flag;
+    std::uint16_t reg;
+    std::uint32_t operand;
+};
+
+/**
+ * @brief a formula (or term) compiled to stack machine code, immutable once compiled so it can be shared between
+ * threads, each of which evaluates it with its own BytecodeInterpreter
+ *
+ * the parameters given at compile time are the free variables of the formula, they are passed in registers
+ * 0 .. parameters - 1 and every bound variable gets a register of its own, so no variable is ever looked up by name
+ */
+struct FormulaProgram {
+    std::vector<Instruction> code;
+    std::vector<Natural> constants;
+    std::vector<NaturalFunction> functions;
+    std::vector<NaturalRelation> relations;
+    Natural quantifier_bound = 0;
+    std::uint32_t num_parameters = 0;
+    std::uint32_t num_registers = 0;
+    std::uint32_t max_stack = 0;
+};
+
+/**
+ * @brief throws std::invalid_argument for symbols the interpretation doesn't cover, numerals too large for a Natural
+ * and quantifiers over anything but ℕ
+ *
+ * a branch free program evaluates both sides of every connective and has no jumps, so it can be run over many
+ * parameter values in lock step, formulas with quantifiers can't be compiled that way
+ */
+FormulaProgram compile_formula(FormulaPtr f, const std::vector<std::string> &parameters,
+                               const NaturalInterpretation &interpretation, bool branch_free = false);
+FormulaProgram compile_term(TermPtr t, const std::vector<std::string> &parameters,
+                            const NaturalInterpretation &interpretation);
+
+/**
+ * @brief runs FormulaPrograms, keeping its stack and registers between runs so evaluating doesn't allocate
+ */
+class BytecodeInterpreter {
+  public:
+    /// the value of a term program, or 0 / 1 for a formula program, meaningless if overflowed()
+    Natural run(const FormulaProgram &program, std::span<const Natural> parameters);
+
+    bool evaluate(const FormulaProgram &program, std::span<const Natural> parameters) {
+        return run(program, parameters) != 0;
+    }
+
+    /// true if +, * or succ left the range of Natural during the last run. like Truth::overflow in the counterexample
+    /// search, the result is then fixed but says nothing about the formula, a caller counts it as neither true nor
+    /// false
+    bool overflowed() const { return overflow; }
+
+  private:
+    std::vector<Natural> stack;
+    std::vector<Natural> registers;
+    bool overflow = false;
+};
+
+#endif // FORMULA_BYTECODE_HPP
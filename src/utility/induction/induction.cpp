@@ -0,0 +1,231 @@
+#include "induction.hpp"
+
+#include <future>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+// targets remembered per InductionSchemas before the cache starts over
+constexpr size_t max_cached_targets = 1 << 12;
+// inputs with fewer formula nodes than this in total are compared on the calling thread
+constexpr size_t parallel_threshold = 1 << 12;
+
+// every variable occurring in f, bound or free, so that new variables can avoid all of them
+void collect_names(FormulaPtr f, std::set<std::string> &names) {
+    if (auto p = std::get_if<ForallFormula>(&f->data)) {
+        names.insert(p->v);
+        collect_vars_in_term(p->domain, names);
+        collect_names(p->inner, names);
+    } else if (auto p = std::get_if<ExistsFormula>(&f->data)) {
+        names.insert(p->v);
+        collect_vars_in_term(p->domain, names);
+        collect_names(p->inner, names);
+    } else if (auto p = std::get_if<NotFormula>(&f->data)) {
+        collect_names(p->inner, names);
+    } else if (auto p = std::get_if<AndFormula>(&f->data)) {
+        collect_names(p->l, names);
+        collect_names(p->r, names);
+    } else if (auto p = std::get_if<OrFormula>(&f->data)) {
+        collect_names(p->l, names);
+        collect_names(p->r, names);
+    } else if (auto p = std::get_if<ImpliesFormula>(&f->data)) {
+        collect_names(p->l, names);
+        collect_names(p->r, names);
+    } else {
+        collect_vars_in_formula(f, names);
+    }
+}
+
+std::string fresh_name(std::string name, std::set<std::string> &taken) {
+    while (taken.count(name))
+        name += "'";
+    taken.insert(name);
+    return name;
+}
+
+// takes one off budget per formula node of f, stopping once it reaches 0
+void consume(FormulaPtr f, size_t &budget) {
+    if (budget == 0)
+        return;
+    --budget;
+    if (auto p = std::get_if<NotFormula>(&f->data)) {
+        consume(p->inner, budget);
+    } else if (auto p = std::get_if<AndFormula>(&f->data)) {
+        consume(p->l, budget);
+        consume(p->r, budget);
+    } else if (auto p = std::get_if<OrFormula>(&f->data)) {
+        consume(p->l, budget);
+        consume(p->r, budget);
+    } else if (auto p = std::get_if<ImpliesFormula>(&f->data)) {
+        consume(p->l, budget);
+        consume(p->r, budget);
+    } else if (auto p = std::get_if<ForallFormula>(&f->data)) {
+        consume(p->inner, budget);
+    } else if (auto p = std::get_if<ExistsFormula>(&f->data)) {
+        consume(p->inner, budget);
+    }
+}
+
+std::vector<FormulaPtr> structural_cases(const InductiveType &type, const ForallFormula &target) {
+    std::set<std::string> names;
+    collect_names(target.inner, names);
+    names.insert(target.v);
+    TermPtr x = Term::make_variable(target.v);
+
+    std::vector<FormulaPtr> cases;
+    for (const Constructor &constructor : type.constructors) {
+        // arguments keep their declared names unless P already uses them
+        std::set<std::string> taken = names;
+        for (const ConstructorArgument &argument : constructor.arguments)
+            taken.insert(argument.name);
+
+        TermPtr pattern = constructor.pattern;
+        std::vector<std::string> argument_names;
+        std::vector<FormulaPtr> hypotheses;
+        for (const ConstructorArgument &argument : constructor.arguments) {
+            std::string name = argument.name;
+            if (names.count(name)) {
+                name = fresh_name(name, taken);
+                pattern = substitute_in_term(pattern, Term::make_variable(argument.name), Term::make_variable(name));
+            }
+            argument_names.push_back(name);
+            if (terms_equal(argument.domain, type.domain))
+                hypotheses.push_back(substitute_in_formula(target.inner, x, Term::make_variable(name)));
+        }
+
+        FormulaPtr body = substitute_in_formula(target.inner, x, pattern);
+        if (!hypotheses.empty()) {
+            FormulaPtr all_hypotheses = hypotheses[0];
+            for (size_t i = 1; i < hypotheses.size(); ++i)
+                all_hypotheses = Formula::make_and(all_hypotheses, hypotheses[i]);
+            body = Formula::make_implies(all_hypotheses, body);
+        }
+        for (size_t i = constructor.arguments.size(); i-- > 0;)
+            body = Formula::make_forall(argument_names[i], constructor.arguments[i].domain, body);
+        cases.push_back(body);
+    }
+    return cases;
+}
+
+std::vector<FormulaPtr> strong_cases(const TermPtr &domain, const std::string &order, const ForallFormula &target) {
+    std::set<std::string> names;
+    collect_names(target.inner, names);
+    names.insert(target.v);
+
+    // ∀x ∈ D ((∀m ∈ D (m < x → P(m))) → P(x))
+    std::string smaller = fresh_name("m", names);
+    TermPtr x = Term::make_variable(target.v);
+    TermPtr m = Term::make_variable(smaller);
+    FormulaPtr below = Formula::make_forall(
+        smaller, domain,
+        Formula::make_implies(Formula::make_rel(order, {m, x}), substitute_in_formula(target.inner, x, m)));
+    return {Formula::make_forall(target.v, domain, Formula::make_implies(below, target.inner))};
+}
+
+} // namespace
+
+Constructor make_constructor(const std::string &name, std::vector<ConstructorArgument> arguments) {
+    if (arguments.empty())
+        return {Term::make_constant(name), {}};
+    std::vector<TermPtr> variables;
+    for (const ConstructorArgument &argument : arguments)
+        variables.push_back(Term::make_variable(argument.name));
+    return {Term::make_function(name, variables), std::move(arguments)};
+}
+
+InductiveType natural_numbers_type() {
+    TermPtr natural_numbers = Term::make_constant("ℕ");
+    TermPtr successor = Term::make_function("+", {Term::make_variable("k"), Term::make_constant("1")});
+    return {natural_numbers, {{Term::make_constant("0"), {}}, {successor, {{"k", natural_numbers}}}}};
+}
+
+InductionSchemas::InductionSchemas(InductiveType type) : induction_domain(type.domain) {
+    if (type.constructors.empty())
+        throw std::invalid_argument("InductionSchemas: " + type.domain->to_string() + " has no constructors");
+    schemas_id = hash_combine(1, hash_term(type.domain));
+    for (const Constructor &constructor : type.constructors) {
+        schemas_id = hash_combine(hash_combine(schemas_id, hash_term(constructor.pattern)), constructor.arguments.size());
+        for (const ConstructorArgument &argument : constructor.arguments)
+            schemas_id = hash_combine(hash_combine(schemas_id, hash_term(Term::make_variable(argument.name))),
+                                      hash_term(argument.domain));
+    }
+    derive = [type = std::move(type)](const ForallFormula &target) { return structural_cases(type, target); };
+}
+
+InductionSchemas::InductionSchemas(TermPtr domain, std::string order) : induction_domain(domain) {
+    schemas_id = hash_combine(hash_combine(2, hash_term(domain)), hash_term(Term::make_constant(order)));
+    derive = [domain = std::move(domain), order = std::move(order)](const ForallFormula &target) {
+        return strong_cases(domain, order, target);
+    };
+}
+
+std::shared_ptr<const std::vector<FormulaPtr>> InductionSchemas::cases(FormulaPtr target) {
+    auto forall = std::get_if<ForallFormula>(&target->data);
+    if (!forall || !terms_equal(forall->domain, induction_domain))
+        throw std::invalid_argument("Induction: " + target->to_string() + " is not a forall over " +
+                                    induction_domain->to_string());
+
+    std::uint64_t h = hash_formula(target);
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto [begin, end] = cache.equal_range(h);
+        for (auto it = begin; it != end; ++it)
+            if (alpha_equivalent(it->second.first, target))
+                return it->second.second;
+    }
+
+    // derived without holding the lock, two threads deriving the same schema at once just both cache it
+    auto derived = std::make_shared<const std::vector<FormulaPtr>>(derive(*forall));
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (cache.size() >= max_cached_targets)
+        cache.clear();
+    cache.emplace(h, std::make_pair(target, derived));
+    return derived;
+}
+
+void InductionSchemas::check(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
+    std::shared_ptr<const std::vector<FormulaPtr>> expected = cases(claimed);
+    const std::vector<FormulaPtr> &expected_cases = *expected;
+    if (inputs.size() != expected_cases.size())
+        throw std::invalid_argument("Induction: " + claimed->to_string() + " requires " +
+                                    std::to_string(expected_cases.size()) + " inputs, one per case");
+
+    size_t budget = parallel_threshold;
+    for (const FormulaPtr &input : inputs)
+        consume(input, budget);
+    bool parallel = expected_cases.size() > 1 && budget == 0 && std::thread::hardware_concurrency() > 1;
+
+    // every case but the first on its own thread, the first on this one
+    std::vector<std::future<bool>> pending;
+    if (parallel) {
+        for (size_t i = 1; i < expected_cases.size(); ++i)
+            pending.push_back(
+                std::async(std::launch::async, [&, i] { return alpha_equivalent(inputs[i], expected_cases[i]); }));
+    }
+
+    for (size_t i = 0; i < expected_cases.size(); ++i) {
+        bool same = parallel && i > 0 ? pending[i - 1].get() : alpha_equivalent(inputs[i], expected_cases[i]);
+        if (!same)
+            throw std::invalid_argument("Induction: case " + std::to_string(i) + " should be " +
+                                        expected_cases[i]->to_string() + " but got " + inputs[i]->to_string());
+    }
+}
+
+InductionSchemas &natural_induction() {
+    static InductionSchemas schemas(natural_numbers_type());
+    return schemas;
+}
+
+InductionSchemas &strong_natural_induction() {
+    static InductionSchemas schemas(Term::make_constant("ℕ"), "<");
+    return schemas;
+}
+
+LineRule induction_rule_for(std::shared_ptr<InductionSchemas> schemas) {
+    return [schemas = std::move(schemas)](const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
+        schemas->check(inputs, claimed);
+        return claimed;
+    };
+}
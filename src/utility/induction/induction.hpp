@@ -0,0 +1,92 @@
+#ifndef INDUCTION_HPP
+#define INDUCTION_HPP
+
+#include "../proof_system/proof_system.hpp"
+#include "../rule_registry/rule_registry.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct ConstructorArgument {
+    std::string name;
+    // arguments over the inductive type itself are the recursive ones, they get an induction hypothesis
+    TermPtr domain;
+};
+
+/**
+ * @brief one way of building a value of an inductive type, pattern is the value built from the arguments, eg cons(h,
+ * t) with h ∈ ℕ and t ∈ List, or k + 1 with k ∈ ℕ
+ */
+struct Constructor {
+    TermPtr pattern;
+    std::vector<ConstructorArgument> arguments;
+};
+
+/**
+ * @brief a type given by its constructors, eg lists or trees encoded as function symbols
+ *
+ * induction over it is only sound if every element of domain is built by the constructors, declaring the type is
+ * taking that as an axiom.
+ */
+struct InductiveType {
+    TermPtr domain;
+    std::vector<Constructor> constructors;
+};
+
+/// a constructor whose pattern is name(arguments), or the constant name if there are none
+Constructor make_constructor(const std::string &name, std::vector<ConstructorArgument> arguments = {});
+
+/// ℕ built from 0 and k + 1
+InductiveType natural_numbers_type();
+
+/**
+ * @brief the cases that prove a target ∀x ∈ D P(x) by induction, derived once per target (up to alpha equivalence)
+ * and cached, safe to share between threads
+ *
+ * structural induction has one case per constructor: ∀a1 ∈ D1 ... ((P(r1) ∧ ... ∧ P(rj)) → P(c(a1, ...))) where
+ * r1 ... rj are the recursive arguments. strong induction has the single case ∀x ∈ D ((∀m ∈ D (m < x → P(m))) → P(x))
+ * for a given order, which has to be well founded on D.
+ */
+class InductionSchemas {
+  public:
+    explicit InductionSchemas(InductiveType type);
+    InductionSchemas(TermPtr domain, std::string order);
+
+    const TermPtr &domain() const { return induction_domain; }
+
+    /**
+     * @brief a hash of the type or the domain and order the schemas were built from, the same in every process for
+     * schemas built from the same ones, so proof records can refer to schemas by it
+     */
+    std::uint64_t id() const { return schemas_id; }
+
+    /// throws std::invalid_argument if target isn't a ∀ over the domain
+    std::shared_ptr<const std::vector<FormulaPtr>> cases(FormulaPtr target);
+
+    /// throws std::invalid_argument unless inputs are the cases of claimed, in order
+    void check(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
+
+  private:
+    using Derivation = std::function<std::vector<FormulaPtr>(const ForallFormula &)>;
+
+    TermPtr induction_domain;
+    std::uint64_t schemas_id;
+    Derivation derive;
+
+    std::mutex cache_mutex;
+    std::unordered_multimap<std::uint64_t, std::pair<FormulaPtr, std::shared_ptr<const std::vector<FormulaPtr>>>> cache;
+};
+
+/// the schemas used by the built in INDUCTION and STRONG_INDUCTION rules, over ℕ
+InductionSchemas &natural_induction();
+InductionSchemas &strong_natural_induction();
+
+/// a rule checking induction with schemas, add it to a RuleRegistry or with Proof::register_rule
+LineRule induction_rule_for(std::shared_ptr<InductionSchemas> schemas);
+
+#endif // INDUCTION_HPP
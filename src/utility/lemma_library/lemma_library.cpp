@@ -0,0 +1,353 @@
+#include "lemma_library.hpp"
+#include "../certificate/certificate.hpp"
+#include "../flat_formula_conversion/flat_formula_conversion.hpp"
+#include "../lemma_store/lemma_store.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char records_magic[8] = {'M', 'W', 'E', 'L', 'E', 'M', 'M', 'A'};
+constexpr char index_magic[8] = {'M', 'W', 'E', 'L', 'I', 'D', 'X', '0'};
+// version 2: statement and assumption hashes became alpha invariant
+// version 3: records hold the formulas rather than the statement text and assumption hashes
+constexpr std::uint32_t library_version = 3;
+constexpr std::uint64_t initial_index_capacity = 1024;
+
+struct RecordsHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+};
+
+struct IndexHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t capacity; // always a power of two
+    std::uint64_t count;
+};
+
+struct IndexSlot {
+    std::uint64_t key; // zero marks an empty slot
+    std::uint64_t offset;
+};
+
+// followed by formulas_length bytes padded to 8, a serialized certificate whose goal is the statement and whose
+// assumptions are the lemma's
+struct RecordHeader {
+    std::uint64_t statement_hash;
+    std::uint64_t assumptions_fingerprint;
+    std::uint32_t formulas_length;
+    std::uint32_t reserved;
+};
+
+size_t padded(size_t n) { return (n + 7) & ~size_t(7); }
+
+std::uint64_t index_key(std::uint64_t statement_hash) { return statement_hash == 0 ? 1 : statement_hash; }
+
+size_t index_file_size(std::uint64_t capacity) { return sizeof(IndexHeader) + capacity * sizeof(IndexSlot); }
+
+IndexHeader *index_header(std::byte *index) { return reinterpret_cast<IndexHeader *>(index); }
+IndexSlot *index_slots(std::byte *index) { return reinterpret_cast<IndexSlot *>(index + sizeof(IndexHeader)); }
+
+// slots are written offset first and key last, so a reader that sees the key also sees the offset
+void insert_slot(std::byte *index, std::uint64_t key, std::uint64_t offset) {
+    IndexHeader *header = index_header(index);
+    IndexSlot *slots = index_slots(index);
+    std::uint64_t mask = header->capacity - 1;
+    for (std::uint64_t i = key & mask;; i = (i + 1) & mask) {
+        if (std::atomic_ref<std::uint64_t>(slots[i].key).load(std::memory_order_acquire) != 0)
+            continue;
+        slots[i].offset = offset;
+        std::atomic_ref<std::uint64_t>(slots[i].key).store(key, std::memory_order_release);
+        std::atomic_ref<std::uint64_t>(header->count).fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+}
+
+// answers AssumptionAvailable for exactly the given assumptions
+AssumptionAvailable available_in(const std::vector<FormulaPtr> &assumptions) {
+    auto by_hash = std::make_shared<std::unordered_multimap<std::uint64_t, FormulaPtr>>();
+    for (const FormulaPtr &a : assumptions)
+        by_hash->emplace(hash_formula(a), a);
+    return [by_hash](const FormulaPtr &f) {
+        auto [begin, end] = by_hash->equal_range(hash_formula(f));
+        return std::any_of(begin, end, [&](const auto &entry) { return alpha_equivalent(entry.second, f); });
+    };
+}
+
+[[noreturn]] void throw_system_error(const std::string &what, const std::string &path) {
+    throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+// holds an exclusive flock for the lifetime of the object
+struct FileLock {
+    int fd;
+    explicit FileLock(int fd) : fd(fd) {
+        if (flock(fd, LOCK_EX) != 0)
+            throw std::runtime_error(std::string("flock failed: ") + std::strerror(errno));
+    }
+    ~FileLock() { flock(fd, LOCK_UN); }
+};
+
+} // namespace
+
+LemmaLibrary::LemmaLibrary(const std::string &path) : records_path(path), index_path(path + ".index") {
+    records_fd = ::open(records_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (records_fd < 0)
+        throw_system_error("could not open lemma library", records_path);
+
+    FileLock lock(records_fd);
+
+    struct stat st;
+    if (fstat(records_fd, &st) != 0)
+        throw_system_error("could not stat lemma library", records_path);
+
+    if (st.st_size == 0) {
+        RecordsHeader header{};
+        std::memcpy(header.magic, records_magic, sizeof(records_magic));
+        header.version = library_version;
+        if (pwrite(records_fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+            throw_system_error("could not initialize lemma library", records_path);
+    } else {
+        RecordsHeader header{};
+        if (pread(records_fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+            std::memcmp(header.magic, records_magic, sizeof(records_magic)) != 0 || header.version != library_version)
+            throw std::runtime_error("not a lemma library (or wrong version): " + records_path);
+    }
+
+    map_records();
+
+    // the index is only rebuilt when it is missing or unusable, normally opening a library is just two mmaps
+    int fd = ::open(index_path.c_str(), O_RDONLY | O_CLOEXEC);
+    bool index_usable = false;
+    if (fd >= 0) {
+        IndexHeader header{};
+        index_usable = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                       std::memcmp(header.magic, index_magic, sizeof(index_magic)) == 0 &&
+                       header.version == library_version;
+        ::close(fd);
+    }
+    if (!index_usable)
+        rebuild_index(initial_index_capacity);
+
+    map_index();
+}
+
+LemmaLibrary::~LemmaLibrary() {
+    if (records)
+        munmap(const_cast<std::byte *>(records), records_size);
+    if (index)
+        munmap(index, index_size);
+    if (records_fd >= 0)
+        ::close(records_fd);
+    if (index_fd >= 0)
+        ::close(index_fd);
+}
+
+void LemmaLibrary::map_records() {
+    struct stat st;
+    if (fstat(records_fd, &st) != 0)
+        throw_system_error("could not stat lemma library", records_path);
+
+    if (records)
+        munmap(const_cast<std::byte *>(records), records_size);
+
+    records_size = st.st_size;
+    void *mapped = mmap(nullptr, records_size, PROT_READ, MAP_SHARED, records_fd, 0);
+    if (mapped == MAP_FAILED)
+        throw_system_error("could not map lemma library", records_path);
+    records = static_cast<const std::byte *>(mapped);
+}
+
+void LemmaLibrary::map_index() {
+    // reopen by path, another process may have replaced the index with a larger one
+    int fd = ::open(index_path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        throw_system_error("could not open lemma index", index_path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        throw_system_error("could not stat lemma index", index_path);
+
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+        throw_system_error("could not map lemma index", index_path);
+
+    if (index)
+        munmap(index, index_size);
+    if (index_fd >= 0)
+        ::close(index_fd);
+
+    index_fd = fd;
+    index = static_cast<std::byte *>(mapped);
+    index_size = st.st_size;
+    index_inode = st.st_ino;
+}
+
+void LemmaLibrary::refresh() {
+    struct stat st;
+    if (stat(index_path.c_str(), &st) == 0 && (std::uint64_t)st.st_ino != index_inode)
+        map_index();
+    if (fstat(records_fd, &st) == 0 && (size_t)st.st_size != records_size)
+        map_records();
+}
+
+void LemmaLibrary::rebuild_index(std::uint64_t capacity) {
+    // written next to the index and renamed over it, so readers never see a half built table
+    std::string tmp_path = index_path + ".tmp." + std::to_string(getpid());
+    int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw_system_error("could not create lemma index", tmp_path);
+
+    size_t size = index_file_size(capacity);
+    if (ftruncate(fd, size) != 0)
+        throw_system_error("could not size lemma index", tmp_path);
+
+    void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+        throw_system_error("could not map lemma index", tmp_path);
+    std::byte *new_index = static_cast<std::byte *>(mapped);
+
+    IndexHeader *header = index_header(new_index);
+    std::memcpy(header->magic, index_magic, sizeof(index_magic));
+    header->version = library_version;
+    header->capacity = capacity;
+    header->count = 0;
+
+    size_t offset = sizeof(RecordsHeader);
+    while (offset + sizeof(RecordHeader) <= records_size) {
+        RecordHeader record;
+        std::memcpy(&record, records + offset, sizeof(record));
+        insert_slot(new_index, index_key(record.statement_hash), offset);
+        offset += sizeof(RecordHeader) + padded(record.formulas_length);
+    }
+
+    munmap(mapped, size);
+    ::close(fd);
+
+    if (rename(tmp_path.c_str(), index_path.c_str()) != 0)
+        throw_system_error("could not replace lemma index", index_path);
+}
+
+bool LemmaLibrary::record_matches(std::uint64_t offset, std::uint64_t statement_hash,
+                                  std::optional<std::uint64_t> fingerprint, const AssumptionAvailable &is_available,
+                                  const FormulaPtr &statement) const {
+    if (offset + sizeof(RecordHeader) > records_size)
+        return false; // appended after our mapping was made
+
+    RecordHeader record;
+    std::memcpy(&record, records + offset, sizeof(record));
+    const std::byte *formulas = records + offset + sizeof(RecordHeader);
+
+    if (record.formulas_length > records_size - offset - sizeof(RecordHeader))
+        return false;
+    if (record.statement_hash != statement_hash || (fingerprint && record.assumptions_fingerprint != *fingerprint))
+        return false;
+
+    // the hashes match, so the formulas are read back and compared for real, a damaged record just doesn't match
+    Certificate stored;
+    try {
+        stored = parse_certificate({reinterpret_cast<const char *>(formulas), record.formulas_length});
+    } catch (const std::invalid_argument &) {
+        return false;
+    }
+    if (!stored.nodes.is_well_formed() || stored.goal >= stored.nodes.nodes.size())
+        return false;
+    FlatFormulaReader reader(stored.nodes);
+    if (!alpha_equivalent(reader.to_formula(stored.goal), statement))
+        return false;
+    for (std::uint32_t a : stored.assumptions)
+        if (a >= stored.nodes.nodes.size() || !is_available(reader.to_formula(a)))
+            return false;
+    return true;
+}
+
+bool LemmaLibrary::find(std::uint64_t statement_hash, std::optional<std::uint64_t> fingerprint,
+                        const AssumptionAvailable &is_available, const FormulaPtr &statement) const {
+    IndexHeader *header = index_header(index);
+    IndexSlot *slots = index_slots(index);
+    std::uint64_t key = index_key(statement_hash);
+    std::uint64_t mask = header->capacity - 1;
+
+    for (std::uint64_t i = key & mask;; i = (i + 1) & mask) {
+        std::uint64_t slot_key = std::atomic_ref<std::uint64_t>(slots[i].key).load(std::memory_order_acquire);
+        if (slot_key == 0)
+            return false;
+        if (slot_key == key && record_matches(slots[i].offset, statement_hash, fingerprint, is_available, statement))
+            return true;
+    }
+}
+
+void LemmaLibrary::insert_into_index(std::uint64_t key, std::uint64_t offset) {
+    IndexHeader *header = index_header(index);
+    // keep the table at most half full so probes stay short
+    if ((header->count + 1) * 2 > header->capacity) {
+        rebuild_index(header->capacity * 2); // picks up the record at offset as well
+        map_index();
+        return;
+    }
+    insert_slot(index, key, offset);
+}
+
+void LemmaLibrary::add_lemma(const std::vector<FormulaPtr> &assumptions, FormulaPtr statement) {
+    std::uint64_t statement_hash = hash_formula(statement);
+    std::uint64_t fingerprint = fingerprint_assumptions(assumptions);
+
+    // nodes are hash consed, so an assumption given twice is stored once
+    Certificate formulas;
+    FlatFormulaBuilder builder(formulas.nodes);
+    formulas.goal = builder.add_formula(statement);
+    for (const FormulaPtr &a : assumptions)
+        formulas.assumptions.push_back(builder.add_formula(a));
+    std::sort(formulas.assumptions.begin(), formulas.assumptions.end());
+    formulas.assumptions.erase(std::unique(formulas.assumptions.begin(), formulas.assumptions.end()),
+                               formulas.assumptions.end());
+    std::string formula_bytes = serialize_certificate(formulas);
+
+    FileLock lock(records_fd);
+    refresh();
+
+    if (find(statement_hash, fingerprint, available_in(assumptions), statement))
+        return;
+
+    RecordHeader record{statement_hash, fingerprint, (std::uint32_t)formula_bytes.size(), 0};
+
+    std::vector<std::byte> bytes(sizeof(RecordHeader) + padded(formula_bytes.size()));
+    std::memcpy(bytes.data(), &record, sizeof(record));
+    std::memcpy(bytes.data() + sizeof(record), formula_bytes.data(), formula_bytes.size());
+
+    // records are only ever appended at the end of the file
+    std::uint64_t offset = records_size;
+    if (pwrite(records_fd, bytes.data(), bytes.size(), offset) != (ssize_t)bytes.size())
+        throw_system_error("could not append to lemma library", records_path);
+
+    map_records();
+    insert_into_index(index_key(statement_hash), offset);
+}
+
+bool LemmaLibrary::contains_lemma(const AssumptionAvailable &is_available, FormulaPtr statement) {
+    std::uint64_t statement_hash = hash_formula(statement);
+
+    if (find(statement_hash, std::nullopt, is_available, statement))
+        return true;
+
+    // other processes may have added lemmas since we mapped the files
+    refresh();
+    return find(statement_hash, std::nullopt, is_available, statement);
+}
+
+size_t LemmaLibrary::size() const { return index_header(index)->count; }
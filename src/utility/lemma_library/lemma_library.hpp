@@ -0,0 +1,68 @@
+#ifndef LEMMA_LIBRARY_HPP
+#define LEMMA_LIBRARY_HPP
+
+#include "../proof_system/proof_system.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+/// answers whether an assumption (or an alpha variant of it) is available to the proof asking
+using AssumptionAvailable = std::function<bool(const FormulaPtr &)>;
+
+/**
+ * @brief proven lemmas persisted on disk so that every process on the host can cite them
+ *
+ * the library is two files: `path` holds append-only lemma records and `path.index` holds an open addressing hash table
+ * from statement hash to record offset. both are memory mapped, so opening a library never parses the records, a
+ * lookup is a probe in the index, and only a record whose hash matches is read back and compared structurally. a
+ * record holds the statement and the assumptions in the flat format of certificates.
+ *
+ * appends take an exclusive flock on the record file, lookups take no lock and pick up lemmas appended by other
+ * processes by remapping when they miss.
+ */
+class LemmaLibrary {
+  public:
+    explicit LemmaLibrary(const std::string &path);
+    ~LemmaLibrary();
+
+    LemmaLibrary(const LemmaLibrary &) = delete;
+    LemmaLibrary &operator=(const LemmaLibrary &) = delete;
+
+    void add_lemma(const std::vector<FormulaPtr> &assumptions, FormulaPtr statement);
+
+    /// true if some stored lemma proves the statement (up to alpha equivalence) from available assumptions
+    bool contains_lemma(const AssumptionAvailable &is_available, FormulaPtr statement);
+
+    size_t size() const;
+
+  private:
+    std::string records_path;
+    std::string index_path;
+
+    int records_fd = -1;
+    int index_fd = -1;
+
+    const std::byte *records = nullptr;
+    size_t records_size = 0;
+
+    std::byte *index = nullptr;
+    size_t index_size = 0;
+    std::uint64_t index_inode = 0;
+
+    void map_records();
+    void map_index();
+    void refresh();
+    void rebuild_index(std::uint64_t capacity);
+
+    /// fingerprint, if given, is what the record's assumptions have to hash to as well
+    bool record_matches(std::uint64_t offset, std::uint64_t statement_hash, std::optional<std::uint64_t> fingerprint,
+                        const AssumptionAvailable &is_available, const FormulaPtr &statement) const;
+    bool find(std::uint64_t statement_hash, std::optional<std::uint64_t> fingerprint,
+              const AssumptionAvailable &is_available, const FormulaPtr &statement) const;
+    void insert_into_index(std::uint64_t key, std::uint64_t offset);
+};
+
+#endif // LEMMA_LIBRARY_HPP
@@ -0,0 +1,103 @@
+#include "lemma_store.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+std::uint64_t fingerprint_assumptions(const std::vector<FormulaPtr> &assumptions) {
+    std::vector<std::uint64_t> hashes;
+    hashes.reserve(assumptions.size());
+    for (auto &a : assumptions)
+        hashes.push_back(hash_formula(a));
+
+    // sort so that the order in which assumptions were given does not matter
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+    std::uint64_t fingerprint = hashes.size();
+    for (auto h : hashes)
+        fingerprint = hash_combine(fingerprint, h);
+    return fingerprint;
+}
+
+namespace {
+
+bool contains_variant(const std::vector<FormulaPtr> &formulas, const FormulaPtr &f) {
+    std::uint64_t h = hash_formula(f);
+    return std::any_of(formulas.begin(), formulas.end(),
+                       [&](const FormulaPtr &g) { return hash_formula(g) == h && alpha_equivalent(g, f); });
+}
+
+// equal up to alpha equivalence as sets, duplicates ignored
+bool same_assumptions(const std::vector<FormulaPtr> &a, const std::vector<FormulaPtr> &b) {
+    return std::all_of(a.begin(), a.end(), [&](const FormulaPtr &f) { return contains_variant(b, f); }) &&
+           std::all_of(b.begin(), b.end(), [&](const FormulaPtr &f) { return contains_variant(a, f); });
+}
+
+bool all_available(const Lemma &lemma, const AssumptionAvailable &is_available) {
+    return std::all_of(lemma.assumptions.begin(), lemma.assumptions.end(), is_available);
+}
+
+} // namespace
+
+void LemmaStore::add_lemma(std::vector<FormulaPtr> assumptions, FormulaPtr statement,
+                           std::vector<ProofLine> certificate) {
+    std::uint64_t fingerprint = fingerprint_assumptions(assumptions);
+
+    // proving the same thing twice doesn't give us a new lemma
+    if (find_lemma(assumptions, statement))
+        return;
+
+    if (library)
+        library->add_lemma(assumptions, statement);
+
+    std::uint64_t statement_hash = hash_formula(statement);
+    size_t idx = lemmas.size();
+    lemmas.push_back({fingerprint, std::move(assumptions), std::move(statement), std::move(certificate)});
+
+    lemmas_by_key.emplace(hash_combine(fingerprint, statement_hash), idx);
+    lemmas_by_statement.emplace(statement_hash, idx);
+}
+
+const Lemma *LemmaStore::find_lemma(const std::vector<FormulaPtr> &assumptions, FormulaPtr statement) const {
+    std::uint64_t fingerprint = fingerprint_assumptions(assumptions);
+    auto [begin, end] = lemmas_by_key.equal_range(hash_combine(fingerprint, hash_formula(statement)));
+    for (auto it = begin; it != end; ++it) {
+        const Lemma &lemma = lemmas[it->second];
+        // hashes only narrow the search, the formulas decide
+        if (lemma.assumptions_fingerprint == fingerprint && alpha_equivalent(lemma.statement, statement) &&
+            same_assumptions(lemma.assumptions, assumptions))
+            return &lemma;
+    }
+    return nullptr;
+}
+
+const Lemma *LemmaStore::find_applicable_lemma(std::uint64_t assumptions_fingerprint,
+                                               const AssumptionAvailable &is_available,
+                                               FormulaPtr statement) const {
+    // a lemma proven from the same assumptions is the likely one, its assumptions are still checked one by one
+    std::uint64_t statement_hash = hash_formula(statement);
+    auto [begin, end] = lemmas_by_key.equal_range(hash_combine(assumptions_fingerprint, statement_hash));
+    for (auto it = begin; it != end; ++it) {
+        const Lemma &lemma = lemmas[it->second];
+        if (alpha_equivalent(lemma.statement, statement) && all_available(lemma, is_available))
+            return &lemma;
+    }
+
+    std::tie(begin, end) = lemmas_by_statement.equal_range(statement_hash);
+    for (auto it = begin; it != end; ++it) {
+        const Lemma &lemma = lemmas[it->second];
+        if (alpha_equivalent(lemma.statement, statement) && all_available(lemma, is_available))
+            return &lemma;
+    }
+    return nullptr;
+}
+
+void LemmaStore::attach_library(LemmaLibrary &library) { this->library = &library; }
+
+bool LemmaStore::proves(std::uint64_t assumptions_fingerprint,
+                        const AssumptionAvailable &is_available,
+                        FormulaPtr statement) const {
+    if (find_applicable_lemma(assumptions_fingerprint, is_available, statement))
+        return true;
+    return library && library->contains_lemma(is_available, statement);
+}
@@ -0,0 +1,66 @@
+#ifndef LEMMA_STORE_HPP
+#define LEMMA_STORE_HPP
+
+#include "../lemma_library/lemma_library.hpp"
+#include "../proof/proof.hpp"
+#include "../proof_system/proof_system.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief a statement that was proven from a set of assumptions, together with the lines that proved it
+ */
+struct Lemma {
+    std::uint64_t assumptions_fingerprint;
+    std::vector<FormulaPtr> assumptions;
+    FormulaPtr statement;
+    std::vector<ProofLine> certificate;
+};
+
+/**
+ * @brief order independent fingerprint of a set of assumptions, duplicates are ignored
+ */
+std::uint64_t fingerprint_assumptions(const std::vector<FormulaPtr> &assumptions);
+
+/**
+ * @brief proven lemmas shared between Proof instances
+ *
+ * lemmas are keyed by (assumption fingerprint, statement hash) so that a proof with the same assumptions can cite a
+ * lemma with a single hash lookup, lemmas proven from fewer assumptions are found through the statement index.
+ */
+class LemmaStore {
+  public:
+    void add_lemma(std::vector<FormulaPtr> assumptions, FormulaPtr statement, std::vector<ProofLine> certificate);
+
+    /// lemma for the statement proven from exactly these assumptions, both up to alpha equivalence
+    const Lemma *find_lemma(const std::vector<FormulaPtr> &assumptions, FormulaPtr statement) const;
+
+    /**
+     * @brief any lemma for the statement whose assumptions are all available, lemmas proven from assumptions with the
+     * given fingerprint are tried first
+     */
+    const Lemma *find_applicable_lemma(std::uint64_t assumptions_fingerprint,
+                                       const AssumptionAvailable &is_available,
+                                       FormulaPtr statement) const;
+
+    /**
+     * @brief also persist lemmas to an on-disk library, and fall back to it when a lemma isn't in memory
+     */
+    void attach_library(LemmaLibrary &library);
+
+    /// true if the statement was proven, either in memory or in the attached library
+    bool proves(std::uint64_t assumptions_fingerprint,
+                const AssumptionAvailable &is_available, FormulaPtr statement) const;
+
+    size_t size() const { return lemmas.size(); }
+
+  private:
+    LemmaLibrary *library = nullptr;
+
+    std::vector<Lemma> lemmas;
+    std::unordered_multimap<std::uint64_t, size_t> lemmas_by_key;
+    std::unordered_multimap<std::uint64_t, size_t> lemmas_by_statement;
+};
+
+#endif // LEMMA_STORE_HPP
@@ -0,0 +1,130 @@
+#include "premise_selection.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+namespace {
+
+template <typename Visit> void for_each_symbol_in_term(const TermPtr &t, Visit &visit) {
+    if (auto p = std::get_if<ConstantTerm>(&t->data)) {
+        visit(p->c);
+    } else if (auto p = std::get_if<FunctionTerm>(&t->data)) {
+        visit(p->f);
+        for (const TermPtr &arg : p->args)
+            for_each_symbol_in_term(arg, visit);
+    } else if (auto p = std::get_if<TupleTerm>(&t->data)) {
+        for (const TermPtr &arg : p->args)
+            for_each_symbol_in_term(arg, visit);
+    }
+}
+
+template <typename Visit> void for_each_symbol(const FormulaPtr &f, Visit &visit) {
+    if (auto p = std::get_if<EqualityFormula>(&f->data)) {
+        for_each_symbol_in_term(p->l, visit);
+        for_each_symbol_in_term(p->r, visit);
+    } else if (auto p = std::get_if<RelationFormula>(&f->data)) {
+        visit(p->R);
+        for (const TermPtr &arg : p->args)
+            for_each_symbol_in_term(arg, visit);
+    } else if (auto p = std::get_if<NotFormula>(&f->data)) {
+        for_each_symbol(p->inner, visit);
+    } else if (auto p = std::get_if<AndFormula>(&f->data)) {
+        for_each_symbol(p->l, visit);
+        for_each_symbol(p->r, visit);
+    } else if (auto p = std::get_if<OrFormula>(&f->data)) {
+        for_each_symbol(p->l, visit);
+        for_each_symbol(p->r, visit);
+    } else if (auto p = std::get_if<ImpliesFormula>(&f->data)) {
+        for_each_symbol(p->l, visit);
+        for_each_symbol(p->r, visit);
+    } else if (auto p = std::get_if<ForallFormula>(&f->data)) {
+        for_each_symbol_in_term(p->domain, visit);
+        for_each_symbol(p->inner, visit);
+    } else if (auto p = std::get_if<ExistsFormula>(&f->data)) {
+        for_each_symbol_in_term(p->domain, visit);
+        for_each_symbol(p->inner, visit);
+    }
+}
+
+} // namespace
+
+PremiseIndex::PremiseIndex(const std::vector<FormulaPtr> &premises, double tolerance) {
+    premise_offsets.reserve(premises.size() + 1);
+    std::vector<std::uint32_t> symbols;
+    auto intern = [&](const std::string &name) {
+        auto [it, inserted] = symbol_ids.try_emplace(name, (std::uint32_t)symbol_ids.size());
+        symbols.push_back(it->second);
+    };
+    for (const FormulaPtr &premise : premises) {
+        symbols.clear();
+        for_each_symbol(premise, intern);
+        std::sort(symbols.begin(), symbols.end());
+        symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+        premise_symbols.insert(premise_symbols.end(), symbols.begin(), symbols.end());
+        premise_offsets.push_back((std::uint32_t)premise_symbols.size());
+    }
+
+    // how many premises each symbol occurs in
+    std::vector<std::uint32_t> occurrences(symbol_ids.size(), 0);
+    for (std::uint32_t s : premise_symbols)
+        ++occurrences[s];
+
+    // the triggers of each premise, counted first so the CSR arrays are filled in one go
+    auto for_each_trigger = [&](size_t premise, auto &&emit) {
+        std::uint32_t first = premise_offsets[premise], last = premise_offsets[premise + 1];
+        std::uint32_t rarest = UINT32_MAX;
+        for (std::uint32_t i = first; i < last; ++i)
+            rarest = std::min(rarest, occurrences[premise_symbols[i]]);
+        for (std::uint32_t i = first; i < last; ++i)
+            if (occurrences[premise_symbols[i]] <= tolerance * rarest)
+                emit(premise_symbols[i]);
+    };
+
+    trigger_offsets.assign(symbol_ids.size() + 1, 0);
+    for (size_t p = 0; p < premises.size(); ++p)
+        for_each_trigger(p, [&](std::uint32_t s) { ++trigger_offsets[s + 1]; });
+    for (size_t s = 0; s < symbol_ids.size(); ++s)
+        trigger_offsets[s + 1] += trigger_offsets[s];
+
+    triggered_premises.resize(trigger_offsets.back());
+    std::vector<std::uint32_t> fill(trigger_offsets.begin(), trigger_offsets.end() - 1);
+    for (size_t p = 0; p < premises.size(); ++p)
+        for_each_trigger(p, [&](std::uint32_t s) { triggered_premises[fill[s]++] = (std::uint32_t)p; });
+}
+
+std::vector<size_t> PremiseIndex::select(const std::vector<FormulaPtr> &goals, size_t max_hops) const {
+    // a selection usually reaches few of the symbols and premises, so what it reached is kept sparse rather than in
+    // arrays the size of the index
+    std::unordered_set<std::uint32_t> reached_symbols;
+    std::unordered_set<std::uint32_t> selected;
+
+    // symbols no premise mentions can't trigger anything
+    std::vector<std::uint32_t> frontier;
+    auto seed = [&](const std::string &name) {
+        auto it = symbol_ids.find(name);
+        if (it != symbol_ids.end() && reached_symbols.insert(it->second).second)
+            frontier.push_back(it->second);
+    };
+    for (const FormulaPtr &goal : goals)
+        for_each_symbol(goal, seed);
+
+    std::vector<std::uint32_t> next;
+    for (size_t hop = 0; hop < max_hops && !frontier.empty(); ++hop) {
+        next.clear();
+        for (std::uint32_t s : frontier) {
+            for (std::uint32_t i = trigger_offsets[s]; i < trigger_offsets[s + 1]; ++i) {
+                std::uint32_t p = triggered_premises[i];
+                if (!selected.insert(p).second)
+                    continue;
+                for (std::uint32_t j = premise_offsets[p]; j < premise_offsets[p + 1]; ++j)
+                    if (reached_symbols.insert(premise_symbols[j]).second)
+                        next.push_back(premise_symbols[j]);
+            }
+        }
+        frontier.swap(next);
+    }
+
+    std::vector<size_t> result(selected.begin(), selected.end());
+    std::sort(result.begin(), result.end());
+    return result;
+}
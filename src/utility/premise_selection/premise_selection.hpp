@@ -0,0 +1,39 @@
+#ifndef PREMISE_SELECTION_HPP
+#define PREMISE_SELECTION_HPP
+
+#include "../proof_system/proof_system.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief SInE style relevance filter over a fixed list of premises
+ *
+ * the symbols of a formula are its relation, function and constant names. a premise is triggered by the symbols in it
+ * that are at most tolerance times as common (counted in premises) as its rarest symbol, so a premise is reached
+ * through what is specific about it rather than through symbols every premise mentions. selection starts from the
+ * symbols of the goals, takes every premise they trigger, adds the symbols of those premises, and so on.
+ */
+class PremiseIndex {
+  public:
+    explicit PremiseIndex(const std::vector<FormulaPtr> &premises, double tolerance = 1.0);
+
+    /// the indices of the premises reached from the goals' symbols in at most max_hops steps, in increasing order
+    std::vector<size_t> select(const std::vector<FormulaPtr> &goals, size_t max_hops) const;
+
+    size_t size() const { return premise_offsets.size() - 1; }
+
+  private:
+    std::unordered_map<std::string, std::uint32_t> symbol_ids;
+
+    // the distinct symbols of premise i are premise_symbols[premise_offsets[i] .. premise_offsets[i + 1])
+    std::vector<std::uint32_t> premise_offsets{0};
+    std::vector<std::uint32_t> premise_symbols;
+
+    // the premises triggered by symbol s are triggered_premises[trigger_offsets[s] .. trigger_offsets[s + 1])
+    std::vector<std::uint32_t> trigger_offsets;
+    std::vector<std::uint32_t> triggered_premises;
+};
+
+#endif // PREMISE_SELECTION_HPP
@@ -1,30 +1,107 @@
 #include "proof.hpp"
+#include "../bdd/bdd.hpp"
+#include "../flat_formula_conversion/flat_formula_conversion.hpp"
+#include "../induction/induction.hpp"
+#include "../lemma_store/lemma_store.hpp"
+#include "../premise_selection/premise_selection.hpp"
+#include <algorithm>
 #include <iostream>
-#include <sstream>
+#include <set>
 
-Proof::Proof(std::vector<FormulaPtr> assumptions, FormulaPtr target) : assumptions(std::move(assumptions)) {
+Proof::Proof(std::vector<FormulaPtr> assumptions, FormulaPtr target, const RuleRegistry &registry)
+    : assumptions(std::move(assumptions)), registry(&registry), original_target(target) {
+    target_tree.push_back({target});
+    target_nodes.push_back(0);
     targets.push_back(std::move(target));
+    target_contexts.push_back(nullptr);
 
-    register_rule("ASSUMPTION", [this](const std::vector<FormulaPtr> &, FormulaPtr claimed) {
-        for (auto &a : this->assumptions) {
-            if (a->to_string() == claimed->to_string()) {
-                return claimed;
-            }
-        }
-        throw std::invalid_argument("Invalid assumption: " + claimed->to_string());
-    });
+    assumptions_fingerprint = fingerprint_assumptions(this->assumptions);
+    for (size_t i = 0; i < this->assumptions.size(); ++i)
+        assumption_index.emplace(hash_formula(this->assumptions[i]), i);
+    premise_index = std::make_shared<const PremiseIndex>(this->assumptions);
+}
+
+// ---------- Line storage ----------
+
+bool in_scope(const AssumptionContext &frame, const AssumptionContext &context) {
+    if (!frame)
+        return true;
+    // frames above context's are never on its chain
+    for (const AssumptionFrame *f = context.get(); f && f->depth >= frame->depth; f = f->parent.get())
+        if (f == frame.get())
+            return true;
+    return false;
+}
+
+void ProofLineTable::push_back(FormulaPtr statement, RuleId rule, std::span<const int> dependencies,
+                               AssumptionContext context) {
+    statements.push_back(std::move(statement));
+    rules.push_back(rule);
+    contexts.push_back(std::move(context));
+    dependency_indices.insert(dependency_indices.end(), dependencies.begin(), dependencies.end());
+    dependency_offsets.push_back((std::uint32_t)dependency_indices.size());
+}
+
+void ProofLineTable::reserve(size_t num_lines, size_t num_dependencies) {
+    statements.reserve(num_lines);
+    rules.reserve(num_lines);
+    contexts.reserve(num_lines);
+    dependency_offsets.reserve(num_lines + 1);
+    dependency_indices.reserve(num_dependencies);
+}
+
+void ProofLineTable::truncate(size_t num_lines) {
+    if (num_lines >= size())
+        return;
+    statements.resize(num_lines);
+    rules.resize(num_lines);
+    contexts.resize(num_lines);
+    dependency_indices.resize(dependency_offsets[num_lines]);
+    dependency_offsets.resize(num_lines + 1);
+}
+
+void ProofLineTable::clear() {
+    statements.clear();
+    rules.clear();
+    contexts.clear();
+    dependency_offsets.assign(1, 0);
+    dependency_indices.clear();
+}
+
+// ---------- Proof ----------
 
-    register_rule("IMPLIES", implies_rule);
-    register_rule("FORALL", forall_rule);
-    register_rule("EQ", eq_rule);
-    register_rule("AND", and_rule);
+std::optional<RuleId> Proof::find_rule(const std::string &name) const {
+    for (size_t i = 0; i < custom_rules.size(); ++i)
+        if (custom_rules[i].first == name)
+            return (RuleId)(registry->size() + i);
+    return registry->find(name);
 }
 
-void Proof::register_rule(const std::string &name, LineRule rule) { rules[name] = rule; }
+const std::string &Proof::rule_name(RuleId id) const {
+    return id < registry->size() ? registry->name(id) : custom_rules[id - registry->size()].first;
+}
+
+void Proof::register_rule(const std::string &name, LineRule rule) {
+    // a rule shadowing ASSUMPTION, LEMMA or AND would be exported under the built-in's name and checked as it
+    if (find_rule(name))
+        throw std::invalid_argument("Rule " + name + " is already registered");
+    custom_rules.emplace_back(name, std::move(rule));
+}
+
+void Proof::use_lemma_store(LemmaStore &store) { lemma_store = &store; }
+
+// a step for lines already in the proof, they are only copied out by Proof::record
+static ProofStep lines_step(size_t first_line, size_t num_lines) {
+    ProofStep step{ProofStep::Kind::lines};
+    step.first_line = (std::uint32_t)first_line;
+    step.num_lines = (std::uint32_t)num_lines;
+    return step;
+}
 
 void Proof::add_line_to_proof(FormulaPtr claimed, const std::string &rule_name, const std::vector<int> &deps) {
     // Check the rule exists
-    if (!rules.count(rule_name)) {
+    std::optional<RuleId> found_rule = find_rule(rule_name);
+    if (!found_rule) {
         throw std::invalid_argument("Unknown rule: " + rule_name);
     }
 
@@ -34,36 +111,212 @@ void Proof::add_line_to_proof(FormulaPtr claimed, const std::string &rule_name,
         if (idx < 0 || idx >= (int)lines.size()) {
             throw std::invalid_argument("Invalid dependency index");
         }
-        dep_statements.push_back(lines[idx].statement);
+        dep_statements.push_back(lines.statement(idx));
     }
 
+    check_dependency_scope(deps, lines.size());
+    check_line(*found_rule, dep_statements, claimed);
+
+    // Add the line to the proof
+    lines.push_back(claimed, *found_rule, deps, line_context(*found_rule, deps, claimed));
+    steps.push_back(lines_step(lines.size() - 1, 1));
+
+    close_targets(lines.size() - 1);
+}
+
+void Proof::add_lines(std::span<const LineSpec> specs) {
+    // nothing to check or close, and a replay has nothing to repeat
+    if (specs.empty())
+        return;
+    const size_t first_line = lines.size();
+
+    // rules are looked up once per distinct name, and every dependency is checked before any line is
+    size_t num_dependencies = 0;
+    std::vector<RuleId> rule_ids;
+    rule_ids.reserve(specs.size());
+    std::unordered_map<std::string_view, RuleId> resolved;
+    for (size_t i = 0; i < specs.size(); ++i) {
+        auto [it, inserted] = resolved.try_emplace(specs[i].rule);
+        if (inserted) {
+            std::optional<RuleId> found_rule = find_rule(specs[i].rule);
+            if (!found_rule)
+                throw std::invalid_argument("Unknown rule: " + specs[i].rule);
+            it->second = *found_rule;
+        }
+        rule_ids.push_back(it->second);
+
+        for (int idx : specs[i].dependencies) {
+            // a line may depend on the lines before it in the same batch
+            if (idx < 0 || idx >= (int)(first_line + i))
+                throw std::invalid_argument("Invalid dependency index " + std::to_string(idx) + " on line " +
+                                            std::to_string(first_line + i));
+        }
+        num_dependencies += specs[i].dependencies.size();
+    }
+
+    lines.reserve(first_line + specs.size(), lines.num_dependencies() + num_dependencies);
+
+    // lines are added as they are checked, since later lines in the batch depend on them, and all of them are
+    // removed again if any one fails
+    std::vector<FormulaPtr> dep_statements;
+    try {
+        for (size_t i = 0; i < specs.size(); ++i) {
+            dep_statements.clear();
+            for (int idx : specs[i].dependencies)
+                dep_statements.push_back(lines.statement(idx));
+            check_dependency_scope(specs[i].dependencies, first_line + i);
+            check_line(rule_ids[i], dep_statements, specs[i].statement);
+            lines.push_back(specs[i].statement, rule_ids[i], specs[i].dependencies,
+                            line_context(rule_ids[i], specs[i].dependencies, specs[i].statement));
+        }
+    } catch (...) {
+        lines.truncate(first_line);
+        throw;
+    }
+    steps.push_back(lines_step(first_line, specs.size()));
+
+    close_targets(first_line);
+}
+
+void Proof::check_line(RuleId rule_id, const std::vector<FormulaPtr> &dep_statements,
+                       const FormulaPtr &claimed) const {
     // Apply the rule to derive the formula
-    FormulaPtr derived = rules[rule_name](dep_statements, claimed);
+    FormulaPtr derived;
+    if (rule_id == assumption_rule_id) {
+        if (!is_assumption(claimed))
+            throw std::invalid_argument("Invalid assumption: " + claimed->to_string());
+        derived = claimed;
+    } else if (rule_id == lemma_rule_id) {
+        if (!dep_statements.empty())
+            throw std::invalid_argument("LEMMA takes no inputs");
+        if (!lemma_store)
+            throw std::invalid_argument("LEMMA needs a lemma store, see use_lemma_store");
+        auto is_available = [this](const FormulaPtr &f) { return is_assumption(f); };
+        if (!lemma_store->proves(assumptions_fingerprint, is_available, claimed))
+            throw std::invalid_argument("No lemma proves " + claimed->to_string() + " from these assumptions");
+        derived = claimed;
+    } else if (rule_id < registry->size()) {
+        derived = registry->rule(rule_id)(dep_statements, claimed);
+    } else {
+        derived = custom_rules[rule_id - registry->size()].second(dep_statements, claimed);
+    }
 
     // Check claimed formula matches derived
-    if (derived->to_string() != claimed->to_string()) {
+    if (!alpha_equivalent(derived, claimed)) {
         throw std::invalid_argument("Claimed statement " + claimed->to_string() + " does not match derived " +
                                     derived->to_string());
     }
+}
 
-    // Add the line to the proof
-    lines.push_back({claimed, rule_name, deps});
+void Proof::check_dependency_scope(std::span<const int> deps, size_t line) const {
+    AssumptionContext context = active_context();
+    for (int idx : deps)
+        if (!in_scope(lines.context(idx), context))
+            throw std::invalid_argument("Line " + std::to_string(line) + " depends on line " + std::to_string(idx) +
+                                        ", which rests on a hypothesis the active target doesn't have");
+}
 
-    // --- Check if this line completes any targets ---
-    for (size_t i = 0; i < targets.size(); ++i) {
-        if (targets[i]->to_string() == claimed->to_string()) {
-            // Remove the completed target
-            targets.erase(targets.begin() + i);
+AssumptionContext Proof::line_context(RuleId rule_id, std::span<const int> deps, const FormulaPtr &claimed) const {
+    if (rule_id == assumption_rule_id) {
+        AssumptionContext scope;
+        find_assumption(claimed, active_context(), scope);
+        return scope;
+    }
+    // a lemma is cited on the strength of everything the active target has
+    if (rule_id == lemma_rule_id)
+        return active_context();
 
-            // Adjust active_goal if necessary
-            if (active_target_idx >= i && active_target_idx > 0) {
-                --active_target_idx;
-            }
+    // the dependencies are all on the active target's chain, so the deepest of them has the others above it
+    AssumptionContext deepest;
+    for (int idx : deps) {
+        const AssumptionContext &context = lines.context(idx);
+        if (context && (!deepest || context->depth > deepest->depth))
+            deepest = context;
+    }
+    return deepest;
+}
+
+void Proof::close_targets(size_t first_line) {
+    index_lines(first_line);
+
+    // target hashes are compared before anything else, and kept parallel to targets as they are removed
+    std::vector<std::uint64_t> target_hashes;
+    target_hashes.reserve(targets.size());
+    for (const FormulaPtr &target : targets)
+        target_hashes.push_back(hash_formula(target));
+
+    for (size_t line = first_line; line < lines.size() && !targets.empty(); ++line) {
+        const FormulaPtr &claimed = lines.statement(line);
+        std::uint64_t h = hash_formula(claimed);
+        for (size_t i = 0; i < targets.size(); ++i) {
+            if (target_hashes[i] != h || !in_scope(lines.context(line), target_contexts[i]) ||
+                !alpha_equivalent(targets[i], claimed))
+                continue;
+            target_hashes.erase(target_hashes.begin() + i);
+            close_target(i, (int)line);
             break; // Assuming one target per line
         }
     }
 }
 
+void Proof::close_target(size_t target_idx, int line) {
+    TargetNode &node = target_tree[target_nodes[target_idx]];
+    node.step = TargetStep::closed;
+    node.line = line;
+
+    // Remove the completed target
+    targets.erase(targets.begin() + target_idx);
+    target_contexts.erase(target_contexts.begin() + target_idx);
+    target_nodes.erase(target_nodes.begin() + target_idx);
+
+    // Adjust active_goal if necessary
+    if (active_target_idx >= target_idx && active_target_idx > 0) {
+        --active_target_idx;
+    }
+    // Remember the result for other proofs
+    if (targets.empty() && lemma_store) {
+        lemma_store->add_lemma(assumptions, original_target, copy_lines());
+    }
+}
+
+void Proof::close_if_known(size_t target_idx) {
+    const FormulaPtr target = targets[target_idx];
+    const AssumptionContext context = target_contexts[target_idx];
+    std::uint64_t h = hash_formula(target);
+
+    // only lines resting on hypotheses this target has
+    auto [begin, end] = line_index.equal_range(h);
+    for (auto it = begin; it != end; ++it) {
+        if (in_scope(lines.context(it->second), context) && alpha_equivalent(lines.statement(it->second), target)) {
+            close_target(target_idx, (int)it->second);
+            return;
+        }
+    }
+
+    // an assumption that was never written down as a line gets one, in the scope of the hypothesis it is
+    AssumptionContext scope;
+    if (find_assumption(target, context, scope)) {
+        lines.push_back(target, assumption_rule_id, {}, std::move(scope));
+        index_lines(lines.size() - 1);
+        close_target(target_idx, (int)lines.size() - 1);
+    }
+}
+
+FormulaPtr Proof::cited_assumption(const FormulaPtr &f, const AssumptionContext &scope) const {
+    if (scope)
+        return scope->hypothesis;
+    auto [begin, end] = assumption_index.equal_range(hash_formula(f));
+    for (auto it = begin; it != end; ++it)
+        if (alpha_equivalent(assumptions[it->second], f))
+            return assumptions[it->second];
+    return f;
+}
+
+void Proof::index_lines(size_t first_line) {
+    for (size_t i = first_line; i < lines.size(); ++i)
+        line_index.emplace(hash_formula(lines.statement(i)), i);
+}
+
 void Proof::instantiate_forall(std::optional<TermPtr> requested_variable) {
     // Ensure there is an active goal
     if (targets.empty())
@@ -75,24 +328,33 @@ void Proof::instantiate_forall(std::optional<TermPtr> requested_variable) {
         throw std::invalid_argument("instantiate_forall: active goal is not a forall formula");
     }
 
-    // Determine which variable to instantiate
-    TermPtr arbitrary_variable =
-        requested_variable.has_value() ? requested_variable.value() : Term::make_variable(forall_ptr->v);
+    // Determine which variable to instantiate, it stands for any element of the domain so nothing can be assumed
+    // about it already
+    TermPtr arbitrary_variable;
+    if (requested_variable.has_value()) {
+        auto variable = std::get_if<VariableTerm>(&requested_variable.value()->data);
+        if (!variable || !is_fresh(variable->var, current_goal))
+            throw std::invalid_argument("instantiate_forall: " + requested_variable.value()->to_string() +
+                                        " is not a variable that is free nowhere else");
+        arbitrary_variable = requested_variable.value();
+    } else {
+        std::string name = forall_ptr->v;
+        while (!is_fresh(name, current_goal))
+            name += "'";
+        arbitrary_variable = Term::make_variable(name);
+    }
 
-    // Add assumption that variable belongs to ℕ
-    TermPtr N = Term::make_constant("ℕ");
-    FormulaPtr membership_assumption = Formula::make_rel("∈", {arbitrary_variable, N});
-    assumptions.push_back(membership_assumption);
+    // Add assumption that variable belongs to the domain
+    FormulaPtr membership_assumption = Formula::make_rel("∈", {arbitrary_variable, forall_ptr->domain});
+    push_hypothesis(membership_assumption);
 
     // Substitute var → chosen variable in the forall body
     TermPtr bound_var = Term::make_variable(forall_ptr->v);
     FormulaPtr new_goal = substitute_in_formula(forall_ptr->inner, bound_var, arbitrary_variable);
 
-    // Push old targets to history
-    target_history.push_back(targets);
-
-    // Update active goal with instantiated formula
-    targets[active_target_idx] = new_goal;
+    steps.push_back({ProofStep::Kind::instantiate_forall, {}, requested_variable.value_or(nullptr), -1, nullptr,
+                     membership_assumption, {new_goal}});
+    replace_active_target({&new_goal, 1}, TargetStep::forall);
 }
 
 void Proof::instantiate_implication() {
@@ -107,57 +369,47 @@ void Proof::instantiate_implication() {
     }
 
     // Add the antecedent A to assumptions
-    assumptions.push_back(impl_ptr->l);
-
-    // Save old targets to history for backtracking
-    target_history.push_back(targets);
+    push_hypothesis(impl_ptr->l);
 
     // Update active goal to the consequent B
-    targets[active_target_idx] = impl_ptr->r;
-}
-
-void Proof::instantiate_induction() {
-    // Grab the current active goal
-    FormulaPtr current_goal = get_active_target();
-    auto forall = std::get_if<ForallFormula>(&current_goal->data);
-    if (!forall) {
-        throw std::invalid_argument("instantiate_induction: active goal is not a forall formula");
-    }
-
-    std::string var = forall->v;
-    FormulaPtr Pn = forall->inner;
-
-    // -----------------------------
-    // Base case: P(0)
-    // -----------------------------
-    TermPtr zero_term = Term::make_constant("0");
-    TermPtr var_term = Term::make_variable(var);
-    FormulaPtr P0 = substitute_in_formula(Pn, var_term, zero_term);
-
-    // -----------------------------
-    // Step case: ∀k (P(k) → P(k+1))
-    // -----------------------------
-    TermPtr k_term = Term::make_variable("k");
-    TermPtr succ_term = Term::make_function("+", {k_term, Term::make_constant("1")});
-    FormulaPtr Pk = substitute_in_formula(Pn, var_term, k_term);
-    FormulaPtr Psucc = substitute_in_formula(Pn, var_term, succ_term);
-    FormulaPtr step_impl = Formula::make_implies(Pk, Psucc);
-
-    TermPtr natural_numbers = Term::make_constant("ℕ");
-    FormulaPtr step_forall = Formula::make_forall("k", natural_numbers, step_impl);
-
-    // -----------------------------
-    // Update goal history and replace active goal
-    // -----------------------------
-    target_history.push_back(targets);
+    steps.push_back({ProofStep::Kind::instantiate_implication, {}, nullptr, -1, nullptr, impl_ptr->l, {impl_ptr->r}});
+    replace_active_target({&impl_ptr->r, 1}, TargetStep::implication);
+}
 
-    // Replace current active goal with base case
-    targets[active_target_idx] = P0;
+void Proof::instantiate_induction() { instantiate_induction(natural_induction()); }
 
-    // Add the step case as a new goal
-    targets.push_back(step_forall);
+void Proof::instantiate_induction(InductionSchemas &schemas) {
+    std::shared_ptr<const std::vector<FormulaPtr>> cases = schemas.cases(get_active_target());
 
-    // Keep focus on base case (active_goal unchanged)
+    // the first case replaces the active goal, which stays in focus, the others are new goals
+    steps.push_back({ProofStep::Kind::instantiate_induction, {}, nullptr, -1, &schemas, nullptr, *cases});
+    replace_active_target(*cases, TargetStep::induction, -1, &schemas);
+}
+
+void Proof::replace_active_target(std::span<const FormulaPtr> new_targets, TargetStep step, int line,
+                                  const InductionSchemas *schemas) {
+    target_history.push_back(targets);
+
+    std::uint32_t parent = target_nodes[active_target_idx];
+    target_tree[parent].step = step;
+    target_tree[parent].line = line;
+    target_tree[parent].schemas = schemas;
+
+    size_t first_new_target = targets.size();
+    targets[active_target_idx] = new_targets[0];
+    target_nodes[active_target_idx] = (std::uint32_t)target_tree.size();
+    target_tree.push_back({new_targets[0], parent});
+    for (size_t i = 1; i < new_targets.size(); ++i) {
+        targets.push_back(new_targets[i]);
+        target_contexts.push_back(target_contexts[active_target_idx]);
+        target_nodes.push_back((std::uint32_t)target_tree.size());
+        target_tree.push_back({new_targets[i], parent});
+    }
+
+    // from the back, so closing a target doesn't move the ones still to be checked
+    for (size_t i = targets.size(); i-- > first_new_target;)
+        close_if_known(i);
+    close_if_known(active_target_idx);
 }
 
 void Proof::rewrite_target_using_equality(int equality_proof_line) {
@@ -169,10 +421,11 @@ void Proof::rewrite_target_using_equality(int equality_proof_line) {
         throw std::invalid_argument("Invalid equality line index");
 
     // Get the equality formula from the proof line
-    FormulaPtr equality_formula = lines[equality_proof_line].statement;
+    FormulaPtr equality_formula = lines.statement(equality_proof_line);
     auto eq_ptr = std::get_if<EqualityFormula>(&equality_formula->data);
     if (!eq_ptr)
         throw std::invalid_argument("Selected line is not an equality");
+    check_dependency_scope({&equality_proof_line, 1}, lines.size());
 
     TermPtr lhs = eq_ptr->l;
     TermPtr rhs = eq_ptr->r;
@@ -185,11 +438,73 @@ void Proof::rewrite_target_using_equality(int equality_proof_line) {
     // Perform substitution: replace term_to_substitute with rhs
     FormulaPtr new_goal = substitute_term_in_formula(current_goal, term_to_substitute, rhs);
 
-    // Save old targets to history for backtracking
-    target_history.push_back(targets);
-
     // Update active goal with rewritten formula
-    targets[active_target_idx] = new_goal;
+    steps.push_back({ProofStep::Kind::rewrite_target, {}, nullptr, equality_proof_line, nullptr, nullptr, {new_goal}});
+    replace_active_target({&new_goal, 1}, TargetStep::rewrite, equality_proof_line);
+}
+
+ProofLineView Proof::line(size_t i) const {
+    return {lines.statement(i), rule_name(lines.rule(i)), lines.dependencies(i)};
+}
+
+std::vector<ProofLine> Proof::copy_lines() const {
+    std::vector<ProofLine> copy;
+    copy.reserve(lines.size());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        auto deps = lines.dependencies(i);
+        copy.push_back({lines.statement(i), rule_name(lines.rule(i)), std::vector<int>(deps.begin(), deps.end())});
+    }
+    return copy;
+}
+
+AssumptionContext Proof::active_context() const {
+    return active_target_idx < target_contexts.size() ? target_contexts[active_target_idx] : nullptr;
+}
+
+void Proof::push_hypothesis(FormulaPtr hypothesis) {
+    std::uint64_t h = hash_formula(hypothesis);
+    std::uint32_t node = target_nodes[active_target_idx];
+    target_tree[node].hypothesis = hypothesis;
+    AssumptionContext &context = target_contexts[active_target_idx];
+    std::uint32_t depth = context ? context->depth + 1 : 1;
+    context = std::make_shared<const AssumptionFrame>(AssumptionFrame{std::move(hypothesis), h, context, depth, node});
+}
+
+bool Proof::is_fresh(const std::string &v, const FormulaPtr &goal) const {
+    if (is_free_in(v, goal))
+        return false;
+    for (const FormulaPtr &a : assumptions)
+        if (is_free_in(v, a))
+            return false;
+    for (auto frame = active_context(); frame; frame = frame->parent)
+        if (is_free_in(v, frame->hypothesis))
+            return false;
+    return true;
+}
+
+bool Proof::is_assumption(FormulaPtr f) const { return is_assumption(f, active_context()); }
+
+bool Proof::is_assumption(FormulaPtr f, const AssumptionContext &context) const {
+    AssumptionContext scope;
+    return find_assumption(f, context, scope);
+}
+
+bool Proof::find_assumption(FormulaPtr f, const AssumptionContext &context, AssumptionContext &scope) const {
+    scope = nullptr;
+    std::uint64_t h = hash_formula(f);
+    auto [begin, end] = assumption_index.equal_range(h);
+    for (auto it = begin; it != end; ++it)
+        if (alpha_equivalent(assumptions[it->second], f))
+            return true;
+
+    // only the hypotheses of the target being worked on are in scope
+    for (auto frame = context; frame; frame = frame->parent) {
+        if (frame->hash == h && alpha_equivalent(frame->hypothesis, f)) {
+            scope = frame;
+            return true;
+        }
+    }
+    return false;
 }
 
 FormulaPtr Proof::get_active_target() const {
@@ -199,6 +514,30 @@ FormulaPtr Proof::get_active_target() const {
     return targets[active_target_idx];
 }
 
+std::vector<FormulaPtr> Proof::get_active_assumptions() const {
+    std::vector<FormulaPtr> hypotheses;
+    for (auto frame = active_context(); frame; frame = frame->parent)
+        hypotheses.push_back(frame->hypothesis);
+    std::vector<FormulaPtr> active = assumptions;
+    active.insert(active.end(), hypotheses.rbegin(), hypotheses.rend());
+    return active;
+}
+
+std::vector<FormulaPtr> Proof::get_relevant_assumptions(size_t max_hops) const {
+    std::vector<FormulaPtr> hypotheses;
+    for (auto frame = active_context(); frame; frame = frame->parent)
+        hypotheses.push_back(frame->hypothesis);
+
+    std::vector<FormulaPtr> goals(hypotheses.begin(), hypotheses.end());
+    goals.push_back(get_active_target());
+
+    std::vector<FormulaPtr> relevant;
+    for (size_t i : premise_index->select(goals, max_hops))
+        relevant.push_back(assumptions[i]);
+    relevant.insert(relevant.end(), hypotheses.rbegin(), hypotheses.rend());
+    return relevant;
+}
+
 bool Proof::is_valid() const {
     // A proof is valid if all targets have been completed
     return targets.empty();
@@ -212,11 +551,16 @@ void Proof::print() const {
     for (size_t i = 0; i < assumptions.size(); ++i) {
         std::cout << "  [" << i << "] " << assumptions[i]->to_string() << "\n";
     }
+    // followed by the hypotheses of the active target, oldest first
+    std::vector<FormulaPtr> active = get_active_assumptions();
+    for (size_t i = assumptions.size(); i < active.size(); ++i) {
+        std::cout << "  [" << i << "] " << active[i]->to_string() << "\n";
+    }
 
     // Proof lines
     std::cout << "Proof Lines:\n";
     for (size_t i = 0; i < lines.size(); ++i) {
-        const auto &line = lines[i];
+        ProofLineView line = this->line(i);
         std::cout << "  (" << i << ") " << line.statement->to_string() << "    [" << line.justification;
         if (!line.dependencies.empty()) {
             std::cout << " deps:";
@@ -243,6 +587,285 @@ void Proof::print() const {
     std::cout << "=======================\n";
 }
 
+void Proof::compact() {
+    if (!is_valid())
+        throw std::logic_error("compact: the proof still has open targets");
+
+    const int n = (int)lines.size();
+
+    // every line is mapped onto the first line with the same statement whose hypotheses it has too, which always comes
+    // before it, so dependencies still point backwards after merging
+    std::vector<int> canonical(n);
+    std::unordered_multimap<std::uint64_t, int> first_line_by_hash;
+    for (int i = 0; i < n; ++i) {
+        canonical[i] = i;
+        std::uint64_t h = hash_formula(lines.statement(i));
+        auto [begin, end] = first_line_by_hash.equal_range(h);
+        for (auto it = begin; it != end; ++it) {
+            if (in_scope(lines.context(it->second), lines.context(i)) &&
+                formulas_equal(lines.statement(it->second), lines.statement(i))) {
+                canonical[i] = it->second;
+                break;
+            }
+        }
+        if (canonical[i] == i)
+            first_line_by_hash.emplace(h, i);
+    }
+
+    // walk the dependency DAG backwards from what the targets rest on
+    std::vector<bool> reachable(n, false);
+    std::vector<int> stack;
+    for (const TargetNode &node : target_tree)
+        if (node.line >= 0)
+            stack.push_back(canonical[node.line]);
+    while (!stack.empty()) {
+        int i = stack.back();
+        stack.pop_back();
+        if (reachable[i])
+            continue;
+        reachable[i] = true;
+        for (int d : lines.dependencies(i))
+            stack.push_back(canonical[d]);
+    }
+
+    // dependencies always point backwards, so they are renumbered by the time a line refers to them
+    std::vector<int> new_index(n, -1);
+    ProofLineTable compacted;
+    std::vector<int> deps;
+    for (int i = 0; i < n; ++i) {
+        if (!reachable[i])
+            continue;
+        new_index[i] = (int)compacted.size();
+        deps.clear();
+        for (int d : lines.dependencies(i))
+            deps.push_back(new_index[canonical[d]]);
+        compacted.push_back(lines.statement(i), lines.rule(i), deps, lines.context(i));
+    }
+
+    for (TargetNode &node : target_tree)
+        if (node.line >= 0)
+            node.line = new_index[canonical[node.line]];
+
+    // the lines of the steps so far are about to be renumbered or dropped
+    for (ProofStep &step : steps)
+        copy_step_lines(step);
+
+    lines = std::move(compacted);
+    line_index.clear();
+    index_lines(0);
+    steps.push_back({ProofStep::Kind::compact});
+}
+
+// ---------- Recording & replay ----------
+
+static std::uint64_t hash_name(const std::string &name) {
+    std::uint64_t h = name.size();
+    for (unsigned char c : name)
+        h = hash_combine(h, c);
+    return h;
+}
+
+std::uint64_t hash_proof_record(const ProofRecord &record) {
+    std::uint64_t h = hash_combine(record.assumptions.size(), hash_formula(record.target));
+    for (const FormulaPtr &a : record.assumptions)
+        h = hash_combine(h, hash_formula(a));
+
+    for (const ProofStep &step : record.steps) {
+        h = hash_combine(h, (std::uint64_t)step.kind);
+        for (const LineSpec &line : step.lines) {
+            h = hash_combine(hash_combine(h, hash_formula(line.statement)), hash_name(line.rule));
+            for (int d : line.dependencies)
+                h = hash_combine(h, (std::uint64_t)d);
+            h = hash_combine(h, line.dependencies.size());
+        }
+        h = hash_combine(h, step.lines.size());
+        h = hash_combine(h, step.variable ? hash_term(step.variable) : 0);
+        h = hash_combine(h, (std::uint64_t)(std::int64_t)step.equality_line);
+        h = hash_combine(h, step.schemas ? step.schemas->id() : 0);
+        h = hash_combine(h, hash_formula(step.hypothesis));
+        for (const FormulaPtr &target : step.targets)
+            h = hash_combine(h, hash_formula(target));
+        h = hash_combine(h, step.targets.size());
+    }
+    return h;
+}
+
+void Proof::copy_step_lines(ProofStep &step) const {
+    step.lines.reserve(step.num_lines);
+    for (size_t i = step.first_line; i < (size_t)step.first_line + step.num_lines; ++i) {
+        auto deps = lines.dependencies(i);
+        step.lines.push_back(
+            {lines.statement(i), rule_name(lines.rule(i)), std::vector<int>(deps.begin(), deps.end())});
+    }
+    step.num_lines = 0;
+}
+
+ProofRecord Proof::record() const {
+    ProofRecord record{assumptions, original_target, steps};
+    for (ProofStep &step : record.steps)
+        copy_step_lines(step);
+    record.content_hash = hash_proof_record(record);
+    return record;
+}
+
+void Proof::replay(const ProofRecord &record, ReplayMode mode) {
+    if (!steps.empty() || !lines.empty())
+        throw std::logic_error("replay: the proof already has steps");
+    bool same_start = record.assumptions.size() == assumptions.size() &&
+                      alpha_equivalent(record.target, original_target) &&
+                      std::equal(assumptions.begin(), assumptions.end(), record.assumptions.begin(),
+                                 [](const FormulaPtr &a, const FormulaPtr &b) { return alpha_equivalent(a, b); });
+    if (!same_start)
+        throw std::invalid_argument("replay: the record starts from different assumptions or a different target");
+    if (mode == ReplayMode::trusted && hash_proof_record(record) != record.content_hash)
+        throw std::invalid_argument("replay: the record doesn't match its content hash, it can only be verified");
+
+    for (const ProofStep &step : record.steps) {
+        if (mode == ReplayMode::trusted) {
+            replay_trusted(step);
+            continue;
+        }
+        // the same calls as the original proof made, so every check runs again and the step is recorded again
+        switch (step.kind) {
+        case ProofStep::Kind::lines:
+            add_lines(step.lines);
+            break;
+        case ProofStep::Kind::instantiate_forall:
+            instantiate_forall(step.variable ? std::optional<TermPtr>(step.variable) : std::nullopt);
+            break;
+        case ProofStep::Kind::instantiate_implication:
+            instantiate_implication();
+            break;
+        case ProofStep::Kind::instantiate_induction:
+            if (!step.schemas)
+                throw std::invalid_argument("replay: induction step without its schemas");
+            instantiate_induction(*step.schemas);
+            break;
+        case ProofStep::Kind::rewrite_target:
+            rewrite_target_using_equality(step.equality_line);
+            break;
+        case ProofStep::Kind::compact:
+            compact();
+            break;
+        }
+    }
+}
+
+void Proof::replay_trusted(const ProofStep &step) {
+    trusted_replay = true;
+    // the only checks kept, so that a bad record can't index past the targets or the lines
+    bool changes_target = step.kind != ProofStep::Kind::lines && step.kind != ProofStep::Kind::compact;
+    if (changes_target && (targets.empty() || step.targets.empty()))
+        throw std::invalid_argument("replay: the record replaces a target that isn't there");
+    if (step.kind == ProofStep::Kind::rewrite_target &&
+        (step.equality_line < 0 || step.equality_line >= (int)lines.size()))
+        throw std::invalid_argument("replay: the record rewrites with a line that isn't there");
+
+    switch (step.kind) {
+    case ProofStep::Kind::lines: {
+        // rules are only looked up, so the line ids mean the same as they did, and never run
+        size_t first_line = lines.size();
+        try {
+            for (const LineSpec &spec : step.lines) {
+                std::optional<RuleId> rule = find_rule(spec.rule);
+                if (!rule)
+                    throw std::invalid_argument("Unknown rule: " + spec.rule);
+                for (int idx : spec.dependencies)
+                    if (idx < 0 || idx >= (int)lines.size())
+                        throw std::invalid_argument("replay: line " + std::to_string(lines.size()) +
+                                                    " depends on line " + std::to_string(idx) + ", which isn't there");
+                lines.push_back(spec.statement, *rule, spec.dependencies,
+                                line_context(*rule, spec.dependencies, spec.statement));
+            }
+        } catch (...) {
+            lines.truncate(first_line);
+            throw;
+        }
+        steps.push_back(lines_step(first_line, step.lines.size()));
+        close_targets(first_line);
+        return;
+    }
+    case ProofStep::Kind::compact:
+        compact();
+        return;
+    default:
+        break;
+    }
+
+    static const std::unordered_map<ProofStep::Kind, TargetStep> target_steps = {
+        {ProofStep::Kind::instantiate_forall, TargetStep::forall},
+        {ProofStep::Kind::instantiate_implication, TargetStep::implication},
+        {ProofStep::Kind::instantiate_induction, TargetStep::induction},
+        {ProofStep::Kind::rewrite_target, TargetStep::rewrite},
+    };
+    if (step.hypothesis)
+        push_hypothesis(step.hypothesis);
+    steps.push_back(step);
+    replace_active_target(step.targets, target_steps.at(step.kind), step.equality_line, step.schemas);
+}
+
+// the certificate encoding of each rule name, rules that aren't listed can't be exported
+static const std::unordered_map<std::string, CertificateRule> certificate_rules = {
+    {"ASSUMPTION", CertificateRule::assumption},
+    {"LEMMA", CertificateRule::lemma},
+    {"AND", CertificateRule::and_intro},
+    {"FORALL", CertificateRule::forall_elim},
+    {"IMPLIES", CertificateRule::implies_elim},
+    {"EQ", CertificateRule::eq_refl},
+    {"INDUCTION", CertificateRule::induction},
+    {"LEM", CertificateRule::excluded_middle},
+    {"CASES", CertificateRule::cases},
+    {"EQ_SYM", CertificateRule::eq_sym},
+    {"EQ_TRANS", CertificateRule::eq_trans},
+    {"EQ_CONG", CertificateRule::eq_cong},
+};
+
+Certificate Proof::export_certificate() const {
+    if (!is_valid())
+        throw std::logic_error("export_certificate: the proof still has open targets");
+
+    Certificate certificate;
+    FlatFormulaBuilder builder(certificate.nodes);
+
+    for (auto &a : assumptions)
+        certificate.assumptions.push_back(builder.add_formula(a));
+
+    certificate.goal = builder.add_formula(original_target);
+    certificate.targets.reserve(target_tree.size());
+    for (const TargetNode &node : target_tree) {
+        // the checker knows the cases of induction over ℕ and nothing else
+        if (node.step == TargetStep::induction && node.schemas != &natural_induction())
+            throw std::invalid_argument("export_certificate: only induction over ℕ has a certificate encoding");
+        certificate.targets.push_back({builder.add_formula(node.formula), node.parent, *node.step,
+                                       node.hypothesis ? builder.add_formula(node.hypothesis) : no_node,
+                                       node.line < 0 ? no_line : (std::uint32_t)node.line});
+    }
+
+    certificate.lines.reserve(lines.size());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const std::string &name = rule_name(lines.rule(i));
+        auto rule = certificate_rules.find(name);
+        if (rule == certificate_rules.end())
+            throw std::invalid_argument("export_certificate: rule " + name + " has no certificate encoding");
+
+        // an assumption is written as the formula it cites rather than an alpha variant of it, so that the checker
+        // finds it by node id
+        std::uint32_t statement = builder.add_formula(rule->second == CertificateRule::assumption
+                                                          ? cited_assumption(lines.statement(i), lines.context(i))
+                                                          : lines.statement(i));
+        if (rule->second == CertificateRule::lemma)
+            certificate.lemmas.push_back(statement);
+
+        auto deps = lines.dependencies(i);
+        const AssumptionContext &context = lines.context(i);
+        certificate.lines.push_back({statement, rule->second, (std::uint32_t)certificate.dependencies.size(),
+                                     (std::uint32_t)deps.size(), context ? context->target : no_target});
+        certificate.dependencies.insert(certificate.dependencies.end(), deps.begin(), deps.end());
+    }
+
+    return certificate;
+}
+
 // --- Example rules ---
 FormulaPtr assumption_rule(const std::vector<FormulaPtr> &, FormulaPtr claimed) { return claimed; }
 
@@ -252,7 +875,7 @@ FormulaPtr and_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
 
     auto expected = Formula::make_and(inputs[0], inputs[1]);
 
-    if (expected->to_string() != claimed->to_string())
+    if (!alpha_equivalent(expected, claimed))
         throw std::invalid_argument("Claimed does not match AND result");
 
     return claimed;
@@ -268,14 +891,227 @@ FormulaPtr eq_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
     if (!eq_ptr)
         throw std::invalid_argument("Claimed formula is not an equality");
 
-    // Check that lhs and rhs are equal (using to_string for structural equality)
-    if (eq_ptr->l->to_string() != eq_ptr->r->to_string())
+    // Check that lhs and rhs are equal, terms have no binders so this is plain structural equality
+    if (!terms_equal(eq_ptr->l, eq_ptr->r))
         throw std::invalid_argument("Left and right sides of equality are not equal");
 
     return claimed;
 }
 
-FormulaPtr implication_intro_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr current_target) {
+FormulaPtr eq_sym_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
+    if (inputs.size() != 1)
+        throw std::invalid_argument("EQ_SYM requires 1 input: an equality a = b");
+
+    auto premise = std::get_if<EqualityFormula>(&inputs[0]->data);
+    auto conclusion = std::get_if<EqualityFormula>(&claimed->data);
+    if (!premise || !conclusion)
+        throw std::invalid_argument("EQ_SYM: the input and the claimed formula must be equalities");
+
+    if (!terms_equal(premise->l, conclusion->r) || !terms_equal(premise->r, conclusion->l))
+        throw std::invalid_argument("EQ_SYM: " + claimed->to_string() + " is not " + inputs[0]->to_string() +
+                                    " turned around");
+    return claimed;
+}
+
+FormulaPtr eq_trans_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
+    if (inputs.empty())
+        throw std::invalid_argument("EQ_TRANS requires at least 1 input: a chain a = b, b = c, ...");
+
+    auto conclusion = std::get_if<EqualityFormula>(&claimed->data);
+    if (!conclusion)
+        throw std::invalid_argument("EQ_TRANS: claimed formula is not an equality");
+
+    // each link has to start where the one before it ended
+    TermPtr end = conclusion->l;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        auto link = std::get_if<EqualityFormula>(&inputs[i]->data);
+        if (!link)
+            throw std::invalid_argument("EQ_TRANS: input " + std::to_string(i) + " is not an equality");
+        if (!terms_equal(link->l, end))
+            throw std::invalid_argument("EQ_TRANS: input " + std::to_string(i) + " does not start with " +
+                                        end->to_string());
+        end = link->r;
+    }
+
+    if (!terms_equal(end, conclusion->r))
+        throw std::invalid_argument("EQ_TRANS: the chain ends with " + end->to_string() + " rather than " +
+                                    conclusion->r->to_string());
+    return claimed;
+}
+
+FormulaPtr eq_cong_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
+    auto conclusion = std::get_if<EqualityFormula>(&claimed->data);
+    if (!conclusion)
+        throw std::invalid_argument("EQ_CONG: claimed formula is not an equality");
+
+    auto l = std::get_if<FunctionTerm>(&conclusion->l->data);
+    auto r = std::get_if<FunctionTerm>(&conclusion->r->data);
+    if (!l || !r || l->f != r->f || l->args.size() != r->args.size())
+        throw std::invalid_argument("EQ_CONG: claimed formula must be f(a1, ..., an) = f(b1, ..., bn)");
+
+    // one input ai = bi for every argument that differs, in order
+    size_t next = 0;
+    for (size_t i = 0; i < l->args.size(); ++i) {
+        if (terms_equal(l->args[i], r->args[i]))
+            continue;
+        if (next == inputs.size())
+            throw std::invalid_argument("EQ_CONG: no input for argument " + std::to_string(i));
+        auto premise = std::get_if<EqualityFormula>(&inputs[next]->data);
+        if (!premise || !terms_equal(premise->l, l->args[i]) || !terms_equal(premise->r, r->args[i]))
+            throw std::invalid_argument("EQ_CONG: input " + std::to_string(next) + " should be " +
+                                        Formula::make_eq(l->args[i], r->args[i])->to_string());
+        ++next;
+    }
+
+    if (next != inputs.size())
+        throw std::invalid_argument("EQ_CONG: more inputs than arguments that differ");
+    return claimed;
+}
+
+namespace {
+
+/**
+ * @brief walks a premise and a claim side by side, checking that the claim is the premise with some occurrences of
+ * from replaced by to, without building the substituted formula
+ */
+class SubstitutionMatcher {
+  public:
+    SubstitutionMatcher(TermPtr from, TermPtr to, const std::vector<bool> *mask)
+        : from(std::move(from)), to(std::move(to)), mask(mask) {}
+
+    bool matches(const FormulaPtr &premise, const FormulaPtr &claim) {
+        if (!formulas(premise, claim))
+            return false;
+        // a mask can't ask for occurrences that aren't there
+        if (mask)
+            for (size_t i = occurrence; i < mask->size(); ++i)
+                if ((*mask)[i])
+                    return false;
+        return true;
+    }
+
+  private:
+    TermPtr from, to;
+    const std::vector<bool> *mask;
+    size_t occurrence = 0;
+    std::vector<const std::string *> bound;
+
+    // replacing under a binder must not capture or release a variable of the equality
+    bool can_replace_here() const {
+        if (bound.empty())
+            return true;
+        std::set<std::string> vars;
+        collect_vars_in_term(from, vars);
+        collect_vars_in_term(to, vars);
+        for (const std::string *v : bound)
+            if (vars.count(*v))
+                return false;
+        return true;
+    }
+
+    bool terms(const TermPtr &p, const TermPtr &c) {
+        if (terms_equal(p, from)) {
+            bool replace = mask ? occurrence < mask->size() && (*mask)[occurrence] : !terms_equal(c, p);
+            ++occurrence;
+            return replace ? terms_equal(c, to) && can_replace_here() : terms_equal(c, p);
+        }
+        if (p->data.index() != c->data.index())
+            return false;
+        if (auto f = std::get_if<FunctionTerm>(&p->data)) {
+            auto &g = std::get<FunctionTerm>(c->data);
+            return f->f == g.f && term_lists(f->args, g.args);
+        }
+        if (auto t = std::get_if<TupleTerm>(&p->data))
+            return term_lists(t->args, std::get<TupleTerm>(c->data).args);
+        return terms_equal(p, c);
+    }
+
+    bool term_lists(const std::vector<TermPtr> &p, const std::vector<TermPtr> &c) {
+        if (p.size() != c.size())
+            return false;
+        for (size_t i = 0; i < p.size(); ++i)
+            if (!terms(p[i], c[i]))
+                return false;
+        return true;
+    }
+
+    bool formulas(const FormulaPtr &p, const FormulaPtr &c) {
+        if (p->data.index() != c->data.index())
+            return false;
+        if (auto e = std::get_if<EqualityFormula>(&p->data)) {
+            auto &d = std::get<EqualityFormula>(c->data);
+            return terms(e->l, d.l) && terms(e->r, d.r);
+        }
+        if (auto r = std::get_if<RelationFormula>(&p->data)) {
+            auto &s = std::get<RelationFormula>(c->data);
+            return r->R == s.R && term_lists(r->args, s.args);
+        }
+        if (auto n = std::get_if<NotFormula>(&p->data))
+            return formulas(n->inner, std::get<NotFormula>(c->data).inner);
+        if (auto a = std::get_if<AndFormula>(&p->data)) {
+            auto &b = std::get<AndFormula>(c->data);
+            return formulas(a->l, b.l) && formulas(a->r, b.r);
+        }
+        if (auto a = std::get_if<OrFormula>(&p->data)) {
+            auto &b = std::get<OrFormula>(c->data);
+            return formulas(a->l, b.l) && formulas(a->r, b.r);
+        }
+        if (auto a = std::get_if<ImpliesFormula>(&p->data)) {
+            auto &b = std::get<ImpliesFormula>(c->data);
+            return formulas(a->l, b.l) && formulas(a->r, b.r);
+        }
+        if (auto q = std::get_if<ForallFormula>(&p->data)) {
+            auto &r = std::get<ForallFormula>(c->data);
+            return quantified(q->v, q->domain, q->inner, r.v, r.domain, r.inner);
+        }
+        if (auto q = std::get_if<ExistsFormula>(&p->data)) {
+            auto &r = std::get<ExistsFormula>(c->data);
+            return quantified(q->v, q->domain, q->inner, r.v, r.domain, r.inner);
+        }
+        return false;
+    }
+
+    bool quantified(const std::string &pv, const TermPtr &pd, const FormulaPtr &pi, const std::string &cv,
+                    const TermPtr &cd, const FormulaPtr &ci) {
+        // the domain is outside the binder's scope
+        if (pv != cv || !terms(pd, cd))
+            return false;
+        bound.push_back(&pv);
+        bool same = formulas(pi, ci);
+        bound.pop_back();
+        return same;
+    }
+};
+
+FormulaPtr check_substitution(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed,
+                              const std::vector<bool> *mask) {
+    if (inputs.size() != 2)
+        throw std::invalid_argument("SUBST requires 2 inputs: a formula P(a) and an equality a = b");
+
+    auto equality = std::get_if<EqualityFormula>(&inputs[1]->data);
+    if (!equality)
+        throw std::invalid_argument("SUBST: second input must be an equality");
+
+    if (!SubstitutionMatcher(equality->l, equality->r, mask).matches(inputs[0], claimed))
+        throw std::invalid_argument("SUBST: " + claimed->to_string() + " is not " + inputs[0]->to_string() +
+                                    " with " + equality->l->to_string() + " replaced by " +
+                                    equality->r->to_string());
+    return claimed;
+}
+
+} // namespace
+
+FormulaPtr subst_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
+    return check_substitution(inputs, claimed, nullptr);
+}
+
+LineRule subst_rule_at(std::vector<bool> occurrences) {
+    return [occurrences = std::move(occurrences)](const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
+        return check_substitution(inputs, claimed, &occurrences);
+    };
+}
+
+FormulaPtr implication_intro_rule(const std::vector<FormulaPtr> & /*inputs*/, FormulaPtr current_target) {
     // Check that the target is an implication
     auto impl_ptr = std::get_if<ImpliesFormula>(&current_target->data);
     if (!impl_ptr) {
@@ -306,7 +1142,7 @@ FormulaPtr forall_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed
     TermPtr fact_domain = membership_ptr->args[1];
 
     // Check that the forall domain matches the membership domain
-    if (forall_ptr->domain->to_string() != fact_domain->to_string()) {
+    if (!terms_equal(forall_ptr->domain, fact_domain)) {
         throw std::invalid_argument("Element's domain does not match forall domain");
     }
 
@@ -315,7 +1151,7 @@ FormulaPtr forall_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed
     FormulaPtr instantiated = substitute_in_formula(forall_ptr->inner, var_term, elem);
 
     // Check that the claimed formula matches the instantiated one
-    if (instantiated->to_string() != claimed->to_string()) {
+    if (!alpha_equivalent(instantiated, claimed)) {
         throw std::invalid_argument("Claimed formula " + claimed->to_string() + " does not match derived formula " +
                                     instantiated->to_string());
     }
@@ -336,14 +1172,14 @@ FormulaPtr implies_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claime
     FormulaPtr antecedent = implies_ptr->l;
     FormulaPtr consequent = implies_ptr->r;
 
-    if (antecedent->to_string() != inputs[1]->to_string()) {
+    if (!alpha_equivalent(antecedent, inputs[1])) {
         throw std::invalid_argument("Second input does not match the antecedent of the implication. "
                                     "Expected " +
                                     antecedent->to_string() + " but got " + inputs[1]->to_string());
     }
 
     // the claimed formula must match the consequent
-    if (consequent->to_string() != claimed->to_string()) {
+    if (!alpha_equivalent(consequent, claimed)) {
         throw std::invalid_argument("Claimed formula " + claimed->to_string() +
                                     " does not match the implication's consequent " + consequent->to_string());
     }
@@ -366,7 +1202,7 @@ FormulaPtr excluded_middle_rule(const std::vector<FormulaPtr> &inputs, FormulaPt
         throw std::invalid_argument("LEM: right-hand side is not a NOT");
 
     // Check that left side == inner of NOT
-    if (or_formula->l->to_string() != not_formula->inner->to_string()) {
+    if (!alpha_equivalent(or_formula->l, not_formula->inner)) {
         throw std::invalid_argument("LEM: must be of the form (P ∨ ¬P)");
     }
 
@@ -394,7 +1230,7 @@ FormulaPtr cases_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed)
     FormulaPtr t2 = imp2->r;
 
     // Check right sides match claimed
-    if (t1->to_string() != claimed->to_string() || t2->to_string() != claimed->to_string()) {
+    if (!alpha_equivalent(t1, claimed) || !alpha_equivalent(t2, claimed)) {
         throw std::invalid_argument("CASES: both implications must derive the claimed formula");
     }
 
@@ -403,76 +1239,39 @@ FormulaPtr cases_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed)
     if (!not_formula)
         throw std::invalid_argument("CASES: second implication must have ¬f on the left side");
 
-    if (not_formula->inner->to_string() != f->to_string()) {
+    if (!alpha_equivalent(not_formula->inner, f)) {
         throw std::invalid_argument("CASES: mismatched f and ¬f assumptions");
     }
 
     return claimed;
 }
 
-FormulaPtr induction_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
-    if (inputs.size() != 2)
-        throw std::invalid_argument("INDUCTION requires 2 inputs: base P(0) and step ∀k(P(k) → P(k+1))");
-
-    // -----------------------------
-    // Base: should be some P(0)
-    // -----------------------------
-    FormulaPtr base = inputs[0];
-
-    // -----------------------------
-    // Step: must be forall k ( P(k) → P(k+1) )
-    // -----------------------------
-    auto forall = std::get_if<ForallFormula>(&inputs[1]->data);
-    if (!forall)
-        throw std::invalid_argument("Step must be a forall formula");
-
-    std::string var = forall->v;
-    auto implies = std::get_if<ImpliesFormula>(&forall->inner->data);
-    if (!implies)
-        throw std::invalid_argument("Step must be an implication (P(k) → P(k+1))");
-
-    TermPtr var_term = Term::make_variable(var);
-    TermPtr succ_term = Term::make_function("+", {var_term, Term::make_constant("1")});
-    TermPtr zero_term = Term::make_constant("0");
-
-    // -----------------------------
-    // Extract schema P(x) from step
-    // -----------------------------
-    FormulaPtr Pk = implies->l; // take the premise as P(k)
-
-    // Verify base matches: P(k)[k := 0] == base
-    FormulaPtr P0 = substitute_in_formula(Pk, var_term, zero_term);
-    if (P0->to_string() != base->to_string()) {
-        std::ostringstream ss;
-        ss << "Base mismatch: expected " << base->to_string() << " but got " << P0->to_string() << " when substituting "
-           << var << " := 0 in " << Pk->to_string();
-        throw std::invalid_argument(ss.str());
-    }
-
-    // Verify step matches: RHS == P(k+1)
-    FormulaPtr Psucc = substitute_in_formula(Pk, var_term, succ_term);
-    if (implies->r->to_string() != Psucc->to_string()) {
-        std::ostringstream ss;
-        ss << "Step conclusion mismatch:\n"
-           << "  Expected: " << Psucc->to_string() << "\n"
-           << "  Got:      " << implies->r->to_string();
-        throw std::invalid_argument(ss.str());
-    }
-
-    // -----------------------------
-    // Construct final ∀n P(n)
-    // -----------------------------
-    TermPtr n_term = Term::make_variable("n");
-    FormulaPtr Pn = substitute_in_formula(Pk, var_term, n_term);
-
-    // TODO: don't do this.
-    TermPtr natural_numbers = Term::make_constant("ℕ");
-    FormulaPtr result = Formula::make_forall("n", natural_numbers, Pn);
-
-    if (claimed->to_string() != result->to_string()) {
-        throw std::invalid_argument("Claimed " + claimed->to_string() + " does not match derived " +
-                                    result->to_string());
+FormulaPtr equiv_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
+    if (inputs.size() > 1)
+        throw std::invalid_argument("EQUIV takes at most 1 input: a formula equivalent to the claimed one");
+
+    // shared by every proof on this thread, so atoms seen by earlier lines keep their variables and nodes, it is
+    // only reset once it gets large
+    thread_local BddManager manager;
+    constexpr size_t max_nodes = 1 << 22;
+    if (manager.size() > max_nodes)
+        manager.clear();
+
+    Bdd expected = inputs.empty() ? BddManager::true_bdd : manager.from_formula(inputs[0]);
+    if (manager.from_formula(claimed) != expected) {
+        throw std::invalid_argument(inputs.empty() ? "EQUIV: " + claimed->to_string() + " is not a tautology"
+                                                   : "EQUIV: " + claimed->to_string() + " is not equivalent to " +
+                                                         inputs[0]->to_string());
     }
+    return claimed;
+}
+
+FormulaPtr induction_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
+    natural_induction().check(inputs, claimed);
+    return claimed;
+}
 
+FormulaPtr strong_induction_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed) {
+    strong_natural_induction().check(inputs, claimed);
     return claimed;
 }
@@ -1,12 +1,19 @@
 #ifndef PROOF_HPP
 #define PROOF_HPP
 
+#include "../certificate/certificate.hpp"
 #include "../proof_system/proof_system.hpp"
+#include "../rule_registry/rule_registry.hpp"
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 // Represents a single line in the proof
@@ -16,10 +23,137 @@ struct ProofLine {
     std::vector<int> dependencies;
 };
 
-using LineRule = std::function<FormulaPtr(const std::vector<FormulaPtr> &, FormulaPtr)>;
+// A line to be added by Proof::add_lines
+struct LineSpec {
+    FormulaPtr statement;
+    std::string rule;
+    std::vector<int> dependencies;
+};
+
+// A line as seen through a ProofLineTable, only valid until the table is modified
+struct ProofLineView {
+    const FormulaPtr &statement;
+    std::string_view justification;
+    std::span<const int> dependencies;
+};
+
+/**
+ * @brief a hypothesis introduced while working on a target (by instantiate_forall or instantiate_implication)
+ *
+ * frames form a persistent linked list, so pushing a hypothesis is O(1), targets split off from the same goal share
+ * the hypotheses they have in common, and dropping a closed target's context doesn't touch any other target.
+ */
+struct AssumptionFrame {
+    FormulaPtr hypothesis;
+    std::uint64_t hash;
+    std::shared_ptr<const AssumptionFrame> parent;
+    // the number of frames up to and including this one
+    std::uint32_t depth = 1;
+    // the target that introduced the hypothesis, numbered like the targets of an exported certificate
+    std::uint32_t target = 0;
+};
+using AssumptionContext = std::shared_ptr<const AssumptionFrame>;
+
+/// true if frame is context or one of its parents, no frame (only the original assumptions) is in every context
+bool in_scope(const AssumptionContext &frame, const AssumptionContext &context);
+
+/**
+ * @brief proof lines stored column wise, a statement column, a rule id column, and the dependencies of every line in
+ * one CSR offsets + indices pair, so adding a line doesn't allocate and scans only touch the column they need
+ *
+ * each line also keeps the deepest hypothesis it rests on, a line can only be used by targets that have it.
+ */
+class ProofLineTable {
+  public:
+    void push_back(FormulaPtr statement, RuleId rule, std::span<const int> dependencies,
+                   AssumptionContext context = nullptr);
+    void reserve(size_t num_lines, size_t num_dependencies);
+    /// drops every line from num_lines on
+    void truncate(size_t num_lines);
+    void clear();
+
+    size_t size() const { return statements.size(); }
+    size_t num_dependencies() const { return dependency_indices.size(); }
+    bool empty() const { return statements.empty(); }
+
+    const FormulaPtr &statement(size_t i) const { return statements[i]; }
+    RuleId rule(size_t i) const { return rules[i]; }
+    const AssumptionContext &context(size_t i) const { return contexts[i]; }
+    std::span<const int> dependencies(size_t i) const {
+        return {dependency_indices.data() + dependency_offsets[i], dependency_indices.data() + dependency_offsets[i + 1]};
+    }
+
+    const std::vector<FormulaPtr> &statement_column() const { return statements; }
+    const std::vector<RuleId> &rule_column() const { return rules; }
+
+  private:
+    std::vector<FormulaPtr> statements;
+    std::vector<RuleId> rules;
+    std::vector<AssumptionContext> contexts;
+    // the dependencies of line i are dependency_indices[dependency_offsets[i] .. dependency_offsets[i + 1])
+    std::vector<std::uint32_t> dependency_offsets{0};
+    std::vector<int> dependency_indices;
+};
 
 // Forward-declare Proof so TargetRule can reference it
 class Proof;
+class LemmaStore;
+class InductionSchemas;
+class PremiseIndex;
+
+// One call that changed a Proof, as kept by Proof::record
+struct ProofStep {
+    enum class Kind : std::uint8_t {
+        lines,
+        instantiate_forall,
+        instantiate_implication,
+        instantiate_induction,
+        rewrite_target,
+        compact,
+    };
+    Kind kind = Kind::lines;
+    // lines: the lines added, add_line_to_proof is a batch of one
+    std::vector<LineSpec> lines{};
+    // instantiate_forall: the variable asked for, null for the bound one
+    TermPtr variable{};
+    // rewrite_target: the equality line
+    int equality_line = -1;
+    // instantiate_induction: the schemas used, which have to outlive the record. saved records refer to them by
+    // InductionSchemas::id
+    InductionSchemas *schemas = nullptr;
+    // what the step did to the active target, the hypothesis it introduced if any and the targets replacing it
+    FormulaPtr hypothesis{};
+    std::vector<FormulaPtr> targets{};
+    // lines, while the step is kept by a Proof: the lines are num_lines lines of the proof from first_line on, so
+    // taking a step doesn't copy them, Proof::record copies them into lines
+    std::uint32_t first_line = 0;
+    std::uint32_t num_lines = 0;
+};
+
+/**
+ * @brief what a proof started from and every step taken since, enough to rebuild it with Proof::replay
+ *
+ * content_hash covers every field of every step, formulas are hashed with hash_formula so it doesn't change when
+ * bound variables are renamed, and schemas by InductionSchemas::id, so it only matches for schemas built from the
+ * same type as the ones the record was taken with, in this process or another. it is a checksum, not a MAC: it
+ * catches a record that was damaged by accident, anyone who can edit a record can also recompute its hash. see
+ * proof_record.hpp for saving records.
+ */
+struct ProofRecord {
+    std::vector<FormulaPtr> assumptions;
+    FormulaPtr target;
+    std::vector<ProofStep> steps;
+    std::uint64_t content_hash = 0;
+};
+
+std::uint64_t hash_proof_record(const ProofRecord &record);
+
+/**
+ * @brief verify replays every step through the same checks as the original proof went through. trusted rebuilds the
+ * lines, targets and hypotheses straight from the record without running any rule or re-deriving any target, which is
+ * only sound for a record that was verified before
+ */
+enum class ReplayMode { verify, trusted };
 
 /**
  * @brief can mutate the Proof (add assumptions, set a new goal, etc.).
@@ -30,40 +164,175 @@ using ProofModificationRule = std::function<void(Proof &, const std::vector<Term
 class Proof {
   public:
     /// Note that it only takes in one target, which is fine, but internally it can hold a list of targets
-    Proof(std::vector<FormulaPtr> assumptions, FormulaPtr target);
+    Proof(std::vector<FormulaPtr> assumptions, FormulaPtr target,
+          const RuleRegistry &registry = RuleRegistry::builtin());
 
+    /// adds a rule for this proof only, throws std::invalid_argument if the registry or this proof already has a rule
+    /// with that name
     void register_rule(const std::string &name, LineRule rule);
 
     void register_modification_rule(const std::string &name, ProofModificationRule rule);
 
+    /**
+     * @brief once this proof is valid its target is stored as a lemma in the store, and lemmas already in the store
+     * can be cited through the LEMMA rule
+     */
+    void use_lemma_store(LemmaStore &store);
+
     void add_line_to_proof(FormulaPtr claimed_statement, const std::string &rule_name,
                            const std::vector<int> &deps = {});
 
+    /**
+     * @brief adds the lines in order as if by add_line_to_proof, or none of them if any is invalid
+     *
+     * dependencies may refer to earlier lines of the same batch. every line is checked against the hypotheses of the
+     * target that is active when the batch starts, and targets are only closed once all the lines are in. an empty
+     * batch does nothing and isn't recorded.
+     */
+    void add_lines(std::span<const LineSpec> specs);
+
     void instantiate_forall(std::optional<TermPtr> requested_varaible = std::nullopt);
     void instantiate_implication();
+    /// replaces the active goal ∀n ∈ ℕ P(n) with P(0), and adds the goal ∀k ∈ ℕ (P(k) → P(k + 1))
     void instantiate_induction();
+    /// replaces the active goal with the first case of its induction schema, and adds the other cases as goals
+    void instantiate_induction(InductionSchemas &schemas);
 
     void rewrite_target_using_equality(int equality_proof_line);
 
     FormulaPtr get_active_target() const;
+    /// the assumptions followed by the hypotheses of the active target, oldest first
+    std::vector<FormulaPtr> get_active_assumptions() const;
+    /**
+     * @brief the assumptions related to the active target through at most max_hops steps of shared symbols (see
+     * PremiseIndex), followed by all the hypotheses of the active target
+     *
+     * this is a heuristic for automation to narrow its search with, leaving an assumption out doesn't mean it isn't
+     * needed.
+     */
+    std::vector<FormulaPtr> get_relevant_assumptions(size_t max_hops = 2) const;
+
+    size_t num_lines() const { return lines.size(); }
+    ProofLineView line(size_t i) const;
+    /// copies the lines out into owning ProofLines
+    std::vector<ProofLine> copy_lines() const;
 
     bool is_valid() const;
     void print() const;
 
+    /**
+     * @brief for a finished proof, drops every line that no completed target depends on and merges lines with
+     * identical statements, dependencies are renumbered to match
+     */
+    void compact();
+
+    /// the assumptions, the target and every step taken so far, with its content hash filled in
+    ProofRecord record() const;
+
+    /**
+     * @brief rebuilds a recorded proof by applying its steps to this one, which has to be fresh and started from the
+     * record's assumptions and target
+     *
+     * rules are looked up by name, so the rules the original proof registered have to be registered again, and a
+     * verified replay citing lemmas needs the lemma store. a trusted replay throws std::invalid_argument if the record
+     * doesn't match its content hash. the hash only guards against accidental damage, so only records that never left
+     * the caller's hands since they were verified can be trusted.
+     */
+    void replay(const ProofRecord &record, ReplayMode mode);
+
+    /// true once steps have been replayed as trusted, ie without their lines being checked by this proof
+    bool replayed_without_checks() const { return trusted_replay; }
+
+    /**
+     * @brief a compact certificate of this finished proof that can be re-checked by check_certificate without any of
+     * the Proof machinery, throws if a line uses a rule that certificates can't express
+     */
+    Certificate export_certificate() const;
+
   private:
-    std::vector<ProofLine> lines;
+    ProofLineTable lines;
+    // line statements by hash, so a target that changes can be looked up among the lines
+    std::unordered_multimap<std::uint64_t, size_t> line_index;
+    // the assumptions the proof was started with, hashed so ASSUMPTION doesn't have to scan them
     std::vector<FormulaPtr> assumptions;
+    std::unordered_multimap<std::uint64_t, size_t> assumption_index;
+    // built with the proof, so that const members can share it without locking, and shared by copies of the proof
+    std::shared_ptr<const PremiseIndex> premise_index;
 
     // things that have to be proven, during the course of this proof.
     std::vector<FormulaPtr> targets;
+    // the hypotheses available to each target, parallel to the above
+    std::vector<AssumptionContext> target_contexts;
     // an index into the above
     size_t active_target_idx = 0;
 
     // Stack of old goals (so we can inspect or implement backtracking)
     std::vector<std::vector<FormulaPtr>> target_history;
 
-    std::unordered_map<std::string, LineRule> rules;
+    // every target there has been, and how each was proven, from the cases it was replaced with or a line. the lines
+    // these name are what the proof actually rests on
+    struct TargetNode {
+        FormulaPtr formula;
+        std::uint32_t parent = no_target;
+        // unset while the target is open
+        std::optional<TargetStep> step{};
+        FormulaPtr hypothesis{};
+        int line = -1;
+        const InductionSchemas *schemas = nullptr;
+    };
+    std::vector<TargetNode> target_tree;
+    // the node of each target, parallel to targets
+    std::vector<std::uint32_t> target_nodes;
+
+    // lines only store rule ids, ids past the end of the registry refer to the rules registered on this proof
+    const RuleRegistry *registry;
+    std::vector<std::pair<std::string, LineRule>> custom_rules;
+    std::optional<RuleId> find_rule(const std::string &name) const;
+    const std::string &rule_name(RuleId id) const;
+
+    // every step taken, for record
+    std::vector<ProofStep> steps;
+    bool trusted_replay = false;
+    void replay_trusted(const ProofStep &step);
+    /// copies the lines a step refers to into step.lines
+    void copy_step_lines(ProofStep &step) const;
+
+    /// replaces the active target with new_targets[0] and adds the rest with the same hypotheses, then closes any that
+    /// are already known. step and line record how the active target follows from the new ones
+    void replace_active_target(std::span<const FormulaPtr> new_targets, TargetStep step, int line = -1,
+                               const InductionSchemas *schemas = nullptr);
+
+    /// throws std::invalid_argument unless the rule derives claimed from the dependencies
+    void check_line(RuleId rule_id, const std::vector<FormulaPtr> &dep_statements, const FormulaPtr &claimed) const;
+    /// closes the targets proven by the lines from first_line on
+    void close_targets(size_t first_line);
+    void close_target(size_t target_idx, int line);
+    /// closes a target that changed if it's already a line, or an assumption it can be justified by
+    void close_if_known(size_t target_idx);
+    void index_lines(size_t first_line);
+
+    AssumptionContext active_context() const;
+    void push_hypothesis(FormulaPtr hypothesis);
+    /// true if v is free in none of the assumptions, the hypotheses of the active target and goal
+    bool is_fresh(const std::string &v, const FormulaPtr &goal) const;
+    /// true if f is one of the original assumptions or a hypothesis of the active target
+    bool is_assumption(FormulaPtr f) const;
+    bool is_assumption(FormulaPtr f, const AssumptionContext &context) const;
+    /// like is_assumption, scope is set to the frame of the hypothesis f is, null for an original assumption
+    bool find_assumption(FormulaPtr f, const AssumptionContext &context, AssumptionContext &scope) const;
+    /// the assumption or hypothesis an ASSUMPTION line stating f in scope cites
+    FormulaPtr cited_assumption(const FormulaPtr &f, const AssumptionContext &scope) const;
+    /// the hypotheses a new line rests on, the deepest context of its dependencies or the assumption it states
+    AssumptionContext line_context(RuleId rule_id, std::span<const int> deps, const FormulaPtr &claimed) const;
+    /// throws std::invalid_argument if a dependency rests on a hypothesis the active target doesn't have
+    void check_dependency_scope(std::span<const int> deps, size_t line) const;
     std::unordered_map<std::string, ProofModificationRule> target_rules;
+
+    // what this proof set out to prove, kept so that it can be stored as a lemma
+    FormulaPtr original_target;
+    std::uint64_t assumptions_fingerprint;
+
+    LemmaStore *lemma_store = nullptr;
 };
 
 // ---------- Example built-in rules ----------
@@ -72,8 +341,27 @@ FormulaPtr and_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
 FormulaPtr forall_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
 FormulaPtr implies_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
 FormulaPtr eq_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
+/// from a = b infer b = a
+FormulaPtr eq_sym_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
+/// from a = b, b = c, ..., y = z infer a = z
+FormulaPtr eq_trans_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
+/// from ai = bi for each argument that differs infer f(a1, ..., an) = f(b1, ..., bn)
+FormulaPtr eq_cong_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
+/**
+ * @brief from P(a) and a = b infer P with any of its occurrences of a replaced by b
+ *
+ * the claim is checked against the premise in one walk over both, quantifiers have to bind the same names in both, and
+ * an occurrence under a binder of one of the equality's variables can't be replaced
+ */
+FormulaPtr subst_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
+/// SUBST where occurrence i of a (left to right) is replaced exactly when occurrences[i] is set
+LineRule subst_rule_at(std::vector<bool> occurrences);
 FormulaPtr induction_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
+/// from ∀n ∈ ℕ ((∀m ∈ ℕ (m < n → P(m))) → P(n)) infer ∀n ∈ ℕ P(n)
+FormulaPtr strong_induction_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
 FormulaPtr excluded_middle_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
 FormulaPtr cases_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
+/// claimed is propositionally equivalent to the one input, or a tautology when there are no inputs
+FormulaPtr equiv_rule(const std::vector<FormulaPtr> &inputs, FormulaPtr claimed);
 
 #endif // PROOF_HPP
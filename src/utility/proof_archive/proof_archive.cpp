@@ -0,0 +1,551 @@
+#include "proof_archive.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr char archive_magic[8] = {'M', 'W', 'E', 'A', 'R', 'C', 'H', '1'};
+constexpr std::uint64_t archive_version = 2;
+
+// after the header the archive is a proof record per certificate and then an end record
+constexpr std::uint8_t end_record = 0;
+constexpr std::uint8_t proof_record = 1;
+
+// every formula and term starts with one of these, a node written out in full has the tag node_tag + its kind
+constexpr std::uint64_t ref_tag = 0;
+constexpr std::uint64_t edit_tag = 1;
+constexpr std::uint64_t node_tag = 2;
+
+// a formula is only written as an edit of one of the last max_bases formulas, with at most max_edits edits
+constexpr size_t max_bases = 16;
+constexpr size_t max_edits = 4;
+
+void put_varint(std::string &bytes, std::uint64_t v) {
+    while (v >= 0x80) {
+        bytes.push_back(char((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    bytes.push_back(char(v));
+}
+
+size_t varint_size(std::uint64_t v) {
+    size_t n = 1;
+    for (; v >= 0x80; v >>= 7)
+        ++n;
+    return n;
+}
+
+std::uint64_t zigzag(std::int64_t v) { return ((std::uint64_t)v << 1) ^ (std::uint64_t)(v >> 63); }
+std::int64_t unzigzag(std::uint64_t v) { return (std::int64_t)(v >> 1) ^ -(std::int64_t)(v & 1); }
+
+// node with what is at the end of path (a child index at each level) swapped for replacement
+std::uint32_t replace_at(FlatFormulaTable &table, std::uint32_t node, std::span<const std::uint32_t> path,
+                         std::uint32_t replacement) {
+    if (path.empty())
+        return replacement;
+    auto c = table.children_of(node);
+    if (path[0] >= c.size())
+        throw std::invalid_argument("proof archive: edit path leaves the formula");
+    FlatNode n = table.nodes[node];
+    std::vector<std::uint32_t> children(c.begin(), c.end());
+    children[path[0]] = replace_at(table, children[path[0]], path.subspan(1), replacement);
+    return table.intern_node(n.kind, n.symbol, children);
+}
+
+// ---------- writing ----------
+
+// writes the formulas of one certificate, adding to the dictionary exactly what the reader will add when it reads them
+class FormulaEncoder {
+  public:
+    FormulaEncoder(FlatFormulaTable &dictionary, const FlatFormulaTable &nodes, std::string &bytes)
+        : dictionary(dictionary), nodes(nodes), bytes(bytes), symbols(nodes.symbols.size()),
+          ids(nodes.nodes.size(), unknown), costs(nodes.nodes.size()), cost_stamps(nodes.nodes.size(), 0) {
+        for (size_t i = 0; i < nodes.symbols.size(); ++i)
+            symbols[i] = dictionary.find_symbol(nodes.symbols[i]);
+    }
+
+    /// a formula later formulas of the certificate can be written as edits of
+    void formula(std::uint32_t node) {
+        ++stamp;
+        std::uint32_t id = lookup(node);
+        if (id != absent) {
+            reference(id);
+        } else {
+            size_t best_cost = cost(node);
+            size_t best_base = 0;
+            std::vector<Edit> best_edits;
+            for (size_t back = 1; back <= std::min(max_bases, recent.size()); ++back) {
+                std::vector<Edit> edits;
+                std::vector<std::uint32_t> path;
+                if (!diff(recent[recent.size() - back], node, path, edits))
+                    continue;
+                size_t c = 1 + varint_size(back) + varint_size(edits.size());
+                for (const Edit &edit : edits)
+                    c += varint_size(edit.path.size()) + edit.path.size() + cost(edit.node);
+                if (c < best_cost) {
+                    best_cost = c;
+                    best_base = back;
+                    best_edits = std::move(edits);
+                }
+            }
+            id = best_base ? edited(best_base, node, best_edits) : term(node);
+        }
+        recent.push_back(id);
+    }
+
+  private:
+    // ids of certificate nodes that haven't been looked up yet, and of those not in the dictionary
+    static constexpr std::uint32_t unknown = no_node;
+    static constexpr std::uint32_t absent = no_node - 1;
+
+    struct Edit {
+        std::vector<std::uint32_t> path;
+        std::uint32_t node;
+    };
+
+    FlatFormulaTable &dictionary;
+    const FlatFormulaTable &nodes;
+    std::string &bytes;
+
+    // certificate symbol and node -> dictionary symbol and node, a node that is absent stays absent until it is written
+    std::vector<std::uint32_t> symbols;
+    std::vector<std::uint32_t> ids;
+    std::vector<std::uint32_t> recent;
+
+    // the costs worked out while choosing how to write the current formula
+    std::vector<size_t> costs;
+    std::vector<std::uint32_t> cost_stamps;
+    std::uint32_t stamp = 0;
+
+    std::uint32_t symbol_of(const FlatNode &n) const {
+        if (n.symbol >= symbols.size())
+            return no_symbol;
+        return symbols[n.symbol] == no_symbol ? absent : symbols[n.symbol];
+    }
+
+    std::uint32_t lookup(std::uint32_t node) {
+        if (ids[node] != unknown)
+            return ids[node];
+        std::uint32_t symbol = symbol_of(nodes.nodes[node]);
+        if (symbol == absent)
+            return ids[node] = absent;
+        std::vector<std::uint32_t> children;
+        for (std::uint32_t c : nodes.children_of(node)) {
+            children.push_back(lookup(c));
+            if (children.back() == absent)
+                return ids[node] = absent;
+        }
+        std::uint32_t id = dictionary.find_node(nodes.nodes[node].kind, symbol, children);
+        return ids[node] = id == no_node ? absent : id;
+    }
+
+    // about how many bytes term(node) would write
+    size_t cost(std::uint32_t node) {
+        std::uint32_t id = lookup(node);
+        if (id != absent)
+            return 1 + varint_size(dictionary.nodes.size() - 1 - id);
+        if (cost_stamps[node] == stamp)
+            return costs[node];
+        const FlatNode &n = nodes.nodes[node];
+        size_t c = 3;
+        if (symbol_of(n) == absent)
+            c += 1 + nodes.symbols[n.symbol].size();
+        for (std::uint32_t child : nodes.children_of(node))
+            c += cost(child);
+        cost_stamps[node] = stamp;
+        return costs[node] = c;
+    }
+
+    // the edits that turn base into node, false if it takes more than max_edits
+    bool diff(std::uint32_t base, std::uint32_t node, std::vector<std::uint32_t> &path, std::vector<Edit> &edits) {
+        if (lookup(node) == base)
+            return true;
+        const FlatNode &b = dictionary.nodes[base];
+        const FlatNode &n = nodes.nodes[node];
+        if (b.kind == n.kind && b.symbol == symbol_of(n) && b.child_count == n.child_count && b.child_count > 0) {
+            auto base_children = dictionary.children_of(base);
+            auto node_children = nodes.children_of(node);
+            for (std::uint32_t i = 0; i < b.child_count; ++i) {
+                path.push_back(i);
+                if (!diff(base_children[i], node_children[i], path, edits))
+                    return false;
+                path.pop_back();
+            }
+            return true;
+        }
+        if (edits.size() == max_edits)
+            return false;
+        edits.push_back({path, node});
+        return true;
+    }
+
+    void reference(std::uint32_t id) {
+        put_varint(bytes, ref_tag);
+        put_varint(bytes, dictionary.nodes.size() - 1 - id);
+    }
+
+    std::uint32_t term(std::uint32_t node) {
+        std::uint32_t id = lookup(node);
+        if (id != absent) {
+            reference(id);
+            return id;
+        }
+
+        const FlatNode &n = nodes.nodes[node];
+        put_varint(bytes, node_tag + (std::uint64_t)n.kind);
+        std::uint32_t symbol = symbol_of(n);
+        if (symbol == no_symbol) {
+            put_varint(bytes, 0);
+        } else if (symbol == absent) {
+            const std::string &name = nodes.symbols[n.symbol];
+            put_varint(bytes, 1);
+            put_varint(bytes, name.size());
+            bytes += name;
+            symbol = symbols[n.symbol] = dictionary.intern_symbol(name);
+        } else {
+            put_varint(bytes, (std::uint64_t)symbol + 2);
+        }
+
+        auto c = nodes.children_of(node);
+        put_varint(bytes, c.size());
+        std::vector<std::uint32_t> children;
+        children.reserve(c.size());
+        for (std::uint32_t child : c)
+            children.push_back(term(child));
+        return ids[node] = dictionary.intern_node(n.kind, symbol, children);
+    }
+
+    std::uint32_t edited(size_t back, std::uint32_t node, const std::vector<Edit> &edits) {
+        put_varint(bytes, edit_tag);
+        put_varint(bytes, back);
+        put_varint(bytes, edits.size());
+        std::uint32_t current = recent[recent.size() - back];
+        for (const Edit &edit : edits) {
+            put_varint(bytes, edit.path.size());
+            for (std::uint32_t i : edit.path)
+                put_varint(bytes, i);
+            current = replace_at(dictionary, current, edit.path, term(edit.node));
+        }
+
+        // the nodes on the edited paths are new to the dictionary
+        for (const Edit &edit : edits) {
+            std::uint32_t x = node, y = current;
+            ids[x] = y;
+            for (std::uint32_t i : edit.path) {
+                x = nodes.children_of(x)[i];
+                y = dictionary.children_of(y)[i];
+                ids[x] = y;
+            }
+        }
+        return current;
+    }
+};
+
+// ---------- reading ----------
+
+class ByteSource {
+  public:
+    explicit ByteSource(std::istream &in) : buffer(in.rdbuf()) {
+        if (!buffer)
+            throw std::invalid_argument("proof archive: no stream to read");
+    }
+
+    std::uint8_t byte() {
+        auto c = buffer->sbumpc();
+        if (c == std::char_traits<char>::eof())
+            throw std::invalid_argument("proof archive is truncated");
+        return (std::uint8_t)c;
+    }
+
+    std::uint64_t varint() {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            std::uint8_t b = byte();
+            v |= (std::uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return v;
+        }
+        throw std::invalid_argument("proof archive: varint too long");
+    }
+
+    std::uint32_t u32() {
+        std::uint64_t v = varint();
+        if (v > 0xffffffffull)
+            throw std::invalid_argument("proof archive: number out of range");
+        return (std::uint32_t)v;
+    }
+
+    // read in pieces, so a corrupt length fails at the end of the stream instead of allocating it up front
+    std::string string(std::uint64_t length) {
+        std::string s;
+        char piece[4096];
+        while (s.size() < length) {
+            std::streamsize n = (std::streamsize)std::min<std::uint64_t>(sizeof(piece), length - s.size());
+            if (buffer->sgetn(piece, n) != n)
+                throw std::invalid_argument("proof archive is truncated");
+            s.append(piece, n);
+        }
+        return s;
+    }
+
+  private:
+    std::streambuf *buffer;
+};
+
+// reads the formulas of one certificate into the dictionary and copies the nodes they use into the certificate's table
+class FormulaDecoder {
+  public:
+    FormulaDecoder(FlatFormulaTable &dictionary, ByteSource &source, FlatFormulaTable &nodes)
+        : dictionary(dictionary), source(source), nodes(nodes) {}
+
+    std::uint32_t formula() {
+        std::uint32_t id = expression();
+        recent.push_back(id);
+        return copy(id);
+    }
+
+  private:
+    FlatFormulaTable &dictionary;
+    ByteSource &source;
+    FlatFormulaTable &nodes;
+
+    std::vector<std::uint32_t> recent;
+    std::unordered_map<std::uint32_t, std::uint32_t> copies;
+
+    std::uint32_t expression() {
+        std::uint64_t tag = source.varint();
+        if (tag == ref_tag) {
+            std::uint64_t back = source.varint();
+            if (back >= dictionary.nodes.size())
+                throw std::invalid_argument("proof archive: reference to a node that isn't there");
+            return (std::uint32_t)(dictionary.nodes.size() - 1 - back);
+        }
+
+        if (tag == edit_tag) {
+            std::uint64_t back = source.varint();
+            if (back == 0 || back > recent.size())
+                throw std::invalid_argument("proof archive: edit of a formula that isn't there");
+            std::uint32_t current = recent[recent.size() - back];
+            std::uint64_t edit_count = source.varint();
+            std::vector<std::uint32_t> path;
+            for (std::uint64_t i = 0; i < edit_count; ++i) {
+                path.clear();
+                std::uint64_t length = source.varint();
+                for (std::uint64_t j = 0; j < length; ++j)
+                    path.push_back(source.u32());
+                std::uint32_t replacement = expression();
+                current = replace_at(dictionary, current, path, replacement);
+            }
+            return current;
+        }
+
+        if (tag - node_tag > (std::uint64_t)NodeKind::exists)
+            throw std::invalid_argument("proof archive: unknown node kind");
+        NodeKind kind = (NodeKind)(tag - node_tag);
+
+        std::uint32_t symbol = no_symbol;
+        std::uint64_t s = source.varint();
+        if (s == 1) {
+            symbol = dictionary.intern_symbol(source.string(source.varint()));
+        } else if (s > 1) {
+            if (s - 2 >= dictionary.symbols.size())
+                throw std::invalid_argument("proof archive: reference to a symbol that isn't there");
+            symbol = (std::uint32_t)(s - 2);
+        }
+
+        std::uint64_t child_count = source.varint();
+        std::vector<std::uint32_t> children;
+        for (std::uint64_t i = 0; i < child_count; ++i)
+            children.push_back(expression());
+        return dictionary.intern_node(kind, symbol, children);
+    }
+
+    std::uint32_t copy(std::uint32_t id) {
+        auto it = copies.find(id);
+        if (it != copies.end())
+            return it->second;
+        const FlatNode &n = dictionary.nodes[id];
+        std::vector<std::uint32_t> children;
+        for (std::uint32_t c : dictionary.children_of(id))
+            children.push_back(copy(c));
+        std::uint32_t symbol = n.symbol == no_symbol ? no_symbol : nodes.intern_symbol(dictionary.symbols[n.symbol]);
+        return copies[id] = nodes.intern_node(n.kind, symbol, children);
+    }
+};
+
+} // namespace
+
+ProofArchiveWriter::ProofArchiveWriter(std::ostream &out) : out(out) {
+    std::string bytes(archive_magic, sizeof(archive_magic));
+    put_varint(bytes, archive_version);
+    out.write(bytes.data(), bytes.size());
+    written += bytes.size();
+    if (!out)
+        throw std::runtime_error("could not write proof archive");
+}
+
+void ProofArchiveWriter::add(const Certificate &certificate) {
+    if (finished)
+        throw std::logic_error("ProofArchiveWriter: add after finish");
+
+    // everything is checked before anything is written, the dictionary has to stay in step with what the reader sees
+    std::string err;
+    if (!certificate.nodes.is_well_formed(&err))
+        throw std::invalid_argument("ProofArchiveWriter: " + err);
+    auto check = [&](std::uint32_t node) {
+        if (node >= certificate.nodes.nodes.size())
+            throw std::invalid_argument("ProofArchiveWriter: node " + std::to_string(node) + " out of range");
+    };
+    for (auto *formulas : {&certificate.assumptions, &certificate.lemmas})
+        std::for_each(formulas->begin(), formulas->end(), check);
+    check(certificate.goal);
+    for (size_t i = 0; i < certificate.targets.size(); ++i) {
+        const CertificateTarget &target = certificate.targets[i];
+        check(target.formula);
+        if (target.hypothesis != no_node)
+            check(target.hypothesis);
+        if (target.parent != no_target && target.parent >= i)
+            throw std::invalid_argument("ProofArchiveWriter: target " + std::to_string(i) + " before its parent");
+    }
+    for (const CertificateLine &line : certificate.lines) {
+        check(line.statement);
+        if ((std::uint64_t)line.first_dependency + line.dependency_count > certificate.dependencies.size())
+            throw std::invalid_argument("ProofArchiveWriter: dependencies out of range");
+    }
+
+    // indices that can be missing are written plus one, with 0 for missing
+    auto put_optional = [](std::string &out, std::uint32_t index) {
+        put_varint(out, index == 0xffffffff ? 0 : (std::uint64_t)index + 1);
+    };
+
+    std::string bytes(1, (char)proof_record);
+    FormulaEncoder encoder(dictionary, certificate.nodes, bytes);
+    for (auto *formulas : {&certificate.assumptions, &certificate.lemmas}) {
+        put_varint(bytes, formulas->size());
+        for (std::uint32_t node : *formulas)
+            encoder.formula(node);
+    }
+
+    // parents are written counting back, the hypothesis after a flag
+    encoder.formula(certificate.goal);
+    put_varint(bytes, certificate.targets.size());
+    for (size_t i = 0; i < certificate.targets.size(); ++i) {
+        const CertificateTarget &target = certificate.targets[i];
+        encoder.formula(target.formula);
+        put_varint(bytes, target.parent == no_target ? 0 : i - target.parent);
+        bytes.push_back((char)target.step);
+        bytes.push_back(target.hypothesis != no_node);
+        if (target.hypothesis != no_node)
+            encoder.formula(target.hypothesis);
+        put_optional(bytes, target.line);
+    }
+
+    // dependencies are almost always the lines just before, so they are written counting back
+    put_varint(bytes, certificate.lines.size());
+    for (size_t i = 0; i < certificate.lines.size(); ++i) {
+        const CertificateLine &line = certificate.lines[i];
+        encoder.formula(line.statement);
+        bytes.push_back((char)line.rule);
+        put_optional(bytes, line.context);
+        put_varint(bytes, line.dependency_count);
+        for (std::uint32_t d = 0; d < line.dependency_count; ++d)
+            put_varint(bytes, zigzag((std::int64_t)i - 1 - certificate.dependencies[line.first_dependency + d]));
+    }
+
+    out.write(bytes.data(), bytes.size());
+    written += bytes.size();
+    if (!out)
+        throw std::runtime_error("could not write proof archive");
+}
+
+void ProofArchiveWriter::finish() {
+    if (finished)
+        return;
+    finished = true;
+    out.put((char)end_record);
+    out.flush();
+    written += 1;
+    if (!out)
+        throw std::runtime_error("could not write proof archive");
+}
+
+ProofArchiveReader::ProofArchiveReader(std::istream &in) : in(in) {
+    ByteSource source(in);
+    char magic[sizeof(archive_magic)];
+    for (char &c : magic)
+        c = (char)source.byte();
+    if (std::memcmp(magic, archive_magic, sizeof(archive_magic)) != 0)
+        throw std::invalid_argument("not a proof archive");
+    if (source.varint() != archive_version)
+        throw std::invalid_argument("unsupported proof archive version");
+}
+
+bool ProofArchiveReader::next(Certificate &certificate) {
+    if (finished)
+        return false;
+
+    ByteSource source(in);
+    std::uint8_t record = source.byte();
+    if (record == end_record) {
+        finished = true;
+        return false;
+    }
+    if (record != proof_record)
+        throw std::invalid_argument("proof archive: unknown record");
+
+    Certificate read;
+    FormulaDecoder decoder(dictionary, source, read.nodes);
+    for (auto *formulas : {&read.assumptions, &read.lemmas}) {
+        std::uint64_t count = source.varint();
+        for (std::uint64_t i = 0; i < count; ++i)
+            formulas->push_back(decoder.formula());
+    }
+
+    auto optional = [&]() -> std::uint32_t {
+        std::uint64_t index = source.varint();
+        if (index > 0xffffffffull)
+            throw std::invalid_argument("proof archive: index out of range");
+        return index == 0 ? 0xffffffff : (std::uint32_t)(index - 1);
+    };
+
+    read.goal = decoder.formula();
+    std::uint64_t target_count = source.varint();
+    for (std::uint64_t i = 0; i < target_count; ++i) {
+        CertificateTarget target;
+        target.formula = decoder.formula();
+        std::uint64_t back = source.varint();
+        if (back > i)
+            throw std::invalid_argument("proof archive: target before its parent");
+        target.parent = back == 0 ? no_target : (std::uint32_t)(i - back);
+        target.step = (TargetStep)source.byte();
+        target.hypothesis = source.byte() ? decoder.formula() : no_node;
+        target.line = optional();
+        read.targets.push_back(target);
+    }
+
+    std::uint64_t line_count = source.varint();
+    for (std::uint64_t i = 0; i < line_count; ++i) {
+        CertificateLine line;
+        line.statement = decoder.formula();
+        line.rule = (CertificateRule)source.byte();
+        line.context = optional();
+        line.first_dependency = (std::uint32_t)read.dependencies.size();
+        line.dependency_count = source.u32();
+        for (std::uint32_t d = 0; d < line.dependency_count; ++d) {
+            std::int64_t dependency = (std::int64_t)i - 1 - unzigzag(source.varint());
+            if (dependency < 0 || dependency > 0xffffffffll)
+                throw std::invalid_argument("proof archive: dependency out of range");
+            read.dependencies.push_back((std::uint32_t)dependency);
+        }
+        read.lines.push_back(line);
+    }
+
+    certificate = std::move(read);
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef PROOF_ARCHIVE_HPP
+#define PROOF_ARCHIVE_HPP
+
+#include "../certificate/certificate.hpp"
+#include "../flat_formula/flat_formula.hpp"
+#include <cstddef>
+#include <istream>
+#include <ostream>
+
+/**
+ * @brief many certificates in one stream, written as differences from what the stream already holds
+ *
+ * the writer and the reader grow the same node dictionary as they go, shared by every certificate in the archive, so a
+ * node is written at most once and after that is a back reference. a formula with new nodes is either written out node
+ * by node or, when it is shorter, as an earlier formula of the same certificate plus a few edits, each a path of child
+ * indices and the subterm that goes there. that is what most proof lines are: an earlier line with a variable
+ * instantiated or one subterm rewritten. all numbers are LEB128 varints.
+ *
+ * certificates are read back one at a time, only the dictionary is kept between them. node ids of a certificate that
+ * was read back are not the ones it was written with, but it checks exactly as the original did.
+ */
+class ProofArchiveWriter {
+  public:
+    /// writes the archive header
+    explicit ProofArchiveWriter(std::ostream &out);
+
+    void add(const Certificate &certificate);
+    /// writes the end marker, nothing can be added after it
+    void finish();
+
+    size_t bytes_written() const { return written; }
+
+  private:
+    std::ostream &out;
+    FlatFormulaTable dictionary;
+    size_t written = 0;
+    bool finished = false;
+};
+
+class ProofArchiveReader {
+  public:
+    /// throws std::invalid_argument if in doesn't start with an archive header
+    explicit ProofArchiveReader(std::istream &in);
+
+    /// false once the end marker is read, throws std::invalid_argument if the archive is truncated or corrupt
+    bool next(Certificate &certificate);
+
+  private:
+    std::istream &in;
+    FlatFormulaTable dictionary;
+    bool finished = false;
+};
+
+#endif // PROOF_ARCHIVE_HPP
@@ -0,0 +1,191 @@
+#include "proof_record.hpp"
+
+#include "../certificate/certificate.hpp"
+#include "../flat_formula_conversion/flat_formula_conversion.hpp"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+constexpr char record_magic[8] = {'M', 'W', 'E', 'R', 'E', 'C', 'D', '1'};
+constexpr std::uint32_t record_version = 1;
+
+// the fewest bytes a step and a line can take, to check counts against before anything is allocated for them
+constexpr size_t min_step_size = 6 * sizeof(std::uint32_t) + sizeof(std::uint64_t);
+constexpr size_t min_line_size = 3 * sizeof(std::uint32_t);
+
+// little endian like certificates, the host byte order on every platform we build for
+class Writer {
+  public:
+    std::string bytes;
+
+    void u32(std::uint32_t v) { bytes.append(reinterpret_cast<const char *>(&v), sizeof(v)); }
+    void u64(std::uint64_t v) { bytes.append(reinterpret_cast<const char *>(&v), sizeof(v)); }
+    void str(std::string_view s) {
+        u32((std::uint32_t)s.size());
+        bytes.append(s);
+    }
+};
+
+class Reader {
+  public:
+    explicit Reader(std::string_view bytes) : bytes(bytes) {}
+
+    const char *take(size_t n) {
+        if (n > bytes.size() - pos)
+            throw std::invalid_argument("proof record is truncated");
+        const char *p = bytes.data() + pos;
+        pos += n;
+        return p;
+    }
+    std::uint32_t u32() {
+        std::uint32_t v;
+        std::memcpy(&v, take(sizeof(v)), sizeof(v));
+        return v;
+    }
+    std::uint64_t u64() {
+        std::uint64_t v;
+        std::memcpy(&v, take(sizeof(v)), sizeof(v));
+        return v;
+    }
+    std::uint32_t count(size_t record_size) {
+        std::uint32_t n = u32();
+        if ((std::uint64_t)n * record_size > bytes.size() - pos)
+            throw std::invalid_argument("proof record is truncated");
+        return n;
+    }
+    std::string_view str() {
+        std::uint32_t n = count(1);
+        return {take(n), n};
+    }
+    bool at_end() const { return pos == bytes.size(); }
+
+  private:
+    std::string_view bytes;
+    size_t pos = 0;
+};
+
+InductionSchemas *find_schemas(std::uint64_t id, std::span<InductionSchemas *const> schemas) {
+    for (InductionSchemas *s : schemas)
+        if (s && s->id() == id)
+            return s;
+    for (InductionSchemas *s : {&natural_induction(), &strong_natural_induction()})
+        if (s->id() == id)
+            return s;
+    throw std::invalid_argument("proof record: an induction step uses schemas that weren't given");
+}
+
+} // namespace
+
+std::string serialize_proof_record(const ProofRecord &record) {
+    // every formula goes into one node table, carried as a certificate with the record's assumptions and target
+    Certificate formulas;
+    FlatFormulaBuilder builder(formulas.nodes);
+    formulas.goal = builder.add_formula(record.target);
+    for (const FormulaPtr &a : record.assumptions)
+        formulas.assumptions.push_back(builder.add_formula(a));
+
+    auto formula_node = [&](const FormulaPtr &f) { return f ? builder.add_formula(f) : no_node; };
+    Writer steps;
+    steps.u32((std::uint32_t)record.steps.size());
+    for (const ProofStep &step : record.steps) {
+        steps.u32((std::uint32_t)step.kind);
+        steps.u32((std::uint32_t)step.lines.size());
+        for (const LineSpec &line : step.lines) {
+            steps.u32(builder.add_formula(line.statement));
+            steps.str(line.rule);
+            steps.u32((std::uint32_t)line.dependencies.size());
+            for (int d : line.dependencies)
+                steps.u32((std::uint32_t)d);
+        }
+        steps.u32(step.variable ? builder.add_term(step.variable) : no_node);
+        steps.u32((std::uint32_t)step.equality_line);
+        steps.u64(step.schemas ? step.schemas->id() : 0);
+        steps.u32(formula_node(step.hypothesis));
+        steps.u32((std::uint32_t)step.targets.size());
+        for (const FormulaPtr &target : step.targets)
+            steps.u32(builder.add_formula(target));
+    }
+
+    Writer w;
+    w.bytes.append(record_magic, sizeof(record_magic));
+    w.u32(record_version);
+    w.str(serialize_certificate(formulas));
+    w.bytes.append(steps.bytes);
+    w.u64(record.content_hash);
+    return std::move(w.bytes);
+}
+
+ProofRecord parse_proof_record(std::string_view bytes, std::span<InductionSchemas *const> schemas) {
+    Reader r(bytes);
+    if (std::memcmp(r.take(sizeof(record_magic)), record_magic, sizeof(record_magic)) != 0)
+        throw std::invalid_argument("not a proof record");
+    if (r.u32() != record_version)
+        throw std::invalid_argument("unsupported proof record version");
+
+    Certificate formulas = parse_certificate(r.str());
+    if (!formulas.nodes.is_well_formed())
+        throw std::invalid_argument("proof record: malformed formula nodes");
+    FlatFormulaReader reader(formulas.nodes);
+    auto formula = [&](std::uint32_t node) {
+        if (node >= formulas.nodes.nodes.size())
+            throw std::invalid_argument("proof record: formula node out of range");
+        return reader.to_formula(node);
+    };
+
+    ProofRecord record;
+    record.target = formula(formulas.goal);
+    for (std::uint32_t a : formulas.assumptions)
+        record.assumptions.push_back(formula(a));
+
+    record.steps.resize(r.count(min_step_size));
+    for (ProofStep &step : record.steps) {
+        std::uint32_t kind = r.u32();
+        if (kind > (std::uint32_t)ProofStep::Kind::compact)
+            throw std::invalid_argument("proof record: unknown step kind");
+        step.kind = (ProofStep::Kind)kind;
+        step.lines.resize(r.count(min_line_size));
+        for (LineSpec &line : step.lines) {
+            line.statement = formula(r.u32());
+            line.rule = r.str();
+            line.dependencies.resize(r.count(sizeof(std::uint32_t)));
+            for (int &d : line.dependencies)
+                d = (int)r.u32();
+        }
+        if (std::uint32_t variable = r.u32(); variable != no_node) {
+            if (variable >= formulas.nodes.nodes.size())
+                throw std::invalid_argument("proof record: term node out of range");
+            step.variable = reader.to_term(variable);
+        }
+        step.equality_line = (int)r.u32();
+        if (std::uint64_t id = r.u64(); id != 0)
+            step.schemas = find_schemas(id, schemas);
+        if (std::uint32_t hypothesis = r.u32(); hypothesis != no_node)
+            step.hypothesis = formula(hypothesis);
+        step.targets.resize(r.count(sizeof(std::uint32_t)));
+        for (FormulaPtr &target : step.targets)
+            target = formula(r.u32());
+    }
+    record.content_hash = r.u64();
+    if (!r.at_end())
+        throw std::invalid_argument("trailing bytes after proof record");
+    return record;
+}
+
+void save_proof_record(const ProofRecord &record, const std::string &path) {
+    std::ofstream out(path, std::ios::binary);
+    std::string bytes = serialize_proof_record(record);
+    out.write(bytes.data(), bytes.size());
+    if (!out)
+        throw std::runtime_error("could not write proof record to " + path);
+}
+
+ProofRecord load_proof_record(const std::string &path, std::span<InductionSchemas *const> schemas) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("could not open proof record " + path);
+    std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return parse_proof_record(bytes, schemas);
+}
@@ -0,0 +1,28 @@
+#ifndef PROOF_RECORD_HPP
+#define PROOF_RECORD_HPP
+
+#include "../induction/induction.hpp"
+#include "../proof/proof.hpp"
+#include <span>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief proof records written out so that a proof can be replayed by another process
+ *
+ * the formulas of the record are stored in the flat format of certificates, the steps after them refer to their
+ * nodes. rules are stored by name and induction schemas by InductionSchemas::id, so replaying a loaded record needs
+ * the same rules registered and schemas built from the same types, and its content hash still matches, so it can be
+ * replayed trusted.
+ */
+std::string serialize_proof_record(const ProofRecord &record);
+
+/// schemas are the ones induction steps can refer to besides natural_induction() and strong_natural_induction(), they
+/// have to outlive the record. throws std::invalid_argument if the bytes aren't a proof record or a step refers to
+/// schemas that aren't given
+ProofRecord parse_proof_record(std::string_view bytes, std::span<InductionSchemas *const> schemas = {});
+
+void save_proof_record(const ProofRecord &record, const std::string &path);
+ProofRecord load_proof_record(const std::string &path, std::span<InductionSchemas *const> schemas = {});
+
+#endif // PROOF_RECORD_HPP
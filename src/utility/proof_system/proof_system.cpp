@@ -1,11 +1,16 @@
 #include "proof_system.hpp"
 
+#include <algorithm>
 #include <cctype>
+#include <exception>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <variant>
 #include <vector>
 #include <unordered_set>
@@ -43,6 +48,7 @@ TermPtr Term::make_function(const std::string &f, std::vector<TermPtr> args) {
 TermPtr Term::make_tuple(std::vector<TermPtr> args) { return std::make_shared<Term>(Term{TupleTerm{std::move(args)}}); }
 
 std::string Term::to_string() const {
+    count_node_visit();
     if (auto p = std::get_if<VariableTerm>(&data))
         return p->var;
     if (auto p = std::get_if<ConstantTerm>(&data))
@@ -129,6 +135,7 @@ FormulaPtr Formula::make_exists(const std::string &v, TermPtr domain, FormulaPtr
 }
 
 std::string Formula::to_string() const {
+    count_node_visit();
     if (auto p = std::get_if<EqualityFormula>(&data)) {
         return "(" + p->l->to_string() + " = " + p->r->to_string() + ")";
     }
@@ -220,11 +227,12 @@ bool Formula::is_well_formed(std::string *err) const {
 
 // ---------- Helper: check if variable occurs in a term ----------
 bool occurs_in_term(const std::string &v, TermPtr t) {
+    count_node_visit();
     if (!t)
         return false;
     if (auto p = std::get_if<VariableTerm>(&t->data))
         return p->var == v;
-    if (auto p = std::get_if<ConstantTerm>(&t->data))
+    if (std::holds_alternative<ConstantTerm>(t->data))
         return false;
     if (auto p = std::get_if<FunctionTerm>(&t->data)) {
         for (auto &arg : p->args) {
@@ -243,6 +251,7 @@ bool occurs_in_term(const std::string &v, TermPtr t) {
 
 // ---------- Free variable check ----------
 bool is_free_in(const std::string &v, FormulaPtr f) {
+    count_node_visit();
     if (!f)
         return false;
 
@@ -268,11 +277,15 @@ bool is_free_in(const std::string &v, FormulaPtr f) {
         return is_free_in(v, p->l) || is_free_in(v, p->r);
     }
     if (auto p = std::get_if<ForallFormula>(&f->data)) {
+        if (occurs_in_term(v, p->domain))
+            return true;
         if (p->v == v)
             return false; // bound by this quantifier
         return is_free_in(v, p->inner);
     }
     if (auto p = std::get_if<ExistsFormula>(&f->data)) {
+        if (occurs_in_term(v, p->domain))
+            return true;
         if (p->v == v)
             return false; // bound by this quantifier
         return is_free_in(v, p->inner);
@@ -323,19 +336,603 @@ void collect_vars_in_formula(FormulaPtr f, std::set<std::string> &vars) {
     }
 }
 
-// ---------- Check if formula is a sentence ----------
-bool is_sentence(FormulaPtr f) {
-    std::set<std::string> vars;
-    collect_vars_in_formula(f, vars);
-    for (const auto &v : vars) {
-        if (is_free_in(v, f))
+// ---------- Structural hashing ----------
+
+// FNV-1a, so that hashes do not depend on the standard library implementation
+static std::uint64_t hash_string(const std::string &s) {
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+std::uint64_t hash_combine(std::uint64_t seed, std::uint64_t value) {
+    // splitmix64 finalizer over the xor of both inputs, seed rotated so that combining is order dependent
+    std::uint64_t x = ((seed << 7) | (seed >> 57)) ^ value;
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// the variables bound by the quantifiers enclosing a subformula, innermost last
+using BinderScope = std::vector<const std::string *>;
+
+// how many binders out the variable is bound, or -1 if it's free
+static int binder_depth(const BinderScope &scope, const std::string &v) {
+    for (size_t i = scope.size(); i-- > 0;)
+        if (*scope[i] == v)
+            return (int)(scope.size() - 1 - i);
+    return -1;
+}
+
+static std::uint64_t hash_term_in(TermPtr t, const BinderScope &scope) {
+    count_node_visit();
+    if (!t)
+        return 0;
+    std::uint64_t h = t->data.index() + 1;
+    if (auto p = std::get_if<VariableTerm>(&t->data)) {
+        // bound variables are hashed by which binder they refer to, not by name
+        int depth = binder_depth(scope, p->var);
+        if (depth >= 0)
+            return hash_combine(h + 8, depth);
+        return hash_combine(h, hash_string(p->var));
+    }
+    if (auto p = std::get_if<ConstantTerm>(&t->data))
+        return hash_combine(h, hash_string(p->c));
+    if (auto p = std::get_if<FunctionTerm>(&t->data)) {
+        h = hash_combine(h, hash_string(p->f));
+        for (auto &arg : p->args)
+            h = hash_combine(h, hash_term_in(arg, scope));
+        return hash_combine(h, p->args.size());
+    }
+    if (auto p = std::get_if<TupleTerm>(&t->data)) {
+        for (auto &arg : p->args)
+            h = hash_combine(h, hash_term_in(arg, scope));
+        return hash_combine(h, p->args.size());
+    }
+    return h;
+}
+
+std::uint64_t hash_term(TermPtr t) { return hash_term_in(t, {}); }
+
+static std::uint64_t hash_formula_in(FormulaPtr f, BinderScope &scope);
+
+// hashes the node itself, subformulas go through hash_formula_in
+static std::uint64_t hash_formula_node(FormulaPtr f, BinderScope &scope) {
+    count_node_visit();
+    // offset the tags so that formulas never share a tag with terms
+    std::uint64_t h = f->data.index() + 16;
+    if (auto p = std::get_if<EqualityFormula>(&f->data))
+        return hash_combine(hash_combine(h, hash_term_in(p->l, scope)), hash_term_in(p->r, scope));
+    if (auto p = std::get_if<RelationFormula>(&f->data)) {
+        h = hash_combine(h, hash_string(p->R));
+        for (auto &arg : p->args)
+            h = hash_combine(h, hash_term_in(arg, scope));
+        return hash_combine(h, p->args.size());
+    }
+    if (auto p = std::get_if<NotFormula>(&f->data))
+        return hash_combine(h, hash_formula_in(p->inner, scope));
+    if (auto p = std::get_if<OrFormula>(&f->data))
+        return hash_combine(hash_combine(h, hash_formula_in(p->l, scope)), hash_formula_in(p->r, scope));
+    if (auto p = std::get_if<AndFormula>(&f->data))
+        return hash_combine(hash_combine(h, hash_formula_in(p->l, scope)), hash_formula_in(p->r, scope));
+    if (auto p = std::get_if<ImpliesFormula>(&f->data))
+        return hash_combine(hash_combine(h, hash_formula_in(p->l, scope)), hash_formula_in(p->r, scope));
+
+    const std::string *v = nullptr;
+    TermPtr domain;
+    FormulaPtr inner;
+    if (auto p = std::get_if<ForallFormula>(&f->data))
+        v = &p->v, domain = p->domain, inner = p->inner;
+    else if (auto p = std::get_if<ExistsFormula>(&f->data))
+        v = &p->v, domain = p->domain, inner = p->inner;
+    else
+        return h;
+
+    // the domain is outside the scope of the binder, the bound variable's name isn't part of the hash
+    h = hash_combine(h, hash_term_in(domain, scope));
+    scope.push_back(v);
+    h = hash_combine(h, hash_formula_in(inner, scope));
+    scope.pop_back();
+    return h;
+}
+
+static std::uint64_t hash_formula_in(FormulaPtr f, BinderScope &scope) {
+    if (!f)
+        return 0;
+    // outside of any binder the hash doesn't depend on context, so it can go through the cache
+    if (scope.empty())
+        return hash_formula(f);
+    return hash_formula_node(f, scope);
+}
+
+std::uint64_t hash_formula(FormulaPtr f) {
+    if (!f)
+        return 0;
+    std::uint64_t cached = f->cached_hash.value.load(std::memory_order_relaxed);
+    if (cached != 0)
+        return cached;
+
+    BinderScope scope;
+    std::uint64_t h = hash_formula_node(f, scope);
+    // zero marks an empty cache
+    h = h == 0 ? 1 : h;
+    f->cached_hash.value.store(h, std::memory_order_relaxed);
+    return h;
+}
+
+// ---------- Structural equality (no string building) ----------
+
+static bool term_lists_equal(const std::vector<TermPtr> &a, const std::vector<TermPtr> &b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i)
+        if (!terms_equal(a[i], b[i]))
+            return false;
+    return true;
+}
+
+bool terms_equal(TermPtr a, TermPtr b) {
+    count_node_visit();
+    if (a == b)
+        return true;
+    if (!a || !b || a->data.index() != b->data.index())
+        return false;
+    if (auto p = std::get_if<VariableTerm>(&a->data))
+        return p->var == std::get<VariableTerm>(b->data).var;
+    if (auto p = std::get_if<ConstantTerm>(&a->data))
+        return p->c == std::get<ConstantTerm>(b->data).c;
+    if (auto p = std::get_if<FunctionTerm>(&a->data)) {
+        auto &q = std::get<FunctionTerm>(b->data);
+        return p->f == q.f && term_lists_equal(p->args, q.args);
+    }
+    if (auto p = std::get_if<TupleTerm>(&a->data))
+        return term_lists_equal(p->args, std::get<TupleTerm>(b->data).args);
+    return false;
+}
+
+bool formulas_equal(FormulaPtr a, FormulaPtr b) {
+    count_node_visit();
+    if (a == b)
+        return true;
+    if (!a || !b || a->data.index() != b->data.index())
+        return false;
+    if (auto p = std::get_if<EqualityFormula>(&a->data)) {
+        auto &q = std::get<EqualityFormula>(b->data);
+        return terms_equal(p->l, q.l) && terms_equal(p->r, q.r);
+    }
+    if (auto p = std::get_if<RelationFormula>(&a->data)) {
+        auto &q = std::get<RelationFormula>(b->data);
+        return p->R == q.R && term_lists_equal(p->args, q.args);
+    }
+    if (auto p = std::get_if<NotFormula>(&a->data))
+        return formulas_equal(p->inner, std::get<NotFormula>(b->data).inner);
+    if (auto p = std::get_if<OrFormula>(&a->data)) {
+        auto &q = std::get<OrFormula>(b->data);
+        return formulas_equal(p->l, q.l) && formulas_equal(p->r, q.r);
+    }
+    if (auto p = std::get_if<AndFormula>(&a->data)) {
+        auto &q = std::get<AndFormula>(b->data);
+        return formulas_equal(p->l, q.l) && formulas_equal(p->r, q.r);
+    }
+    if (auto p = std::get_if<ImpliesFormula>(&a->data)) {
+        auto &q = std::get<ImpliesFormula>(b->data);
+        return formulas_equal(p->l, q.l) && formulas_equal(p->r, q.r);
+    }
+    if (auto p = std::get_if<ForallFormula>(&a->data)) {
+        auto &q = std::get<ForallFormula>(b->data);
+        return p->v == q.v && terms_equal(p->domain, q.domain) && formulas_equal(p->inner, q.inner);
+    }
+    if (auto p = std::get_if<ExistsFormula>(&a->data)) {
+        auto &q = std::get<ExistsFormula>(b->data);
+        return p->v == q.v && terms_equal(p->domain, q.domain) && formulas_equal(p->inner, q.inner);
+    }
+    return false;
+}
+
+// ---------- Alpha equivalence ----------
+
+// both scopes always have the same length, a pair of variables match if they are bound by the same binder pair, or
+// are both free and have the same name
+static bool alpha_terms(TermPtr a, TermPtr b, const BinderScope &scope_a, const BinderScope &scope_b) {
+    count_node_visit();
+    if (a == b && scope_a.empty())
+        return true;
+    if (!a || !b || a->data.index() != b->data.index())
+        return false;
+    if (auto p = std::get_if<VariableTerm>(&a->data)) {
+        auto &q = std::get<VariableTerm>(b->data);
+        int depth = binder_depth(scope_a, p->var);
+        if (depth != binder_depth(scope_b, q.var))
             return false;
+        return depth >= 0 || p->var == q.var;
     }
+    if (auto p = std::get_if<ConstantTerm>(&a->data))
+        return p->c == std::get<ConstantTerm>(b->data).c;
+
+    const std::vector<TermPtr> *args_a, *args_b;
+    if (auto p = std::get_if<FunctionTerm>(&a->data)) {
+        auto &q = std::get<FunctionTerm>(b->data);
+        if (p->f != q.f)
+            return false;
+        args_a = &p->args, args_b = &q.args;
+    } else {
+        args_a = &std::get<TupleTerm>(a->data).args, args_b = &std::get<TupleTerm>(b->data).args;
+    }
+    if (args_a->size() != args_b->size())
+        return false;
+    for (size_t i = 0; i < args_a->size(); ++i)
+        if (!alpha_terms((*args_a)[i], (*args_b)[i], scope_a, scope_b))
+            return false;
     return true;
 }
 
+static bool alpha_formulas(FormulaPtr a, FormulaPtr b, BinderScope &scope_a, BinderScope &scope_b) {
+    count_node_visit();
+    if (!a || !b)
+        return a == b;
+    if (scope_a.empty()) {
+        // the cached hashes are alpha invariant, so they can only differ for formulas that aren't equivalent
+        if (a == b)
+            return true;
+        if (hash_formula(a) != hash_formula(b))
+            return false;
+    }
+    if (a->data.index() != b->data.index())
+        return false;
+
+    if (auto p = std::get_if<EqualityFormula>(&a->data)) {
+        auto &q = std::get<EqualityFormula>(b->data);
+        return alpha_terms(p->l, q.l, scope_a, scope_b) && alpha_terms(p->r, q.r, scope_a, scope_b);
+    }
+    if (auto p = std::get_if<RelationFormula>(&a->data)) {
+        auto &q = std::get<RelationFormula>(b->data);
+        if (p->R != q.R || p->args.size() != q.args.size())
+            return false;
+        for (size_t i = 0; i < p->args.size(); ++i)
+            if (!alpha_terms(p->args[i], q.args[i], scope_a, scope_b))
+                return false;
+        return true;
+    }
+    if (auto p = std::get_if<NotFormula>(&a->data))
+        return alpha_formulas(p->inner, std::get<NotFormula>(b->data).inner, scope_a, scope_b);
+    if (auto p = std::get_if<OrFormula>(&a->data)) {
+        auto &q = std::get<OrFormula>(b->data);
+        return alpha_formulas(p->l, q.l, scope_a, scope_b) && alpha_formulas(p->r, q.r, scope_a, scope_b);
+    }
+    if (auto p = std::get_if<AndFormula>(&a->data)) {
+        auto &q = std::get<AndFormula>(b->data);
+        return alpha_formulas(p->l, q.l, scope_a, scope_b) && alpha_formulas(p->r, q.r, scope_a, scope_b);
+    }
+    if (auto p = std::get_if<ImpliesFormula>(&a->data)) {
+        auto &q = std::get<ImpliesFormula>(b->data);
+        return alpha_formulas(p->l, q.l, scope_a, scope_b) && alpha_formulas(p->r, q.r, scope_a, scope_b);
+    }
+
+    auto quantifier_parts = [](FormulaPtr f) -> std::tuple<const std::string *, TermPtr, FormulaPtr> {
+        if (auto p = std::get_if<ForallFormula>(&f->data))
+            return {&p->v, p->domain, p->inner};
+        auto &q = std::get<ExistsFormula>(f->data);
+        return {&q.v, q.domain, q.inner};
+    };
+    auto [v_a, domain_a, inner_a] = quantifier_parts(a);
+    auto [v_b, domain_b, inner_b] = quantifier_parts(b);
+    if (!alpha_terms(domain_a, domain_b, scope_a, scope_b))
+        return false;
+    scope_a.push_back(v_a);
+    scope_b.push_back(v_b);
+    bool equivalent = alpha_formulas(inner_a, inner_b, scope_a, scope_b);
+    scope_a.pop_back();
+    scope_b.pop_back();
+    return equivalent;
+}
+
+bool alpha_equivalent(FormulaPtr a, FormulaPtr b) {
+    BinderScope scope_a, scope_b;
+    return alpha_formulas(a, b, scope_a, scope_b);
+}
+
+// ---------- Signature & fused validation ----------
+
+Signature Signature::builtin() {
+    Signature signature;
+    signature.constants = {"0", "1"};
+    signature.functions = {{"succ", 1}, {"+", 2}, {"*", 2}};
+    signature.relations = {{"<", 2}};
+    signature.strict_variable_names = true;
+    return signature;
+}
+
+std::string ValidationError::to_string() const {
+    std::string at = "at ";
+    for (size_t i = 0; i < position.size(); ++i) {
+        if (i)
+            at += '.';
+        at += std::to_string(position[i]);
+    }
+    if (position.empty())
+        at += "root";
+    return at + ": " + message;
+}
+
+namespace {
+
+/**
+ * @brief one walk over a formula that does the work of is_well_formed, is_sentence and hash_formula together, hashes
+ * are computed exactly as hash_formula does and cached the same way
+ */
+class Validator {
+  public:
+    Validator(const Signature &signature, FormulaReport &report) : signature(signature), report(report) {}
+
+    void run(const FormulaPtr &f) {
+        report = {};
+        std::set<std::string> free_variables;
+        free = &free_variables;
+        report.hash = formula(f);
+        report.free_variables.assign(free_variables.begin(), free_variables.end());
+        report.is_sentence = free_variables.empty();
+    }
+
+  private:
+    const Signature &signature;
+    FormulaReport &report;
+    std::set<std::string> *free = nullptr;
+    BinderScope scope;
+    std::vector<std::uint32_t> position;
+
+    void error(std::string message) { report.errors.push_back({position, std::move(message)}); }
+
+    void visit_node() {
+        ++report.size;
+        report.depth = std::max(report.depth, position.size() + 1);
+    }
+
+    void check_variable_name(const std::string &v) {
+        if (signature.strict_variable_names && !is_variable(v))
+            error("bad variable name " + v);
+    }
+
+    void check_arity(const std::unordered_map<std::string, size_t> &symbols, const std::string &kind,
+                     const std::string &name, size_t arity) {
+        auto it = symbols.find(name);
+        if (it == symbols.end())
+            error("unknown " + kind + " " + name);
+        else if (it->second != arity)
+            error(kind + " " + name + " takes " + std::to_string(it->second) +
+                  (it->second == 1 ? " argument, not " : " arguments, not ") + std::to_string(arity));
+    }
+
+    std::uint64_t child_term(std::uint32_t i, const TermPtr &t) {
+        position.push_back(i);
+        std::uint64_t h = term(t);
+        position.pop_back();
+        return h;
+    }
+
+    std::uint64_t child_formula(std::uint32_t i, const FormulaPtr &f) {
+        position.push_back(i);
+        std::uint64_t h = formula(f);
+        position.pop_back();
+        return h;
+    }
+
+    // mirrors hash_term_in
+    std::uint64_t term(const TermPtr &t) {
+        if (!t) {
+            error("missing term");
+            return 0;
+        }
+        visit_node();
+        std::uint64_t h = t->data.index() + 1;
+        if (auto p = std::get_if<VariableTerm>(&t->data)) {
+            check_variable_name(p->var);
+            int depth = binder_depth(scope, p->var);
+            if (depth >= 0)
+                return hash_combine(h + 8, depth);
+            free->insert(p->var);
+            return hash_combine(h, hash_string(p->var));
+        }
+        if (auto p = std::get_if<ConstantTerm>(&t->data)) {
+            if (!signature.constants.count(p->c))
+                error("unknown constant " + p->c);
+            return hash_combine(h, hash_string(p->c));
+        }
+        if (auto p = std::get_if<FunctionTerm>(&t->data)) {
+            check_arity(signature.functions, "function", p->f, p->args.size());
+            h = hash_combine(h, hash_string(p->f));
+            for (size_t i = 0; i < p->args.size(); ++i)
+                h = hash_combine(h, child_term((std::uint32_t)i, p->args[i]));
+            return hash_combine(h, p->args.size());
+        }
+        if (auto p = std::get_if<TupleTerm>(&t->data)) {
+            for (size_t i = 0; i < p->args.size(); ++i)
+                h = hash_combine(h, child_term((std::uint32_t)i, p->args[i]));
+            return hash_combine(h, p->args.size());
+        }
+        return h;
+    }
+
+    // mirrors hash_formula_in and hash_formula, caching the hash of every subformula outside of any binder
+    std::uint64_t formula(const FormulaPtr &f) {
+        if (!f) {
+            error("missing formula");
+            return 0;
+        }
+        std::uint64_t h = formula_node(f);
+        if (!scope.empty())
+            return h;
+        h = h == 0 ? 1 : h;
+        f->cached_hash.value.store(h, std::memory_order_relaxed);
+        return h;
+    }
+
+    // mirrors hash_formula_node
+    std::uint64_t formula_node(const FormulaPtr &f) {
+        visit_node();
+        std::uint64_t h = f->data.index() + 16;
+        if (auto p = std::get_if<EqualityFormula>(&f->data))
+            return hash_combine(hash_combine(h, child_term(0, p->l)), child_term(1, p->r));
+        if (auto p = std::get_if<RelationFormula>(&f->data)) {
+            check_arity(signature.relations, "relation", p->R, p->args.size());
+            h = hash_combine(h, hash_string(p->R));
+            for (size_t i = 0; i < p->args.size(); ++i)
+                h = hash_combine(h, child_term((std::uint32_t)i, p->args[i]));
+            return hash_combine(h, p->args.size());
+        }
+        if (auto p = std::get_if<NotFormula>(&f->data))
+            return hash_combine(h, child_formula(0, p->inner));
+        if (auto p = std::get_if<OrFormula>(&f->data))
+            return hash_combine(hash_combine(h, child_formula(0, p->l)), child_formula(1, p->r));
+        if (auto p = std::get_if<AndFormula>(&f->data))
+            return hash_combine(hash_combine(h, child_formula(0, p->l)), child_formula(1, p->r));
+        if (auto p = std::get_if<ImpliesFormula>(&f->data))
+            return hash_combine(hash_combine(h, child_formula(0, p->l)), child_formula(1, p->r));
+
+        const std::string *v = nullptr;
+        TermPtr domain;
+        FormulaPtr inner;
+        if (auto p = std::get_if<ForallFormula>(&f->data))
+            v = &p->v, domain = p->domain, inner = p->inner;
+        else if (auto p = std::get_if<ExistsFormula>(&f->data))
+            v = &p->v, domain = p->domain, inner = p->inner;
+        else
+            return h;
+
+        check_variable_name(*v);
+        h = hash_combine(h, child_term(0, domain));
+        scope.push_back(v);
+        h = hash_combine(h, child_formula(1, inner));
+        scope.pop_back();
+        return h;
+    }
+};
+
+// one pass over f that stops at the first free variable
+bool has_free_variable(const FormulaPtr &f, BinderScope &scope);
+
+bool has_free_variable(const TermPtr &t, const BinderScope &scope) {
+    count_node_visit();
+    if (!t)
+        return false;
+    if (auto p = std::get_if<VariableTerm>(&t->data))
+        return binder_depth(scope, p->var) < 0;
+    const std::vector<TermPtr> *args = nullptr;
+    if (auto p = std::get_if<FunctionTerm>(&t->data))
+        args = &p->args;
+    else if (auto p = std::get_if<TupleTerm>(&t->data))
+        args = &p->args;
+    if (args)
+        for (const TermPtr &arg : *args)
+            if (has_free_variable(arg, scope))
+                return true;
+    return false;
+}
+
+bool has_free_variable(const FormulaPtr &f, BinderScope &scope) {
+    count_node_visit();
+    if (!f)
+        return false;
+    if (auto p = std::get_if<EqualityFormula>(&f->data))
+        return has_free_variable(p->l, scope) || has_free_variable(p->r, scope);
+    if (auto p = std::get_if<RelationFormula>(&f->data)) {
+        for (const TermPtr &arg : p->args)
+            if (has_free_variable(arg, scope))
+                return true;
+        return false;
+    }
+    if (auto p = std::get_if<NotFormula>(&f->data))
+        return has_free_variable(p->inner, scope);
+    if (auto p = std::get_if<OrFormula>(&f->data))
+        return has_free_variable(p->l, scope) || has_free_variable(p->r, scope);
+    if (auto p = std::get_if<AndFormula>(&f->data))
+        return has_free_variable(p->l, scope) || has_free_variable(p->r, scope);
+    if (auto p = std::get_if<ImpliesFormula>(&f->data))
+        return has_free_variable(p->l, scope) || has_free_variable(p->r, scope);
+
+    const std::string *v = nullptr;
+    TermPtr domain;
+    FormulaPtr inner;
+    if (auto p = std::get_if<ForallFormula>(&f->data))
+        v = &p->v, domain = p->domain, inner = p->inner;
+    else if (auto p = std::get_if<ExistsFormula>(&f->data))
+        v = &p->v, domain = p->domain, inner = p->inner;
+    else
+        return false;
+
+    // the domain is outside of the binder, as in is_free_in and the Validator
+    if (has_free_variable(domain, scope))
+        return true;
+    scope.push_back(v);
+    bool found = has_free_variable(inner, scope);
+    scope.pop_back();
+    return found;
+}
+
+} // namespace
+
+bool is_sentence(FormulaPtr f) {
+    BinderScope scope;
+    return !has_free_variable(f, scope);
+}
+
+FormulaReport validate_formula(const FormulaPtr &f, const Signature &signature) {
+    FormulaReport report;
+    Validator(signature, report).run(f);
+    return report;
+}
+
+std::vector<FormulaReport> validate_formulas(const std::vector<FormulaPtr> &formulas, const Signature &signature,
+                                             unsigned num_threads) {
+    // formulas a thread claims at a time
+    constexpr size_t chunk_size = 64;
+
+    std::vector<FormulaReport> reports(formulas.size());
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    num_threads = (unsigned)std::min<size_t>(num_threads, (formulas.size() + chunk_size - 1) / chunk_size);
+
+    std::atomic<size_t> next_chunk{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        try {
+            for (;;) {
+                size_t start = next_chunk.fetch_add(chunk_size);
+                if (start >= formulas.size())
+                    return;
+                size_t end = std::min(start + chunk_size, formulas.size());
+                for (size_t i = start; i < end; ++i)
+                    Validator(signature, reports[i]).run(formulas[i]);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            // stop the other threads
+            next_chunk = formulas.size();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 1; t < num_threads; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+    return reports;
+}
+
 // ---------- Substitute all occurrences of 'pattern' with 'replacement' in term 'u' ----------
 TermPtr substitute_term_in_term(TermPtr u, TermPtr pattern, TermPtr replacement) {
+    count_node_visit();
     if (!u)
         return nullptr;
 
@@ -374,6 +971,7 @@ TermPtr substitute_term_in_term(TermPtr u, TermPtr pattern, TermPtr replacement)
 
 // ---------- Substitute term 'pattern' with 'replacement' in formula 'phi' ----------
 FormulaPtr substitute_term_in_formula(FormulaPtr phi, TermPtr pattern, TermPtr replacement) {
+    count_node_visit();
     if (!phi)
         return nullptr;
 
@@ -426,6 +1024,7 @@ FormulaPtr substitute_term_in_formula(FormulaPtr phi, TermPtr pattern, TermPtr r
 
 // ---------- Substitute variable var with term t in term u ----------
 TermPtr substitute_in_term(TermPtr u, TermPtr var, TermPtr t) {
+    count_node_visit();
     if (!u)
         return nullptr;
 
@@ -455,6 +1054,7 @@ TermPtr substitute_in_term(TermPtr u, TermPtr var, TermPtr t) {
 // ----------
 
 FormulaPtr substitute_in_formula(FormulaPtr phi, TermPtr var, TermPtr t) {
+    count_node_visit();
     if (!phi)
         return nullptr;
 
@@ -514,14 +1114,12 @@ FormulaPtr substitute_in_formula(FormulaPtr phi, TermPtr var, TermPtr t) {
 // ---------- Check if term t is substitutable for variable var in formula phi
 // ----------
 bool is_substitutable(FormulaPtr phi, TermPtr var, TermPtr t) {
+    count_node_visit();
     if (!phi || !var || !t)
         return false;
 
     // Atomic formulas: always safe
-    if (auto p = std::get_if<EqualityFormula>(&phi->data)) {
-        return true;
-    }
-    if (auto p = std::get_if<RelationFormula>(&phi->data)) {
+    if (std::holds_alternative<EqualityFormula>(phi->data) || std::holds_alternative<RelationFormula>(phi->data)) {
         return true;
     }
 
@@ -548,7 +1146,8 @@ bool is_substitutable(FormulaPtr phi, TermPtr var, TermPtr t) {
         std::string x_name = std::get<VariableTerm>(var->data).var;
         std::string y_name = p->v;
 
-        if (!is_free_in(x_name, phi))
+        // the domain isn't under the binder, so only the body can capture
+        if (x_name == y_name || !is_free_in(x_name, p->inner))
             return true;                // condition 4(a)
         if (!occurs_in_term(y_name, t)) // condition 4(b)
             return is_substitutable(p->inner, var, t);
@@ -560,7 +1159,7 @@ bool is_substitutable(FormulaPtr phi, TermPtr var, TermPtr t) {
         std::string x_name = std::get<VariableTerm>(var->data).var;
         std::string y_name = p->v;
 
-        if (!is_free_in(x_name, phi))
+        if (x_name == y_name || !is_free_in(x_name, p->inner))
             return true;
         if (!occurs_in_term(y_name, t))
             return is_substitutable(p->inner, var, t);
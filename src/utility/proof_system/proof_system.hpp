@@ -1,9 +1,13 @@
 #ifndef PROOF_SYSTEM_HPP
 #define PROOF_SYSTEM_HPP
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <variant>
 #include <vector>
 
@@ -14,6 +18,16 @@ bool is_function(const std::string &s, int arity);
 // bool is_tuple(std::string &s, int arity);
 bool is_relation(const std::string &s, int arity);
 
+// ---------- Node visits ----------
+// the term and formula nodes the traversals in proof_system.cpp looked at, a measure of work that doesn't depend on the
+// machine. only counted when MWE_COUNT_NODE_VISITS is defined, as it is for perf_fuzz, so other builds don't pay for it
+#ifdef MWE_COUNT_NODE_VISITS
+inline std::atomic<std::uint64_t> node_visits{0};
+inline void count_node_visit() { node_visits.fetch_add(1, std::memory_order_relaxed); }
+#else
+inline void count_node_visit() {}
+#endif
+
 // ---------- Terms ----------
 struct Term;
 using TermPtr = std::shared_ptr<Term>;
@@ -52,6 +66,18 @@ struct Term {
 struct Formula;
 using FormulaPtr = std::shared_ptr<Formula>;
 
+// a hash computed on first use, copying a formula doesn't copy it so a copy can be modified before it's hashed
+struct CachedHash {
+    mutable std::atomic<std::uint64_t> value{0};
+
+    CachedHash() = default;
+    CachedHash(const CachedHash &) {}
+    CachedHash &operator=(const CachedHash &) {
+        value.store(0, std::memory_order_relaxed);
+        return *this;
+    }
+};
+
 struct EqualityFormula {
     TermPtr l, r;
 };
@@ -94,6 +120,8 @@ struct Formula {
     using variant_t = std::variant<EqualityFormula, RelationFormula, NotFormula, OrFormula, AndFormula, ImpliesFormula,
                                    ForallFormula, ExistsFormula>;
     variant_t data;
+    // hash_formula's result, a formula must not be modified once it has been hashed
+    CachedHash cached_hash{};
 
     static FormulaPtr make_eq(TermPtr a, TermPtr b);
     static FormulaPtr make_rel(const std::string &R, std::vector<TermPtr> args);
@@ -110,11 +138,79 @@ struct Formula {
 
 // ---------- Term & Formula helpers ----------
 bool occurs_in_term(const std::string &v, TermPtr t);
+// a quantifier's domain is outside of its binder, so the variables of a domain are free unless an outer quantifier binds
+// them. is_free_in, is_sentence and validate_formula all count them that way
 bool is_free_in(const std::string &v, FormulaPtr f);
 void collect_vars_in_term(TermPtr t, std::set<std::string> &vars);
 void collect_vars_in_formula(FormulaPtr f, std::set<std::string> &vars);
 bool is_sentence(FormulaPtr f);
 
+// ---------- Structural hashing & equality ----------
+
+/**
+ * @brief deterministic structural hashes, stable across processes so they can be used as content keys
+ *
+ * hash_formula is alpha invariant, bound variables are hashed by which quantifier binds them rather than by name, so
+ * alpha equivalent formulas hash the same. it is cached on the formula.
+ */
+std::uint64_t hash_term(TermPtr t);
+std::uint64_t hash_formula(FormulaPtr f);
+std::uint64_t hash_combine(std::uint64_t seed, std::uint64_t value);
+
+bool terms_equal(TermPtr a, TermPtr b);
+bool formulas_equal(FormulaPtr a, FormulaPtr b);
+
+/**
+ * @brief equal up to the names of bound variables, e.g. (∀n ∈ ℕ)(P(n)) and (∀m ∈ ℕ)(P(m)), done in one traversal
+ * of both formulas, and rejected in O(1) through the cached hashes when they differ
+ */
+bool alpha_equivalent(FormulaPtr a, FormulaPtr b);
+
+// ---------- Signature & fused validation ----------
+
+/// the symbols formulas may use, with their arities, anything not declared is an error
+struct Signature {
+    std::unordered_map<std::string, size_t> functions;
+    std::unordered_map<std::string, size_t> relations;
+    std::unordered_set<std::string> constants;
+    // when set, variables have to be named the way is_variable wants
+    bool strict_variable_names = false;
+
+    /// the fixed language of is_constant, is_function, is_relation and is_variable
+    static Signature builtin();
+};
+
+struct ValidationError {
+    // child indices from the root, arguments of terms included, a quantifier's domain is child 0 and its body child 1
+    std::vector<std::uint32_t> position;
+    std::string message;
+
+    std::string to_string() const;
+};
+
+struct FormulaReport {
+    std::vector<ValidationError> errors;
+    // sorted
+    std::vector<std::string> free_variables;
+    bool is_sentence = true;
+    // nodes, terms included
+    size_t size = 0;
+    size_t depth = 0;
+    // what hash_formula returns, which is now cached on the formula
+    std::uint64_t hash = 0;
+
+    bool valid() const { return errors.empty(); }
+};
+
+/**
+ * @brief checks f against the signature, collects its free variables and measures it, all in one traversal, every
+ * error is reported rather than just the first
+ */
+FormulaReport validate_formula(const FormulaPtr &f, const Signature &signature);
+/// validate_formula on each formula, spread over num_threads threads (0 for one per core)
+std::vector<FormulaReport> validate_formulas(const std::vector<FormulaPtr> &formulas, const Signature &signature,
+                                             unsigned num_threads = 0);
+
 // ---------- Substitution ----------
 
 TermPtr substitute_term_in_term(TermPtr u, TermPtr pattern, TermPtr replacement);
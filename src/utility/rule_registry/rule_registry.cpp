@@ -0,0 +1,46 @@
+#include "rule_registry.hpp"
+#include "../proof/proof.hpp"
+#include <stdexcept>
+
+RuleRegistry::RuleRegistry() {
+    add_rule("ASSUMPTION", nullptr);
+    add_rule("LEMMA", nullptr);
+}
+
+const RuleRegistry &RuleRegistry::builtin() {
+    // initialised once, thread safe, and never modified afterwards
+    static const RuleRegistry registry = [] {
+        RuleRegistry r;
+        r.add_rule("IMPLIES", implies_rule);
+        r.add_rule("FORALL", forall_rule);
+        r.add_rule("EQ", eq_rule);
+        r.add_rule("EQ_SYM", eq_sym_rule);
+        r.add_rule("EQ_TRANS", eq_trans_rule);
+        r.add_rule("EQ_CONG", eq_cong_rule);
+        r.add_rule("SUBST", subst_rule);
+        r.add_rule("AND", and_rule);
+        r.add_rule("INDUCTION", induction_rule);
+        r.add_rule("STRONG_INDUCTION", strong_induction_rule);
+        r.add_rule("LEM", excluded_middle_rule);
+        r.add_rule("CASES", cases_rule);
+        r.add_rule("EQUIV", equiv_rule);
+        return r;
+    }();
+    return registry;
+}
+
+RuleId RuleRegistry::add_rule(const std::string &name, LineRule rule) {
+    auto [it, inserted] = ids.emplace(name, (RuleId)names.size());
+    if (!inserted)
+        throw std::invalid_argument("Rule " + name + " is already registered");
+    names.push_back(name);
+    rules.push_back(std::move(rule));
+    return it->second;
+}
+
+std::optional<RuleId> RuleRegistry::find(const std::string &name) const {
+    auto it = ids.find(name);
+    if (it == ids.end())
+        return std::nullopt;
+    return it->second;
+}
@@ -0,0 +1,49 @@
+#ifndef RULE_REGISTRY_HPP
+#define RULE_REGISTRY_HPP
+
+#include "../proof_system/proof_system.hpp"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using RuleId = std::uint32_t;
+
+using LineRule = std::function<FormulaPtr(const std::vector<FormulaPtr> &, FormulaPtr)>;
+
+// these two depend on the state of the proof using them, so they have no LineRule and the Proof checks them itself
+constexpr RuleId assumption_rule_id = 0;
+constexpr RuleId lemma_rule_id = 1;
+
+/**
+ * @brief rule names mapped to ids and LineRules, built once and then shared by every Proof that uses it
+ *
+ * proofs only hold a pointer to a registry, so constructing a proof doesn't build any rule state. every registry
+ * starts with ASSUMPTION and LEMMA at assumption_rule_id and lemma_rule_id. to add rules of your own either copy
+ * builtin() into a registry that outlives your proofs, or use Proof::register_rule for a single proof.
+ */
+class RuleRegistry {
+  public:
+    RuleRegistry();
+
+    /// ASSUMPTION, LEMMA, IMPLIES, FORALL, EQ, EQ_SYM, EQ_TRANS, EQ_CONG, SUBST, AND, INDUCTION, STRONG_INDUCTION, LEM,
+    /// CASES and EQUIV, built on first use
+    static const RuleRegistry &builtin();
+
+    /// throws std::invalid_argument if a rule with that name is already registered
+    RuleId add_rule(const std::string &name, LineRule rule);
+
+    std::optional<RuleId> find(const std::string &name) const;
+    const LineRule &rule(RuleId id) const { return rules[id]; }
+    const std::string &name(RuleId id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
+  private:
+    std::unordered_map<std::string, RuleId> ids;
+    std::vector<std::string> names;
+    std::vector<LineRule> rules;
+};
+
+#endif // RULE_REGISTRY_HPP
@@ -0,0 +1,278 @@
+#include "shared_formula_store.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char store_magic[8] = {'M', 'W', 'E', 'F', 'S', 'T', 'O', 'R'};
+constexpr std::uint32_t store_version = 1;
+
+static_assert(std::is_trivially_copyable_v<FlatNode> && sizeof(FlatNode) == 16, "FlatNode is stored as is");
+
+// followed by the sections of StoreLayout, each starting on an 8 byte boundary
+struct StoreHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t node_count;
+    std::uint64_t child_count;
+    std::uint64_t symbol_count;
+    std::uint64_t symbol_text_size;
+    std::uint64_t root_count;
+    std::uint64_t symbol_index_capacity; // both capacities are powers of two
+    std::uint64_t node_index_capacity;
+};
+
+// byte offsets of the sections, symbol i is symbol_text[symbol_offsets[i], symbol_offsets[i + 1]) and index slots
+// hold id + 1, zero marking an empty slot
+struct StoreLayout {
+    std::uint64_t nodes;
+    std::uint64_t children;
+    std::uint64_t symbol_offsets;
+    std::uint64_t symbol_text;
+    std::uint64_t roots;
+    std::uint64_t symbol_index;
+    std::uint64_t node_index;
+    std::uint64_t size;
+};
+
+std::uint64_t padded(std::uint64_t n) { return (n + 7) & ~std::uint64_t(7); }
+
+StoreLayout layout_of(const StoreHeader &h) {
+    StoreLayout l;
+    l.nodes = sizeof(StoreHeader);
+    l.children = padded(l.nodes + h.node_count * sizeof(FlatNode));
+    l.symbol_offsets = padded(l.children + h.child_count * sizeof(std::uint32_t));
+    l.symbol_text = padded(l.symbol_offsets + (h.symbol_count + 1) * sizeof(std::uint32_t));
+    l.roots = padded(l.symbol_text + h.symbol_text_size);
+    l.symbol_index = padded(l.roots + h.root_count * sizeof(std::uint32_t));
+    l.node_index = padded(l.symbol_index + h.symbol_index_capacity * sizeof(std::uint32_t));
+    l.size = padded(l.node_index + h.node_index_capacity * sizeof(std::uint32_t));
+    return l;
+}
+
+std::uint64_t index_capacity(std::uint64_t count) {
+    std::uint64_t capacity = 8;
+    while (capacity < 2 * count)
+        capacity *= 2;
+    return capacity;
+}
+
+std::uint64_t hash_symbol(std::string_view name) {
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : name)
+        h = (h ^ c) * 0x100000001b3ull;
+    return h;
+}
+
+// mixed at the end, ids are small and consecutive and would otherwise fill runs of slots in the linear probing
+std::uint64_t hash_node(NodeKind kind, std::uint32_t symbol, std::span<const std::uint32_t> node_children) {
+    std::uint64_t h = ((std::uint64_t)kind << 32) ^ symbol;
+    for (std::uint32_t c : node_children)
+        h = (h ^ c) * 0x9e3779b97f4a7c15ull + (h >> 29);
+    h ^= node_children.size();
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+void insert_slot(std::uint32_t *slots, std::uint64_t capacity, std::uint64_t h, std::uint32_t id) {
+    for (std::uint64_t i = h & (capacity - 1);; i = (i + 1) & (capacity - 1)) {
+        if (slots[i] == 0) {
+            slots[i] = id + 1;
+            return;
+        }
+    }
+}
+
+template <typename T> T *section(std::byte *base, std::uint64_t offset) { return reinterpret_cast<T *>(base + offset); }
+
+template <typename T> std::span<const T> section(const std::byte *base, std::uint64_t offset, std::uint64_t count) {
+    return {reinterpret_cast<const T *>(base + offset), count};
+}
+
+[[noreturn]] void throw_system_error(const std::string &what, const std::string &name) {
+    throw std::runtime_error(what + " " + name + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+void SharedFormulaStore::create(const std::string &name, const FlatFormulaTable &table,
+                                std::span<const std::uint32_t> roots, Backing backing) {
+    for (std::uint32_t root : roots)
+        if (root >= table.nodes.size())
+            throw std::invalid_argument("SharedFormulaStore: root " + std::to_string(root) + " is not a node");
+
+    StoreHeader header{};
+    header.version = store_version;
+    header.node_count = table.nodes.size();
+    header.child_count = table.children.size();
+    header.symbol_count = table.symbols.size();
+    for (const std::string &symbol : table.symbols)
+        header.symbol_text_size += symbol.size();
+    header.root_count = roots.size();
+    header.symbol_index_capacity = index_capacity(header.symbol_count);
+    header.node_index_capacity = index_capacity(header.node_count);
+    if (header.symbol_text_size > 0xffffffffull)
+        throw std::invalid_argument("SharedFormulaStore: symbol names too long to store");
+    StoreLayout layout = layout_of(header);
+
+    // a file is written next to its final name and renamed over it, a shared memory object can't be renamed so the
+    // old one is unlinked first and readers that open the new one before it is written see no magic yet
+    std::string write_name = backing == Backing::file ? name + ".tmp." + std::to_string(getpid()) : name;
+    int fd;
+    if (backing == Backing::file) {
+        fd = ::open(write_name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    } else {
+        if (shm_unlink(name.c_str()) != 0 && errno != ENOENT)
+            throw_system_error("could not replace formula store", name);
+        fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    }
+    if (fd < 0)
+        throw_system_error("could not create formula store", write_name);
+
+    if (ftruncate(fd, layout.size) != 0) {
+        ::close(fd);
+        throw_system_error("could not size formula store", write_name);
+    }
+    void *mapped = mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        throw_system_error("could not map formula store", write_name);
+    std::byte *base = static_cast<std::byte *>(mapped);
+
+    if (!table.nodes.empty())
+        std::memcpy(base + layout.nodes, table.nodes.data(), table.nodes.size() * sizeof(FlatNode));
+    if (!table.children.empty())
+        std::memcpy(base + layout.children, table.children.data(), table.children.size() * sizeof(std::uint32_t));
+    if (!roots.empty())
+        std::memcpy(base + layout.roots, roots.data(), roots.size() * sizeof(std::uint32_t));
+
+    // the file is fresh from ftruncate so the index slots start out empty
+    std::uint32_t *symbol_offsets = section<std::uint32_t>(base, layout.symbol_offsets);
+    char *symbol_text = section<char>(base, layout.symbol_text);
+    std::uint32_t *symbol_index = section<std::uint32_t>(base, layout.symbol_index);
+    std::uint32_t offset = 0;
+    for (std::uint32_t i = 0; i < table.symbols.size(); ++i) {
+        const std::string &symbol = table.symbols[i];
+        symbol_offsets[i] = offset;
+        std::memcpy(symbol_text + offset, symbol.data(), symbol.size());
+        offset += (std::uint32_t)symbol.size();
+        insert_slot(symbol_index, header.symbol_index_capacity, hash_symbol(symbol), i);
+    }
+    symbol_offsets[table.symbols.size()] = offset;
+
+    std::uint32_t *node_index = section<std::uint32_t>(base, layout.node_index);
+    for (std::uint32_t i = 0; i < table.nodes.size(); ++i) {
+        const FlatNode &n = table.nodes[i];
+        insert_slot(node_index, header.node_index_capacity, hash_node(n.kind, n.symbol, table.children_of(i)), i);
+    }
+
+    // the magic goes in last, so a store is never opened half written
+    std::memcpy(base, &header, sizeof(header));
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(base, store_magic, sizeof(store_magic));
+    munmap(mapped, layout.size);
+
+    if (backing == Backing::file && rename(write_name.c_str(), name.c_str()) != 0)
+        throw_system_error("could not replace formula store", name);
+}
+
+void SharedFormulaStore::remove(const std::string &name, Backing backing) {
+    int result = backing == Backing::file ? unlink(name.c_str()) : shm_unlink(name.c_str());
+    if (result != 0 && errno != ENOENT)
+        throw_system_error("could not remove formula store", name);
+}
+
+SharedFormulaStore::SharedFormulaStore(const std::string &name, Backing backing) {
+    int fd = backing == Backing::file ? ::open(name.c_str(), O_RDONLY | O_CLOEXEC)
+                                      : shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw_system_error("could not open formula store", name);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw_system_error("could not stat formula store", name);
+    }
+    if ((size_t)st.st_size < sizeof(StoreHeader)) {
+        ::close(fd);
+        throw std::runtime_error("not a formula store (or wrong version): " + name);
+    }
+
+    size = st.st_size;
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        throw_system_error("could not map formula store", name);
+    data = static_cast<const std::byte *>(mapped);
+
+    // only the header is checked, the nodes are trusted to be as create wrote them
+    StoreHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto is_capacity = [](std::uint64_t c) { return c >= 8 && c <= (1ull << 33) && (c & (c - 1)) == 0; };
+    if (std::memcmp(header.magic, store_magic, sizeof(store_magic)) != 0 || header.version != store_version ||
+        header.node_count > no_node || header.child_count > 0xffffffffull || header.symbol_count > no_symbol ||
+        header.symbol_text_size > 0xffffffffull || header.root_count > 0xffffffffull ||
+        !is_capacity(header.symbol_index_capacity) || !is_capacity(header.node_index_capacity) ||
+        layout_of(header).size > size) {
+        munmap(mapped, size);
+        throw std::runtime_error("not a formula store (or wrong version): " + name);
+    }
+    StoreLayout layout = layout_of(header);
+
+    nodes.nodes = section<FlatNode>(data, layout.nodes, header.node_count);
+    nodes.children = section<std::uint32_t>(data, layout.children, header.child_count);
+    root_nodes = section<std::uint32_t>(data, layout.roots, header.root_count);
+    symbol_index = section<std::uint32_t>(data, layout.symbol_index, header.symbol_index_capacity);
+    node_index = section<std::uint32_t>(data, layout.node_index, header.node_index_capacity);
+
+    auto offsets = section<std::uint32_t>(data, layout.symbol_offsets, header.symbol_count + 1);
+    const char *text = reinterpret_cast<const char *>(data + layout.symbol_text);
+    nodes.symbols.reserve(header.symbol_count);
+    for (std::uint64_t i = 0; i < header.symbol_count; ++i) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > header.symbol_text_size) {
+            munmap(mapped, size);
+            throw std::runtime_error("corrupt formula store: " + name);
+        }
+        nodes.symbols.emplace_back(text + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+}
+
+SharedFormulaStore::~SharedFormulaStore() {
+    if (data)
+        munmap(const_cast<std::byte *>(data), size);
+}
+
+std::uint32_t SharedFormulaStore::find_symbol(std::string_view name) const {
+    std::uint64_t mask = symbol_index.size() - 1;
+    for (std::uint64_t i = hash_symbol(name) & mask; symbol_index[i] != 0; i = (i + 1) & mask)
+        if (nodes.symbols[symbol_index[i] - 1] == name)
+            return symbol_index[i] - 1;
+    return no_symbol;
+}
+
+std::uint32_t SharedFormulaStore::find_node(NodeKind kind, std::uint32_t symbol,
+                                            std::span<const std::uint32_t> node_children) const {
+    std::uint64_t mask = node_index.size() - 1;
+    for (std::uint64_t i = hash_node(kind, symbol, node_children) & mask; node_index[i] != 0; i = (i + 1) & mask) {
+        std::uint32_t id = node_index[i] - 1;
+        const FlatNode &n = nodes.nodes[id];
+        auto c = nodes.children_of(id);
+        if (n.kind == kind && n.symbol == symbol &&
+            std::equal(c.begin(), c.end(), node_children.begin(), node_children.end()))
+            return id;
+    }
+    return no_node;
+}
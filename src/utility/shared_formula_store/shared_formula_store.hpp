@@ -0,0 +1,57 @@
+#ifndef SHARED_FORMULA_STORE_HPP
+#define SHARED_FORMULA_STORE_HPP
+
+#include "../flat_formula/flat_formula.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief a FlatFormulaTable written once and mapped read only by every process that needs it, so worker processes
+ * share one copy of the formulas instead of each interning their own
+ *
+ * the store is either a file or a POSIX shared memory object (a name like "/axioms"). everything in it refers to
+ * everything else by index, never by address, so it can be mapped anywhere. it holds the nodes, children and symbols
+ * of the table, the root nodes it was created with and open addressing hash tables for looking up symbols and nodes,
+ * so opening a store is one mmap, a check of the header and a list of where the symbol names are. nodes are never
+ * parsed or copied, however many processes map the store.
+ */
+class SharedFormulaStore {
+  public:
+    enum class Backing { file, shared_memory };
+
+    /// replaces whatever is at name, processes that already have the old store mapped keep seeing it
+    static void create(const std::string &name, const FlatFormulaTable &table, std::span<const std::uint32_t> roots,
+                       Backing backing = Backing::file);
+    static void remove(const std::string &name, Backing backing = Backing::file);
+
+    /// throws std::runtime_error if there is no store at name or it was written by an incompatible version
+    explicit SharedFormulaStore(const std::string &name, Backing backing = Backing::file);
+    ~SharedFormulaStore();
+
+    SharedFormulaStore(const SharedFormulaStore &) = delete;
+    SharedFormulaStore &operator=(const SharedFormulaStore &) = delete;
+
+    /// pass to FlatFormulaReader to get Terms and Formulas back
+    const FlatFormulaView &view() const { return nodes; }
+    std::span<const std::uint32_t> roots() const { return root_nodes; }
+
+    /// the lookups of FlatFormulaTable
+    std::uint32_t find_symbol(std::string_view name) const;
+    std::uint32_t find_node(NodeKind kind, std::uint32_t symbol, std::span<const std::uint32_t> node_children) const;
+
+    size_t mapped_size() const { return size; }
+
+  private:
+    const std::byte *data = nullptr;
+    size_t size = 0;
+
+    FlatFormulaView nodes;
+    std::span<const std::uint32_t> root_nodes;
+    std::span<const std::uint32_t> symbol_index;
+    std::span<const std::uint32_t> node_index;
+};
+
+#endif // SHARED_FORMULA_STORE_HPP
@@ -0,0 +1,151 @@
+#include "verification_condition.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+// the va(v, t) terms of every variable, each built once
+class SsaVersions {
+  public:
+    const TermPtr &latest(const std::string &v) {
+        auto [it, inserted] = latest_versions.try_emplace(v);
+        if (inserted)
+            it->second = initial(v);
+        return it->second;
+    }
+
+    const TermPtr &initial(const std::string &v) {
+        auto [it, inserted] = initial_versions.try_emplace(v);
+        if (inserted)
+            it->second = Term::make_function("va", {name(v), Term::make_constant("0")});
+        return it->second;
+    }
+
+    const TermPtr &assign(const std::string &v, size_t step) {
+        initial(v);
+        return latest_versions[v] = Term::make_function("va", {name(v), Term::make_constant(std::to_string(step))});
+    }
+
+  private:
+    std::unordered_map<std::string, TermPtr> names;
+    std::unordered_map<std::string, TermPtr> latest_versions;
+    std::unordered_map<std::string, TermPtr> initial_versions;
+
+    const TermPtr &name(const std::string &v) {
+        auto [it, inserted] = names.try_emplace(v);
+        if (inserted)
+            it->second = Term::make_constant(v);
+        return it->second;
+    }
+};
+
+// replaces program variables by their latest versions, and in the postcondition old(v) by v's initial version.
+// subterms without program variables are kept as they are
+class Renamer {
+  public:
+    Renamer(SsaVersions &versions, bool allow_old) : versions(versions), allow_old(allow_old) {}
+
+    TermPtr term(const TermPtr &t) {
+        if (!t)
+            throw std::invalid_argument("generate_verification_condition: null term");
+        if (auto p = std::get_if<VariableTerm>(&t->data))
+            return is_bound(p->var) ? t : versions.latest(p->var);
+        if (auto p = std::get_if<FunctionTerm>(&t->data)) {
+            if (allow_old && p->f == "old" && p->args.size() == 1) {
+                auto v = p->args[0] ? std::get_if<VariableTerm>(&p->args[0]->data) : nullptr;
+                if (!v || is_bound(v->var))
+                    throw std::invalid_argument("generate_verification_condition: old takes a program variable, not " +
+                                                t->to_string());
+                return versions.initial(v->var);
+            }
+            std::vector<TermPtr> args;
+            if (!terms(p->args, args))
+                return t;
+            return Term::make_function(p->f, std::move(args));
+        }
+        if (auto p = std::get_if<TupleTerm>(&t->data)) {
+            std::vector<TermPtr> args;
+            if (!terms(p->args, args))
+                return t;
+            return Term::make_tuple(std::move(args));
+        }
+        return t;
+    }
+
+    FormulaPtr formula(const FormulaPtr &f) {
+        if (!f)
+            throw std::invalid_argument("generate_verification_condition: null formula");
+        if (auto p = std::get_if<EqualityFormula>(&f->data))
+            return Formula::make_eq(term(p->l), term(p->r));
+        if (auto p = std::get_if<RelationFormula>(&f->data)) {
+            std::vector<TermPtr> args;
+            if (!terms(p->args, args))
+                return f;
+            return Formula::make_rel(p->R, std::move(args));
+        }
+        if (auto p = std::get_if<NotFormula>(&f->data))
+            return Formula::make_not(formula(p->inner));
+        if (auto p = std::get_if<OrFormula>(&f->data))
+            return Formula::make_or(formula(p->l), formula(p->r));
+        if (auto p = std::get_if<AndFormula>(&f->data))
+            return Formula::make_and(formula(p->l), formula(p->r));
+        if (auto p = std::get_if<ImpliesFormula>(&f->data))
+            return Formula::make_implies(formula(p->l), formula(p->r));
+        if (auto p = std::get_if<ForallFormula>(&f->data))
+            return Formula::make_forall(p->v, term(p->domain), bound_formula(p->v, p->inner));
+        if (auto p = std::get_if<ExistsFormula>(&f->data))
+            return Formula::make_exists(p->v, term(p->domain), bound_formula(p->v, p->inner));
+        return f;
+    }
+
+  private:
+    SsaVersions &versions;
+    bool allow_old;
+    // quantified variables in scope, they aren't program variables
+    std::vector<std::string_view> scope;
+
+    bool is_bound(const std::string &v) const { return std::find(scope.begin(), scope.end(), v) != scope.end(); }
+
+    // false if no argument changed, in which case args is left unfinished
+    bool terms(const std::vector<TermPtr> &in, std::vector<TermPtr> &args) {
+        bool changed = false;
+        args.reserve(in.size());
+        for (const TermPtr &arg : in) {
+            args.push_back(term(arg));
+            changed |= args.back() != arg;
+        }
+        return changed;
+    }
+
+    FormulaPtr bound_formula(const std::string &v, const FormulaPtr &inner) {
+        scope.push_back(v);
+        FormulaPtr renamed = formula(inner);
+        scope.pop_back();
+        return renamed;
+    }
+};
+
+} // namespace
+
+VerificationCondition generate_verification_condition(const std::vector<Assignment> &program, FormulaPtr postcondition) {
+    SsaVersions versions;
+    Renamer statements(versions, false);
+
+    VerificationCondition condition;
+    condition.assumptions.reserve(program.size());
+    for (size_t i = 0; i < program.size(); ++i) {
+        const Assignment &assignment = program[i];
+        if (assignment.variable.empty())
+            throw std::invalid_argument("generate_verification_condition: statement " + std::to_string(i + 1) +
+                                        " assigns to no variable");
+        // the value is read before the variable gets its new version
+        TermPtr value = statements.term(assignment.value);
+        condition.assumptions.push_back(Formula::make_eq(versions.assign(assignment.variable, i + 1), value));
+    }
+
+    condition.target = Renamer(versions, true).formula(postcondition);
+    return condition;
+}
@@ -0,0 +1,34 @@
+#ifndef VERIFICATION_CONDITION_HPP
+#define VERIFICATION_CONDITION_HPP
+
+#include "../proof_system/proof_system.hpp"
+#include <string>
+#include <vector>
+
+/// variable := value, where the program variables read by value are VariableTerms
+struct Assignment {
+    std::string variable;
+    TermPtr value;
+};
+
+/// what a straight line program has to satisfy, ready to be passed to a Proof
+struct VerificationCondition {
+    std::vector<FormulaPtr> assumptions;
+    FormulaPtr target;
+};
+
+/**
+ * @brief the assumptions and target for proving that running program establishes postcondition, in the va(v, t)
+ * encoding of the swap example
+ *
+ * the program is put in SSA form: va(v, t) is the value v was given by statement t (numbered from 1), and va(v, 0) is
+ * its value before the program. each statement adds the single assumption va(v, t) = value, with every variable in
+ * value replaced by its latest version, so a variable a statement doesn't assign simply keeps its version and needs no
+ * frame equality. in postcondition a program variable stands for its final value and old(v) for its initial one.
+ *
+ * runs in time linear in the size of the program and postcondition, versions of a variable are shared between all the
+ * terms that read them.
+ */
+VerificationCondition generate_verification_condition(const std::vector<Assignment> &program, FormulaPtr postcondition);
+
+#endif // VERIFICATION_CONDITION_HPP